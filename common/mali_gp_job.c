@@ -60,6 +60,7 @@ struct mali_gp_job *mali_gp_job_create(struct mali_session_data *session, _mali_
 
 		_mali_osk_list_init(&job->list);
 		job->session = session;
+		job->session_generation = mali_session_job_begin(session);
 		job->id = id;
 		job->heap_current_addr = job->uargs.frame_registers[4];
 		job->perf_counter_value0 = 0;
@@ -88,6 +89,8 @@ void mali_gp_job_delete(struct mali_gp_job *job)
 		job->finished_notification = NULL;
 	}
 
+	mali_session_job_end(job->session, job->session_generation);
+
 	_mali_osk_free(job);
 }
 
@@ -27,6 +27,8 @@ struct mali_gp_job
 	struct mali_session_data *session;                 /**< Session which submitted this job */
 	_mali_uk_gp_start_job_s uargs;                     /**< Arguments from user space */
 	u32 id;                                            /**< identifier for this job in kernel space (sequential numbering) */
+	u32 session_generation;                            /**< Job generation of the session the job is counted in */
+	u64 timeout;                                       /**< Watchdog timeout (in ns), sampled by the GP scheduler when the job is dequeued */
 	u32 heap_current_addr;                             /**< Holds the current HEAP address when the job has completed */
 	u32 perf_counter_value0;                           /**< Value of performance counter 0 (to be returned to user space) */
 	u32 perf_counter_value1;                           /**< Value of performance counter 1 (to be returned to user space) */
@@ -49,6 +51,11 @@ MALI_STATIC_INLINE u32 mali_gp_job_get_id(struct mali_gp_job *job)
 	return (NULL == job) ? 0 : job->id;
 }
 
+MALI_STATIC_INLINE u64 mali_gp_job_get_timeout(struct mali_gp_job *job)
+{
+	return job->timeout;
+}
+
 MALI_STATIC_INLINE u32 mali_gp_job_get_user_id(struct mali_gp_job *job)
 {
 	return job->uargs.user_job_ptr;
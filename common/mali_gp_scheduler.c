@@ -18,6 +18,7 @@
 #include "mali_group.h"
 #include "mali_pm.h"
 #include "mali_kernel_utilization.h"
+#include "mali_session.h"
 #if defined(CONFIG_GPU_TRACEPOINTS) && defined(CONFIG_TRACEPOINTS)
 #include <linux/sched.h>
 #include <trace/events/gpu.h>
@@ -137,6 +138,33 @@ MALI_STATIC_INLINE void mali_gp_scheduler_assert_locked(void)
 #define MALI_ASSERT_GP_SCHEDULER_LOCKED()
 #endif
 
+/**
+ * Returns the next job to start.
+ * Jobs from sessions which have used up their GP quota are deferred as long as
+ * other sessions have jobs queued, so the core is never left idle.
+ */
+static struct mali_gp_job *mali_gp_scheduler_get_next_job(void)
+{
+	struct mali_gp_job *job, *tmp;
+
+	MALI_ASSERT_GP_SCHEDULER_LOCKED();
+	MALI_DEBUG_ASSERT(!_mali_osk_list_empty(&job_queue));
+
+	_MALI_OSK_LIST_FOREACHENTRY(job, tmp, &job_queue, struct mali_gp_job, list)
+	{
+		struct mali_session_data *session = mali_gp_job_get_session(job);
+
+		if (session->is_compositor || !mali_session_gpu_time_over_quota(&session->gp_time, mali_session_gp_quota_ms))
+		{
+			return job;
+		}
+	}
+
+	MALI_DEBUG_PRINT(4, ("Mali GP scheduler: All queued jobs are over quota\n"));
+
+	return _MALI_OSK_LIST_ENTRY(job_queue.next, struct mali_gp_job, list);
+}
+
 static void mali_gp_scheduler_schedule(void)
 {
 	struct mali_gp_job *job;
@@ -152,9 +180,12 @@ static void mali_gp_scheduler_schedule(void)
 	}
 
 	/* Get (and remove) next job in queue */
-	job = _MALI_OSK_LIST_ENTRY(job_queue.next, struct mali_gp_job, list);
+	job = mali_gp_scheduler_get_next_job();
 	_mali_osk_list_del(&job->list);
 
+	/* The session's GP time is only stable under the scheduler lock */
+	job->timeout = mali_session_get_job_timeout(&mali_gp_job_get_session(job)->gp_time);
+
 	/* Mark slot as busy */
 	slot.state = MALI_GP_SLOT_STATE_WORKING;
 
@@ -186,9 +217,12 @@ static void mali_gp_scheduler_schedule_on_group(struct mali_group *group)
 	}
 
 	/* Get (and remove) next job in queue */
-	job = _MALI_OSK_LIST_ENTRY(job_queue.next, struct mali_gp_job, list);
+	job = mali_gp_scheduler_get_next_job();
 	_mali_osk_list_del(&job->list);
 
+	/* The session's GP time is only stable under the scheduler lock */
+	job->timeout = mali_session_get_job_timeout(&mali_gp_job_get_session(job)->gp_time);
+
 	/* Mark slot as busy */
 	slot.state = MALI_GP_SLOT_STATE_WORKING;
 
@@ -227,6 +261,11 @@ void mali_gp_scheduler_job_done(struct mali_group *group, struct mali_gp_job *jo
 {
 	MALI_DEBUG_PRINT(3, ("Mali GP scheduler: Job %u (0x%08X) completed (%s)\n", mali_gp_job_get_id(job), job, success ? "success" : "failure"));
 
+	/* Charge the session for the time the job kept the core busy, under the lock the quota is checked and reset with */
+	mali_gp_scheduler_lock();
+	mali_session_gpu_time_add(&mali_gp_job_get_session(job)->gp_time, _mali_osk_time_get_monotonic_ns() - group->job_start_time, 1, success);
+	mali_gp_scheduler_unlock();
+
 	if (!success)
 	{
 		if (job->session->is_compositor)
@@ -494,10 +533,15 @@ void mali_gp_scheduler_reset_all_groups(void)
 }
 
 void mali_gp_scheduler_zap_all_active(struct mali_session_data *session)
+{
+	mali_gp_scheduler_zap_range_all_active(session, 0, 0);
+}
+
+void mali_gp_scheduler_zap_range_all_active(struct mali_session_data *session, u32 mali_address, u32 size)
 {
 	if (NULL != slot.group)
 	{
-		mali_group_zap_session(slot.group, session);
+		mali_group_zap_session_range(slot.group, session, mali_address, size);
 	}
 }
 
@@ -40,6 +40,7 @@ void mali_gp_scheduler_reset_all_groups(void);
  * The scheculer will zap the session on all groups it owns.
  */
 void mali_gp_scheduler_zap_all_active(struct mali_session_data *session);
+void mali_gp_scheduler_zap_range_all_active(struct mali_session_data *session, u32 mali_address, u32 size);
 
 void mali_gp_scheduler_enable_group(struct mali_group *group);
 void mali_gp_scheduler_disable_group(struct mali_group *group);
@@ -23,6 +23,7 @@
 #include "mali_osk_profiling.h"
 #include "mali_pm_domain.h"
 #include "mali_pm.h"
+#include "mali_memory.h"
 #if defined(CONFIG_GPU_TRACEPOINTS) && defined(CONFIG_TRACEPOINTS)
 #include <linux/sched.h>
 #include <trace/events/gpu.h>
@@ -33,7 +34,16 @@ static void mali_group_bottom_half_mmu(void *data);
 static void mali_group_bottom_half_gp(void *data);
 static void mali_group_bottom_half_pp(void *data);
 
-static void mali_group_timeout(void *data);
+static void mali_group_timeout(struct mali_group *group);
+static void mali_group_watchdog_arm(struct mali_group *group, u64 timeout);
+static void mali_group_watchdog_disarm(struct mali_group *group);
+static mali_bool mali_group_watchdog_is_armed(struct mali_group *group);
+#if defined(MALI_UPPER_HALF_SCHEDULING)
+static u64 mali_group_pp_poll_interval(void);
+static void mali_group_pp_poll_begin(struct mali_group *group);
+static void mali_group_pp_poll_end(struct mali_group *group);
+static void mali_group_pp_poll_account_completion(u64 now);
+#endif
 static void mali_group_reset_pp(struct mali_group *group);
 static void mali_group_reset_mmu(struct mali_group *group);
 
@@ -56,6 +66,49 @@ static void mali_group_report_l2_cache_counters_per_core(struct mali_group *grou
 static struct mali_group *mali_global_groups[MALI_MAX_NUMBER_OF_GROUPS] = { NULL, };
 static u32 mali_global_num_groups = 0;
 
+/*
+ * A single high resolution timer watches the jobs running on all groups.
+ * It is always set to expire at the earliest deadline of all watched jobs.
+ */
+static _mali_osk_hrtimer_t *mali_group_watchdog_timer = NULL;
+static _mali_osk_lock_t *mali_group_watchdog_lock = NULL;
+static u64 mali_group_watchdog_expires = 0; /* 0 if the watchdog timer is not started */
+
+/*
+ * When PP jobs complete at a high rate, the END_OF_FRAME interrupt is masked on
+ * the physical PP cores and a single high resolution timer polls them for
+ * completion instead. Interrupts are used again once the rate drops.
+ * Polling completes jobs from timer (hard IRQ) context, so it is only
+ * available when the group lock is IRQ safe.
+ */
+int mali_pp_poll_threshold = 20;     /* PP job completions per window to switch to polling, 0 to disable */
+int mali_pp_poll_interval_us = 50;   /* Time between two polls of the PP cores */
+
+#if defined(MALI_UPPER_HALF_SCHEDULING)
+#define MALI_GROUP_PP_POLL_WINDOW_NS     (10ULL * 1000000ULL)
+#define MALI_GROUP_PP_POLL_MIN_INTERVAL  10 /* us */
+
+struct mali_group_pp_poll_stats
+{
+	u32 polls;              /**< Number of times the polled cores were checked */
+	u32 irqs_avoided;       /**< Number of jobs found completed by polling */
+	u32 enter_count;        /**< Number of switches from interrupts to polling */
+	u32 leave_count;        /**< Number of switches from polling to interrupts */
+	u64 latency_average;    /**< Average upper bound of added completion latency (in ns), scaled by 8 */
+	u64 latency_max;        /**< Largest upper bound of added completion latency (in ns) */
+};
+
+static _mali_osk_hrtimer_t *mali_group_pp_poll_timer = NULL;
+static _mali_osk_lock_t *mali_group_pp_poll_lock = NULL;
+static mali_bool mali_group_pp_polling = MALI_FALSE;
+static mali_bool mali_group_pp_poll_timer_running = MALI_FALSE;
+static u32 mali_group_pp_num_polled = 0;
+static u64 mali_group_pp_poll_window_start = 0;
+static u32 mali_group_pp_poll_window_completions = 0;
+static u64 mali_group_pp_poll_last_tick = 0;
+static struct mali_group_pp_poll_stats mali_group_pp_poll_stats;
+#endif
+
 enum mali_group_activate_pd_status
 {
 	MALI_GROUP_ACTIVATE_PD_STATUS_FAILED,
@@ -117,44 +170,38 @@ struct mali_group *mali_group_create(struct mali_l2_cache_core *core, struct mal
 	group = _mali_osk_calloc(1, sizeof(struct mali_group));
 	if (NULL != group)
 	{
-		group->timeout_timer = _mali_osk_timer_init();
+		_mali_osk_lock_order_t order;
 
-		if (NULL != group->timeout_timer)
+		if (NULL != dlbu)
 		{
-			_mali_osk_lock_order_t order;
-			_mali_osk_timer_setcallback(group->timeout_timer, mali_group_timeout, (void *)group);
-
-			if (NULL != dlbu)
-			{
-				order = _MALI_OSK_LOCK_ORDER_GROUP_VIRTUAL;
-			}
-			else
-			{
-				order = _MALI_OSK_LOCK_ORDER_GROUP;
-			}
+			order = _MALI_OSK_LOCK_ORDER_GROUP_VIRTUAL;
+		}
+		else
+		{
+			order = _MALI_OSK_LOCK_ORDER_GROUP;
+		}
 
-			group->lock = _mali_osk_lock_init(lock_flags, 0, order);
-			if (NULL != group->lock)
-			{
-				group->l2_cache_core[0] = core;
-				group->session = NULL;
-				group->page_dir_ref_count = 0;
-				group->power_is_on = MALI_TRUE;
-				group->state = MALI_GROUP_STATE_IDLE;
-				_mali_osk_list_init(&group->group_list);
-				_mali_osk_list_init(&group->pp_scheduler_list);
-				group->parent_group = NULL;
-				group->l2_cache_core_ref_count[0] = 0;
-				group->l2_cache_core_ref_count[1] = 0;
-				group->bcast_core = bcast;
-				group->dlbu_core = dlbu;
-
-				mali_global_groups[mali_global_num_groups] = group;
-				mali_global_num_groups++;
-
-				return group;
-			}
-            _mali_osk_timer_term(group->timeout_timer);
+		group->lock = _mali_osk_lock_init(lock_flags, 0, order);
+		if (NULL != group->lock)
+		{
+			group->l2_cache_core[0] = core;
+			group->session = NULL;
+			group->page_dir_ref_count = 0;
+			group->power_is_on = MALI_TRUE;
+			group->state = MALI_GROUP_STATE_IDLE;
+			_mali_osk_list_init(&group->group_list);
+			_mali_osk_list_init(&group->pp_scheduler_list);
+			group->parent_group = NULL;
+			group->l2_cache_core_ref_count[0] = 0;
+			group->l2_cache_core_ref_count[1] = 0;
+			group->bcast_core = bcast;
+			group->dlbu_core = dlbu;
+			group->job_deadline = 0;
+
+			mali_global_groups[mali_global_num_groups] = group;
+			mali_global_num_groups++;
+
+			return group;
 		}
 		_mali_osk_free(group);
 	}
@@ -277,6 +324,10 @@ void mali_group_delete(struct mali_group *group)
 		}
 	}
 
+	/* The watchdog walks the global group array, so do not change it under its feet */
+	_mali_osk_lock_wait(mali_group_watchdog_lock, _MALI_OSK_LOCKMODE_RW);
+	group->job_deadline = 0;
+
 	for (i = 0; i < mali_global_num_groups; i++)
 	{
 		if (mali_global_groups[i] == group)
@@ -296,11 +347,23 @@ void mali_group_delete(struct mali_group *group)
 		}
 	}
 
-	if (NULL != group->timeout_timer)
+	_mali_osk_lock_signal(mali_group_watchdog_lock, _MALI_OSK_LOCKMODE_RW);
+
+#if defined(MALI_UPPER_HALF_SCHEDULING)
+	/* The poller might have picked this group from the array, wait for it to finish */
+	_mali_osk_hrtimer_cancel(mali_group_pp_poll_timer);
+
+	_mali_osk_lock_wait(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+	if (0 < mali_group_pp_num_polled)
 	{
-		_mali_osk_timer_del(group->timeout_timer);
-		_mali_osk_timer_term(group->timeout_timer);
+		_mali_osk_hrtimer_start(mali_group_pp_poll_timer, mali_group_pp_poll_interval());
 	}
+	else
+	{
+		mali_group_pp_poll_timer_running = MALI_FALSE;
+	}
+	_mali_osk_lock_signal(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+#endif
 
 	if (NULL != group->bottom_half_work_mmu)
 	{
@@ -603,10 +666,10 @@ void mali_group_start_gp_job(struct mali_group *group, struct mali_gp_job *job)
 	activate_status = mali_group_activate_page_directory(group, session);
 	if (MALI_GROUP_ACTIVATE_PD_STATUS_FAILED != activate_status)
 	{
-		/* if session is NOT kept Zapping is done as part of session switch */
+		/* if session is NOT kept Zapping is done as part of session switch, else only if the page tables changed */
 		if (MALI_GROUP_ACTIVATE_PD_STATUS_OK_KEPT_PD == activate_status)
 		{
-			mali_mmu_zap_tlb_without_stall(group->mmu);
+			mali_mmu_zap_tlb_if_stale(group->mmu, mali_session_get_page_directory(session));
 		}
 		mali_gp_job_start(group->gp_core, job);
 
@@ -628,21 +691,28 @@ void mali_group_start_gp_job(struct mali_group *group, struct mali_gp_job *job)
 			mali_gp_job_get_pid(job), 0, mali_gp_job_get_id(job));
 #endif
 		group->gp_running_job = job;
+		group->job_start_time = _mali_osk_time_get_monotonic_ns();
 		group->state = MALI_GROUP_STATE_WORKING;
 
+		/* Let the watchdog time out the job if it runs for much longer than expected */
+		mali_group_watchdog_arm(group, mali_gp_job_get_timeout(job));
 	}
-
-	/* Setup the timeout timer value and save the job id for the job running on the gp core */
-	_mali_osk_timer_mod(group->timeout_timer, _mali_osk_time_mstoticks(mali_max_job_runtime));
 }
 
 void mali_group_start_pp_job(struct mali_group *group, struct mali_pp_job *job, u32 sub_job)
+{
+	mali_group_prepare_pp_job(group, job, sub_job);
+	mali_group_commit_pp_job(group);
+}
+
+void mali_group_prepare_pp_job(struct mali_group *group, struct mali_pp_job *job, u32 sub_job)
 {
 	struct mali_session_data *session;
 	enum mali_group_activate_pd_status activate_status;
 
 	MALI_ASSERT_GROUP_LOCKED(group);
 	MALI_DEBUG_ASSERT(MALI_GROUP_STATE_IDLE == group->state);
+	MALI_DEBUG_ASSERT(NULL == group->pp_running_job);
 
 	session = mali_pp_job_get_session(job);
 
@@ -659,11 +729,12 @@ void mali_group_start_pp_job(struct mali_group *group, struct mali_pp_job *job,
 	activate_status = mali_group_activate_page_directory(group, session);
 	if (MALI_GROUP_ACTIVATE_PD_STATUS_FAILED != activate_status)
 	{
-		/* if session is NOT kept Zapping is done as part of session switch */
+		/* if session is NOT kept Zapping is done as part of session switch, else only if the page tables changed */
 		if (MALI_GROUP_ACTIVATE_PD_STATUS_OK_KEPT_PD == activate_status)
 		{
-			MALI_DEBUG_PRINT(3, ("PP starting job PD_Switch 0 Flush 1 Zap 1\n"));
-			mali_mmu_zap_tlb_without_stall(group->mmu);
+			mali_bool zapped = mali_mmu_zap_tlb_if_stale(group->mmu, mali_session_get_page_directory(session));
+			MALI_DEBUG_PRINT(3, ("PP starting job PD_Switch 0 Flush 1 Zap %d\n", zapped));
+			MALI_IGNORE(zapped);
 		}
 
 		if (mali_group_is_virtual(group))
@@ -683,7 +754,29 @@ void mali_group_start_pp_job(struct mali_group *group, struct mali_pp_job *job,
 			}
 		}
 
-		mali_pp_job_start(group->pp_core, job, sub_job, MALI_FALSE);
+		mali_pp_job_prepare(group->pp_core, job, sub_job, MALI_FALSE);
+
+		/* Remember what is staged, the core is started by mali_group_commit_pp_job() */
+		group->pp_running_job = job;
+		group->pp_running_sub_job = sub_job;
+	}
+}
+
+void mali_group_commit_pp_job(struct mali_group *group)
+{
+	struct mali_pp_job *job = group->pp_running_job;
+
+	MALI_ASSERT_GROUP_LOCKED(group);
+	MALI_DEBUG_ASSERT(MALI_GROUP_STATE_IDLE == group->state);
+
+	/* Nothing is staged if the page directory could not be activated */
+	if (NULL != job)
+	{
+#if defined(MALI_UPPER_HALF_SCHEDULING)
+		mali_group_pp_poll_begin(group);
+#endif
+		mali_pp_job_start_rendering(group->pp_core);
+		group->job_start_time = _mali_osk_time_get_monotonic_ns();
 
 		/* if the group is virtual, loop through physical groups which belong to this group
 		 * and call profiling events for its cores as virtual */
@@ -745,14 +838,11 @@ void mali_group_start_pp_job(struct mali_group *group, struct mali_pp_job *job,
 #if defined(CONFIG_GPU_TRACEPOINTS) && defined(CONFIG_TRACEPOINTS)
 		trace_gpu_sched_switch(mali_pp_get_hw_core_desc(group->pp_core), sched_clock(), mali_pp_job_get_tid(job), 0, mali_pp_job_get_id(job));
 #endif
-		group->pp_running_job = job;
-		group->pp_running_sub_job = sub_job;
 		group->state = MALI_GROUP_STATE_WORKING;
 
+		/* Let the watchdog time out the job if it runs for much longer than expected */
+		mali_group_watchdog_arm(group, mali_pp_job_get_timeout(job));
 	}
-
-	/* Setup the timeout timer value and save the job id for the job running on the pp core */
-	_mali_osk_timer_mod(group->timeout_timer, _mali_osk_time_mstoticks(mali_max_job_runtime));
 }
 
 struct mali_gp_job *mali_group_resume_gp_with_new_heap(struct mali_group *group, u32 job_id, u32 start_addr, u32 end_addr)
@@ -774,6 +864,9 @@ struct mali_gp_job *mali_group_resume_gp_with_new_heap(struct mali_group *group,
 
 	mali_gp_resume_with_new_heap(group->gp_core, start_addr, end_addr);
 
+	/* The session is not charged for the time spent waiting on user space */
+	group->job_start_time += _mali_osk_time_get_monotonic_ns() - group->job_stall_time;
+
 	_mali_osk_profiling_add_event(MALI_PROFILING_EVENT_TYPE_RESUME|MALI_PROFILING_MAKE_EVENT_CHANNEL_GP(0), 0, 0, 0, 0, 0);
 
 	group->state = MALI_GROUP_STATE_WORKING;
@@ -858,6 +951,16 @@ static void mali_group_complete_pp(struct mali_group *group, mali_bool success)
 
 	pp_job_to_return = group->pp_running_job;
 	pp_sub_job_to_return = group->pp_running_sub_job;
+
+	if (success)
+	{
+		/* Record the runtime of this sub job, used by the scheduler to order future sub jobs */
+		u64 now = _mali_osk_time_get_monotonic_ns();
+		mali_pp_job_set_sub_job_runtime(pp_job_to_return, pp_sub_job_to_return, (u32)((now - group->job_start_time) >> 10));
+#if defined(MALI_UPPER_HALF_SCHEDULING)
+		mali_group_pp_poll_account_completion(now);
+#endif
+	}
 	group->state = MALI_GROUP_STATE_IDLE;
 	group->pp_running_job = NULL;
 
@@ -1326,6 +1429,49 @@ out:
 	return err;
 }
 
+/*
+ * Try to resolve a page fault by growing grow-on-fault memory. The group lock
+ * is dropped while the pages are committed, so the job may have been aborted
+ * by the time it is taken again.
+ * Returns MALI_TRUE if the fault has been dealt with, MALI_FALSE if the job must fail.
+ */
+static mali_bool mali_group_mmu_page_fault_grow(struct mali_group *group, u32 fault_address)
+{
+	struct mali_session_data *session = group->session;
+	struct mali_gp_job *gp_job = group->gp_running_job;
+	struct mali_pp_job *pp_job = group->pp_running_job;
+	_mali_osk_errcode_t err;
+
+	MALI_ASSERT_GROUP_LOCKED(group);
+
+	if (NULL == session || MALI_GROUP_STATE_WORKING != group->state || mali_group_is_virtual(group))
+	{
+		return MALI_FALSE;
+	}
+
+	/* Pages can not be allocated with the group (spin)lock held */
+	mali_group_unlock(group);
+	err = mali_memory_grow_on_fault(session, fault_address);
+	mali_group_lock(group);
+
+	if (session != group->session || gp_job != group->gp_running_job || pp_job != group->pp_running_job
+	    || MALI_FALSE == mali_group_power_is_on(group)
+	    || 0 == (mali_mmu_get_status(group->mmu) & MALI_MMU_STATUS_BIT_PAGE_FAULT_ACTIVE))
+	{
+		/* The job went away, it was aborted or reset while the lock was dropped */
+		return MALI_TRUE;
+	}
+
+	if (_MALI_OSK_ERR_OK != err)
+	{
+		return MALI_FALSE;
+	}
+
+	mali_mmu_page_fault_resume(group->mmu);
+
+	return MALI_TRUE;
+}
+
 static void mali_group_bottom_half_mmu(void * data)
 {
 	struct mali_group *group = (struct mali_group *)data;
@@ -1360,7 +1506,12 @@ static void mali_group_bottom_half_mmu(void * data)
 		                 (status >> 6) & 0x1F,
 		                 (status & 32) ? "write" : "read",
 		                 mmu->hw_core.description));
-		MALI_IGNORE(fault_address);
+
+		if ((rawstat & MALI_MMU_INTERRUPT_PAGE_FAULT) && MALI_TRUE == mali_group_mmu_page_fault_grow(group, fault_address))
+		{
+			mali_group_unlock(group);
+			return;
+		}
 
 		mali_group_mmu_page_fault(group);
 	}
@@ -1465,7 +1616,7 @@ static void mali_group_bottom_half_gp(void *data)
 	else if (group->core_timed_out) /* SW timeout */
 	{
 		group->core_timed_out = MALI_FALSE;
-		if (!_mali_osk_timer_pending(group->timeout_timer) && NULL != group->gp_running_job)
+		if (!mali_group_watchdog_is_armed(group) && NULL != group->gp_running_job)
 		{
 			MALI_PRINT(("Mali group: Job %d timed out\n", mali_gp_job_get_id(group->gp_running_job)));
 			mali_group_complete_gp(group, MALI_FALSE);
@@ -1479,6 +1630,11 @@ static void mali_group_bottom_half_gp(void *data)
 		MALI_DEBUG_PRINT(3, ("Mali group: PLBU needs more heap memory\n"));
 
 		group->state = MALI_GROUP_STATE_OOM;
+		group->job_stall_time = _mali_osk_time_get_monotonic_ns();
+
+		/* Growing the heap involves user space, so allow the job the full runtime from now on */
+		mali_group_watchdog_arm(group, (u64)mali_max_job_runtime * 1000000ULL);
+
 		mali_group_unlock(group); /* Nothing to do on the HW side, so just release group lock right away */
 		mali_gp_scheduler_oom(group, group->gp_running_job);
 		_mali_osk_profiling_add_event(MALI_PROFILING_EVENT_TYPE_STOP|MALI_PROFILING_EVENT_CHANNEL_SOFTWARE|MALI_PROFILING_EVENT_REASON_START_STOP_SW_BOTTOM_HALF, 0, _mali_osk_get_tid(), 0, 0, 0);
@@ -1498,8 +1654,8 @@ static void mali_group_bottom_half_gp(void *data)
 
 static void mali_group_post_process_job_gp(struct mali_group *group, mali_bool suspend)
 {
-	/* Stop the timeout timer. */
-	_mali_osk_timer_del_async(group->timeout_timer);
+	/* Stop watching the job. */
+	mali_group_watchdog_disarm(group);
 
 	if (NULL == group->gp_running_job)
 	{
@@ -1507,6 +1663,12 @@ static void mali_group_post_process_job_gp(struct mali_group *group, mali_bool s
 		return;
 	}
 
+	if (MALI_GROUP_STATE_OOM == group->state)
+	{
+		/* Ended while waiting for a new heap, which is not charged either */
+		group->job_start_time += _mali_osk_time_get_monotonic_ns() - group->job_stall_time;
+	}
+
 	mali_gp_update_performance_counters(group->gp_core, group->gp_running_job, suspend);
 
 #if defined(CONFIG_MALI400_PROFILING)
@@ -1778,7 +1940,7 @@ static void mali_group_bottom_half_pp(void *data)
 	else if (group->core_timed_out) /* SW timeout */
 	{
 		group->core_timed_out = MALI_FALSE;
-		if (!_mali_osk_timer_pending(group->timeout_timer) && NULL != group->pp_running_job)
+		if (!mali_group_watchdog_is_armed(group) && NULL != group->pp_running_job)
 		{
 			MALI_PRINT(("Mali PP: Job %d timed out on core %s\n",
 			            mali_pp_job_get_id(group->pp_running_job), mali_pp_get_hw_core_desc(core)));
@@ -1823,8 +1985,11 @@ static void mali_group_post_process_job_pp(struct mali_group *group)
 {
 	MALI_ASSERT_GROUP_LOCKED(group);
 
-	/* Stop the timeout timer. */
-	_mali_osk_timer_del_async(group->timeout_timer);
+	/* Stop watching the job. */
+	mali_group_watchdog_disarm(group);
+#if defined(MALI_UPPER_HALF_SCHEDULING)
+	mali_group_pp_poll_end(group);
+#endif
 
 	if (NULL != group->pp_running_job)
 	{
@@ -1893,10 +2058,368 @@ static void mali_group_post_process_job_pp(struct mali_group *group)
 	}
 }
 
-static void mali_group_timeout(void *data)
+static void mali_group_watchdog_callback(void *data)
 {
-	struct mali_group *group = (struct mali_group *)data;
+	u64 now;
+	u64 next_deadline = 0;
+	u32 i;
+
+	MALI_IGNORE(data);
+
+	_mali_osk_lock_wait(mali_group_watchdog_lock, _MALI_OSK_LOCKMODE_RW);
+
+	now = _mali_osk_time_get_monotonic_ns();
+
+	for (i = 0; i < mali_global_num_groups; i++)
+	{
+		struct mali_group *group = mali_global_groups[i];
+
+		if (0 == group->job_deadline)
+		{
+			continue;
+		}
+
+		if (group->job_deadline <= now)
+		{
+			group->job_deadline = 0;
+			mali_group_timeout(group);
+		}
+		else if (0 == next_deadline || group->job_deadline < next_deadline)
+		{
+			next_deadline = group->job_deadline;
+		}
+	}
+
+	/* Restart the timer for the earliest job still watched, if any */
+	mali_group_watchdog_expires = next_deadline;
+	if (0 != next_deadline)
+	{
+		_mali_osk_hrtimer_start(mali_group_watchdog_timer, next_deadline - now);
+	}
+
+	_mali_osk_lock_signal(mali_group_watchdog_lock, _MALI_OSK_LOCKMODE_RW);
+}
+
+_mali_osk_errcode_t mali_group_watchdog_initialize(void)
+{
+	mali_group_watchdog_lock = _mali_osk_lock_init(_MALI_OSK_LOCKFLAG_ORDERED | _MALI_OSK_LOCKFLAG_SPINLOCK_IRQ | _MALI_OSK_LOCKFLAG_NONINTERRUPTABLE, 0, _MALI_OSK_LOCK_ORDER_WATCHDOG);
+	if (NULL == mali_group_watchdog_lock)
+	{
+		return _MALI_OSK_ERR_NOMEM;
+	}
+
+	mali_group_watchdog_timer = _mali_osk_hrtimer_init();
+	if (NULL == mali_group_watchdog_timer)
+	{
+		_mali_osk_lock_term(mali_group_watchdog_lock);
+		mali_group_watchdog_lock = NULL;
+		return _MALI_OSK_ERR_NOMEM;
+	}
+
+	_mali_osk_hrtimer_setcallback(mali_group_watchdog_timer, mali_group_watchdog_callback, NULL);
+	mali_group_watchdog_expires = 0;
+
+	return _MALI_OSK_ERR_OK;
+}
+
+void mali_group_watchdog_terminate(void)
+{
+	if (NULL != mali_group_watchdog_timer)
+	{
+		_mali_osk_hrtimer_cancel(mali_group_watchdog_timer);
+		_mali_osk_hrtimer_term(mali_group_watchdog_timer);
+		mali_group_watchdog_timer = NULL;
+	}
+
+	if (NULL != mali_group_watchdog_lock)
+	{
+		_mali_osk_lock_term(mali_group_watchdog_lock);
+		mali_group_watchdog_lock = NULL;
+	}
+}
+
+static void mali_group_watchdog_arm(struct mali_group *group, u64 timeout)
+{
+	MALI_ASSERT_GROUP_LOCKED(group);
 
+	_mali_osk_lock_wait(mali_group_watchdog_lock, _MALI_OSK_LOCKMODE_RW);
+
+	group->job_deadline = _mali_osk_time_get_monotonic_ns() + timeout;
+
+	/* Only touch the timer if this job is due before all the others */
+	if (0 == mali_group_watchdog_expires || group->job_deadline < mali_group_watchdog_expires)
+	{
+		mali_group_watchdog_expires = group->job_deadline;
+		_mali_osk_hrtimer_start(mali_group_watchdog_timer, timeout);
+	}
+
+	_mali_osk_lock_signal(mali_group_watchdog_lock, _MALI_OSK_LOCKMODE_RW);
+}
+
+static void mali_group_watchdog_disarm(struct mali_group *group)
+{
+	/* The timer is left running, it will not be restarted if no jobs are watched when it expires */
+	_mali_osk_lock_wait(mali_group_watchdog_lock, _MALI_OSK_LOCKMODE_RW);
+	group->job_deadline = 0;
+	_mali_osk_lock_signal(mali_group_watchdog_lock, _MALI_OSK_LOCKMODE_RW);
+}
+
+static mali_bool mali_group_watchdog_is_armed(struct mali_group *group)
+{
+	mali_bool armed;
+
+	_mali_osk_lock_wait(mali_group_watchdog_lock, _MALI_OSK_LOCKMODE_RW);
+	armed = (0 != group->job_deadline) ? MALI_TRUE : MALI_FALSE;
+	_mali_osk_lock_signal(mali_group_watchdog_lock, _MALI_OSK_LOCKMODE_RW);
+
+	return armed;
+}
+
+#if defined(MALI_UPPER_HALF_SCHEDULING)
+static u64 mali_group_pp_poll_interval(void)
+{
+	int interval_us = mali_pp_poll_interval_us;
+
+	if (MALI_GROUP_PP_POLL_MIN_INTERVAL > interval_us)
+	{
+		interval_us = MALI_GROUP_PP_POLL_MIN_INTERVAL;
+	}
+
+	return (u64)interval_us * 1000ULL;
+}
+
+static void mali_group_pp_poll_callback(void *data)
+{
+	struct mali_group *groups[MALI_MAX_NUMBER_OF_GROUPS];
+	u32 num_groups = 0;
+	u64 now;
+	u64 prev_tick;
+	u32 i;
+
+	MALI_IGNORE(data);
+
+	/* Pick the polled groups, the global group array is protected by the watchdog lock.
+	 * pp_polled is only a hint here, it is checked again with the group lock held. */
+	_mali_osk_lock_wait(mali_group_watchdog_lock, _MALI_OSK_LOCKMODE_RW);
+	for (i = 0; i < mali_global_num_groups; i++)
+	{
+		if (MALI_TRUE == mali_global_groups[i]->pp_polled)
+		{
+			groups[num_groups++] = mali_global_groups[i];
+		}
+	}
+	_mali_osk_lock_signal(mali_group_watchdog_lock, _MALI_OSK_LOCKMODE_RW);
+
+	_mali_osk_lock_wait(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+	now = _mali_osk_time_get_monotonic_ns();
+	prev_tick = mali_group_pp_poll_last_tick;
+	mali_group_pp_poll_last_tick = now;
+	mali_group_pp_poll_stats.polls++;
+	_mali_osk_lock_signal(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+
+	for (i = 0; i < num_groups; i++)
+	{
+		struct mali_group *group = groups[i];
+
+		mali_group_lock(group);
+
+		if (MALI_TRUE == group->pp_polled && MALI200_REG_VAL_IRQ_END_OF_FRAME == mali_pp_read_rawstat(group->pp_core))
+		{
+			/* The job completed at some point since the previous poll, or since it was started */
+			u64 latency = now - (prev_tick > group->job_start_time ? prev_tick : group->job_start_time);
+
+			_mali_osk_lock_wait(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+			mali_group_pp_poll_stats.irqs_avoided++;
+			mali_group_pp_poll_stats.latency_average += latency - (mali_group_pp_poll_stats.latency_average >> 3);
+			if (latency > mali_group_pp_poll_stats.latency_max)
+			{
+				mali_group_pp_poll_stats.latency_max = latency;
+			}
+			_mali_osk_lock_signal(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+
+			MALI_DEBUG_PRINT(4, ("Mali PP: Job completion polled on core %s\n", mali_pp_get_hw_core_desc(group->pp_core)));
+
+			mali_pp_mask_all_interrupts(group->pp_core);
+			group->core_timed_out = MALI_FALSE;
+			mali_group_complete_pp(group, MALI_TRUE);
+			/* No need to enable interrupts again, since the core will be reset while completing the job */
+		}
+
+		mali_group_unlock(group);
+	}
+
+	/* Keep polling as long as there are polled jobs running */
+	_mali_osk_lock_wait(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+	if (0 < mali_group_pp_num_polled)
+	{
+		_mali_osk_hrtimer_start(mali_group_pp_poll_timer, mali_group_pp_poll_interval());
+	}
+	else
+	{
+		mali_group_pp_poll_timer_running = MALI_FALSE;
+	}
+	_mali_osk_lock_signal(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+}
+
+static void mali_group_pp_poll_begin(struct mali_group *group)
+{
+	mali_bool polled = MALI_FALSE;
+
+	MALI_ASSERT_GROUP_LOCKED(group);
+	MALI_DEBUG_ASSERT(MALI_FALSE == group->pp_polled);
+
+	if (mali_group_is_virtual(group))
+	{
+		/* Broadcast jobs are always completed by interrupt */
+		return;
+	}
+
+	_mali_osk_lock_wait(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+	if (MALI_TRUE == mali_group_pp_polling)
+	{
+		polled = MALI_TRUE;
+		mali_group_pp_num_polled++;
+
+		if (MALI_FALSE == mali_group_pp_poll_timer_running)
+		{
+			mali_group_pp_poll_timer_running = MALI_TRUE;
+			mali_group_pp_poll_last_tick = _mali_osk_time_get_monotonic_ns();
+			_mali_osk_hrtimer_start(mali_group_pp_poll_timer, mali_group_pp_poll_interval());
+		}
+	}
+	_mali_osk_lock_signal(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+
+	if (MALI_TRUE == polled)
+	{
+		/* Must be done before the core is started */
+		mali_pp_enable_interrupts_for_polling(group->pp_core);
+		group->pp_polled = MALI_TRUE;
+	}
+}
+
+static void mali_group_pp_poll_end(struct mali_group *group)
+{
+	MALI_ASSERT_GROUP_LOCKED(group);
+
+	/* The interrupt mask is restored when the core is reset */
+	if (MALI_TRUE == group->pp_polled)
+	{
+		group->pp_polled = MALI_FALSE;
+
+		_mali_osk_lock_wait(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_DEBUG_ASSERT(0 < mali_group_pp_num_polled);
+		mali_group_pp_num_polled--;
+		_mali_osk_lock_signal(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+	}
+}
+
+static void mali_group_pp_poll_account_completion(u64 now)
+{
+	_mali_osk_lock_wait(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+
+	/* Decide on the mode once per window, with some hysteresis to avoid flapping */
+	if (now - mali_group_pp_poll_window_start >= MALI_GROUP_PP_POLL_WINDOW_NS)
+	{
+		u32 threshold = (0 < mali_pp_poll_threshold) ? (u32)mali_pp_poll_threshold : 0;
+
+		if (MALI_FALSE == mali_group_pp_polling && 0 != threshold && mali_group_pp_poll_window_completions >= threshold)
+		{
+			MALI_DEBUG_PRINT(3, ("Mali PP: %u jobs completed in window, polling for completion\n", mali_group_pp_poll_window_completions));
+			mali_group_pp_polling = MALI_TRUE;
+			mali_group_pp_poll_stats.enter_count++;
+		}
+		else if (MALI_TRUE == mali_group_pp_polling && mali_group_pp_poll_window_completions < threshold / 2)
+		{
+			MALI_DEBUG_PRINT(3, ("Mali PP: %u jobs completed in window, using interrupts\n", mali_group_pp_poll_window_completions));
+			mali_group_pp_polling = MALI_FALSE;
+			mali_group_pp_poll_stats.leave_count++;
+		}
+
+		mali_group_pp_poll_window_start = now;
+		mali_group_pp_poll_window_completions = 0;
+	}
+
+	mali_group_pp_poll_window_completions++;
+
+	_mali_osk_lock_signal(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+}
+#endif /* defined(MALI_UPPER_HALF_SCHEDULING) */
+
+_mali_osk_errcode_t mali_group_pp_poll_initialize(void)
+{
+#if defined(MALI_UPPER_HALF_SCHEDULING)
+	mali_group_pp_poll_lock = _mali_osk_lock_init(_MALI_OSK_LOCKFLAG_ORDERED | _MALI_OSK_LOCKFLAG_SPINLOCK_IRQ | _MALI_OSK_LOCKFLAG_NONINTERRUPTABLE, 0, _MALI_OSK_LOCK_ORDER_PP_POLL);
+	if (NULL == mali_group_pp_poll_lock)
+	{
+		return _MALI_OSK_ERR_NOMEM;
+	}
+
+	mali_group_pp_poll_timer = _mali_osk_hrtimer_init();
+	if (NULL == mali_group_pp_poll_timer)
+	{
+		_mali_osk_lock_term(mali_group_pp_poll_lock);
+		mali_group_pp_poll_lock = NULL;
+		return _MALI_OSK_ERR_NOMEM;
+	}
+
+	_mali_osk_hrtimer_setcallback(mali_group_pp_poll_timer, mali_group_pp_poll_callback, NULL);
+	mali_group_pp_polling = MALI_FALSE;
+	mali_group_pp_poll_timer_running = MALI_FALSE;
+	mali_group_pp_num_polled = 0;
+	_mali_osk_memset(&mali_group_pp_poll_stats, 0, sizeof(mali_group_pp_poll_stats));
+#endif
+
+	return _MALI_OSK_ERR_OK;
+}
+
+void mali_group_pp_poll_terminate(void)
+{
+#if defined(MALI_UPPER_HALF_SCHEDULING)
+	if (NULL != mali_group_pp_poll_timer)
+	{
+		_mali_osk_hrtimer_cancel(mali_group_pp_poll_timer);
+		_mali_osk_hrtimer_term(mali_group_pp_poll_timer);
+		mali_group_pp_poll_timer = NULL;
+	}
+
+	if (NULL != mali_group_pp_poll_lock)
+	{
+		_mali_osk_lock_term(mali_group_pp_poll_lock);
+		mali_group_pp_poll_lock = NULL;
+	}
+#endif
+}
+
+u32 mali_group_dump_pp_poll_stats(char *buf, u32 size)
+{
+	int n = 0;
+#if defined(MALI_UPPER_HALF_SCHEDULING)
+	struct mali_group_pp_poll_stats stats;
+	mali_bool polling;
+
+	_mali_osk_lock_wait(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+	stats = mali_group_pp_poll_stats;
+	polling = mali_group_pp_polling;
+	_mali_osk_lock_signal(mali_group_pp_poll_lock, _MALI_OSK_LOCKMODE_RW);
+
+	n += _mali_osk_snprintf(buf + n, size - n, "Mode: %s (threshold: %d jobs per %llu ms, interval: %d us)\n",
+	                        polling ? "polling" : "interrupts", mali_pp_poll_threshold,
+	                        MALI_GROUP_PP_POLL_WINDOW_NS / 1000000ULL, mali_pp_poll_interval_us);
+	n += _mali_osk_snprintf(buf + n, size - n, "Switches to polling: %u, back to interrupts: %u\n",
+	                        stats.enter_count, stats.leave_count);
+	n += _mali_osk_snprintf(buf + n, size - n, "Polls: %u, IRQs avoided: %u\n",
+	                        stats.polls, stats.irqs_avoided);
+	n += _mali_osk_snprintf(buf + n, size - n, "Added latency (upper bound): average %llu ns, max %llu ns\n",
+	                        stats.latency_average >> 3, stats.latency_max);
+#else
+	n += _mali_osk_snprintf(buf + n, size - n, "PP completion polling requires upper half scheduling\n");
+#endif
+
+	return n;
+}
+
+static void mali_group_timeout(struct mali_group *group)
+{
 	group->core_timed_out = MALI_TRUE;
 
 	if (NULL != group->gp_core)
@@ -1913,6 +2436,13 @@ static void mali_group_timeout(void *data)
 
 void mali_group_zap_session(struct mali_group *group, struct mali_session_data *session)
 {
+	mali_group_zap_session_range(group, session, 0, 0);
+}
+
+void mali_group_zap_session_range(struct mali_group *group, struct mali_session_data *session, u32 mali_address, u32 size)
+{
+	u32 num_pages = size / MALI_MMU_PAGE_SIZE;
+
 	MALI_DEBUG_ASSERT_POINTER(group);
 	MALI_DEBUG_ASSERT_POINTER(session);
 
@@ -1925,8 +2455,18 @@ void mali_group_zap_session(struct mali_group *group, struct mali_session_data *
 
 	if (group->session == session)
 	{
-		/* The Zap also does the stall and disable_stall */
-		mali_bool zap_success = mali_mmu_zap_tlb(group->mmu);
+		mali_bool zap_success;
+
+		/* Both also do the stall and disable_stall */
+		if (0 < num_pages && MALI_MMU_INVALIDATE_PAGES_MAX >= num_pages)
+		{
+			zap_success = mali_mmu_invalidate_pages(group->mmu, mali_address, num_pages);
+		}
+		else
+		{
+			zap_success = mali_mmu_zap_tlb(group->mmu);
+		}
+
 		if (MALI_TRUE != zap_success)
 		{
 			MALI_DEBUG_PRINT(2, ("Mali memory unmap failed. Doing pagefault handling.\n"));
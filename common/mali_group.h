@@ -61,6 +61,9 @@ struct mali_group
 	struct mali_pp_job          *pp_running_job;
 	u32                         pp_running_sub_job;
 
+	u64                         job_start_time;      /**< Time (in ns) at which the running GP or PP job was started */
+	u64                         job_stall_time;      /**< Time (in ns) at which the running GP job stalled on PLBU out of memory */
+
 	struct mali_l2_cache_core   *l2_cache_core[2];
 	u32                         l2_cache_core_ref_count[2];
 
@@ -85,10 +88,28 @@ struct mali_group
 	_mali_osk_wq_work_t         *bottom_half_work_gp;
 	_mali_osk_wq_work_t         *bottom_half_work_pp;
 
-	_mali_osk_timer_t           *timeout_timer;
+	u64                         job_deadline; /**< Time (in ns) at which the watchdog times out the running job, 0 if not watched. Protected by the watchdog lock */
 	mali_bool                   core_timed_out;
+	mali_bool                   pp_polled;    /**< MALI_TRUE if the running PP job is polled for completion instead of raising an interrupt */
 };
 
+/** @brief Initialize the job watchdog shared by all groups
+ */
+_mali_osk_errcode_t mali_group_watchdog_initialize(void);
+void mali_group_watchdog_terminate(void);
+
+/** @brief Initialize the PP completion poller shared by all groups
+ *
+ * When the PP job completion rate exceeds mali_pp_poll_threshold, completion
+ * interrupts are masked and the physical PP cores are polled instead.
+ */
+_mali_osk_errcode_t mali_group_pp_poll_initialize(void);
+void mali_group_pp_poll_terminate(void);
+
+/** @brief Dump the PP completion poller statistics to a buffer
+ */
+u32 mali_group_dump_pp_poll_stats(char *buf, u32 size);
+
 /** @brief Create a new Mali group object
  *
  * @param cluster Pointer to the cluster to which the group is connected.
@@ -148,6 +169,14 @@ void mali_group_reset(struct mali_group *group);
  */
 void mali_group_zap_session(struct mali_group* group, struct mali_session_data *session);
 
+/**
+ * @brief Invalidate a range of the TLB of \a group if it runs \a session
+ *
+ * Small ranges are invalidated page by page, larger ones zap the whole TLB.
+ * The page tables covering the range must be kept, a \a size of 0 always zaps the whole TLB.
+ */
+void mali_group_zap_session_range(struct mali_group *group, struct mali_session_data *session, u32 mali_address, u32 size);
+
 /** @brief Get pointer to GP core object
  */
 struct mali_gp_core* mali_group_get_gp_core(struct mali_group *group);
@@ -183,6 +212,16 @@ void mali_group_start_gp_job(struct mali_group *group, struct mali_gp_job *job);
 /** @brief Start fragment of PP job
  */
 void mali_group_start_pp_job(struct mali_group *group, struct mali_pp_job *job, u32 sub_job);
+/** @brief Stage fragment of PP job (L2, page directory and registers) without starting the core
+ *
+ * Used together with mali_group_commit_pp_job() to start several groups back-to-back.
+ * The group lock must be held for each call, it may be dropped in between since the
+ * PP scheduler has taken the group off its idle list.
+ */
+void mali_group_prepare_pp_job(struct mali_group *group, struct mali_pp_job *job, u32 sub_job);
+/** @brief Start the core with the fragment staged by mali_group_prepare_pp_job()
+ */
+void mali_group_commit_pp_job(struct mali_group *group);
 
 /** @brief Resume GP job that suspended waiting for more heap memory
  */
@@ -243,6 +282,29 @@ void mali_group_enable(struct mali_group *group);
  */
 void mali_group_disable(struct mali_group *group);
 
+/** @brief Get the number of PP cores in the group, one unless it is a virtual group
+ */
+MALI_STATIC_INLINE u32 mali_group_get_num_cores(struct mali_group *group)
+{
+	struct mali_group *child, *temp;
+	u32 num_cores = 0;
+
+	MALI_ASSERT_GROUP_LOCKED(group);
+
+	if (!mali_group_is_virtual(group))
+	{
+		return 1;
+	}
+
+	_MALI_OSK_LIST_FOREACHENTRY(child, temp, &group->group_list, struct mali_group, group_list)
+	{
+		num_cores++;
+	}
+
+	/* The job may outlive the cores which ran it, charge it at least once */
+	return (0 == num_cores) ? 1 : num_cores;
+}
+
 MALI_STATIC_INLINE mali_bool mali_group_virtual_disable_if_empty(struct mali_group *group)
 {
 	mali_bool empty = MALI_FALSE;
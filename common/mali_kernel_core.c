@@ -924,6 +924,18 @@ _mali_osk_errcode_t mali_initialize_subsystems(void)
 		if (_MALI_OSK_ERR_OK != err) goto dlbu_init_failed;
 	}
 
+	/* Initialize the job watchdog shared by all groups */
+	err = mali_group_watchdog_initialize();
+	if (_MALI_OSK_ERR_OK != err) goto watchdog_init_failed;
+
+	/* Initialize the PP completion poller shared by all groups */
+	err = mali_group_pp_poll_initialize();
+	if (_MALI_OSK_ERR_OK != err) goto pp_poll_init_failed;
+
+	/* Initialize the write tracking shared by all L2 caches */
+	err = mali_l2_cache_initialize();
+	if (_MALI_OSK_ERR_OK != err) goto l2_cache_init_failed;
+
 	/* Start configuring the actual Mali hardware. */
 	err = mali_parse_config_l2_cache();
 	if (_MALI_OSK_ERR_OK != err) goto config_parsing_failed;
@@ -959,6 +971,12 @@ scheduler_init_failed:
 config_parsing_failed:
 	mali_delete_groups(); /* Delete any groups not (yet) owned by a scheduler */
 	mali_delete_l2_cache_cores(); /* Delete L2 cache cores even if config parsing failed. */
+	mali_l2_cache_terminate();
+l2_cache_init_failed:
+	mali_group_pp_poll_terminate();
+pp_poll_init_failed:
+	mali_group_watchdog_terminate();
+watchdog_init_failed:
 dlbu_init_failed:
 	mali_dlbu_terminate();
 mmu_init_failed:
@@ -1012,6 +1030,9 @@ void mali_terminate_subsystems(void)
 	mali_gp_scheduler_terminate();
 	mali_scheduler_terminate();
 	mali_delete_l2_cache_cores();
+	mali_l2_cache_terminate();
+	mali_group_pp_poll_terminate();
+	mali_group_watchdog_terminate();
 	if (mali_is_mali450())
 	{
 		mali_dlbu_terminate();
@@ -1209,6 +1230,9 @@ _mali_osk_errcode_t _mali_ukk_open(void **context)
 #endif
 
 	session->is_compositor = MALI_FALSE;
+	_mali_osk_atomic_init(&session->job_generation, 0);
+	_mali_osk_atomic_init(&session->num_generation_jobs[0], 0);
+	_mali_osk_atomic_init(&session->num_generation_jobs[1], 0);
 
 	*context = (void*)session;
 
@@ -11,6 +11,8 @@
 #include "mali_kernel_common.h"
 #include "mali_kernel_memory_engine.h"
 #include "mali_osk.h"
+#include "mali_osk_mali.h"
+#include "mali_kernel_mem_os.h"
 
 typedef struct os_allocation
 {
@@ -44,6 +46,7 @@ static void os_allocator_release(void * ctx, void * handle);
 static void os_allocator_page_table_block_release( mali_page_table_block *page_table_block );
 static void os_allocator_destroy(mali_physical_memory_allocator * allocator);
 static u32 os_allocator_stat(mali_physical_memory_allocator * allocator);
+static u32 os_allocator_reserve(os_allocator * info, u32 num_pages);
 
 mali_physical_memory_allocator * mali_os_allocator_create(u32 max_allocation, u32 cpu_usage_adjust, const char *name)
 {
@@ -91,6 +94,32 @@ static u32 os_allocator_stat(mali_physical_memory_allocator * allocator)
 	return info->num_pages_allocated * _MALI_OSK_MALI_PAGE_SIZE;
 }
 
+/**
+ * Reserve room for a whole request against the allowed OS memory usage.
+ * Must be called with info->mutex held, which is kept until the reserved pages are accounted for.
+ * @param info The OS allocator
+ * @param num_pages Number of pages requested
+ * @return Number of pages which fit below num_pages_max, 0 if none fit or if the whole request would take the usage past the OS memory limit
+ */
+static u32 os_allocator_reserve(os_allocator * info, u32 num_pages)
+{
+	/* Page table blocks may take the usage past the maximum */
+	if (info->num_pages_allocated >= info->num_pages_max) return 0;
+
+	if (num_pages > info->num_pages_max - info->num_pages_allocated)
+	{
+		num_pages = info->num_pages_max - info->num_pages_allocated;
+	}
+
+	/* Check the usage once for the whole request, so that it can not go past the limit by a batch */
+	if (0 < num_pages && !_mali_osk_mem_check_allocated((info->num_pages_max - (num_pages - 1)) * _MALI_OSK_CPU_PAGE_SIZE))
+	{
+		return 0;
+	}
+
+	return num_pages;
+}
+
 static void os_allocator_destroy(mali_physical_memory_allocator * allocator)
 {
 	os_allocator * info;
@@ -108,8 +137,10 @@ static mali_physical_memory_allocation_result os_allocator_allocate(void* ctx, m
 	u32 left;
 	os_allocator * info;
 	os_allocation * allocation;
+	u32 *phys_pages;
 	int pages_allocated = 0;
 	_mali_osk_errcode_t err = _MALI_OSK_ERR_OK;
+	MALI_DEBUG_CODE(u64 start_time = _mali_osk_time_get_monotonic_ns();)
 
 	MALI_DEBUG_ASSERT_POINTER(ctx);
 	MALI_DEBUG_ASSERT_POINTER(engine);
@@ -120,20 +151,39 @@ static mali_physical_memory_allocation_result os_allocator_allocate(void* ctx, m
 	info = (os_allocator*)ctx;
 	left = descriptor->size - *offset;
 
-	if (_MALI_OSK_ERR_OK != _mali_osk_lock_wait(info->mutex, _MALI_OSK_LOCKMODE_RW)) return MALI_MEM_ALLOC_INTERNAL_FAILURE;
+	/* Scratch space for the physical addresses of one batch of pages */
+	phys_pages = _mali_osk_malloc(sizeof(u32) * MALI_OS_ALLOCATOR_BATCH_PAGES);
+	if (NULL == phys_pages) return MALI_MEM_ALLOC_INTERNAL_FAILURE;
+
+	if (_MALI_OSK_ERR_OK != _mali_osk_lock_wait(info->mutex, _MALI_OSK_LOCKMODE_RW))
+	{
+		_mali_osk_free(phys_pages);
+		return MALI_MEM_ALLOC_INTERNAL_FAILURE;
+	}
 
 	/** @note this code may not work on Linux, or may require a more complex Linux implementation */
 	allocation = _mali_osk_malloc(sizeof(os_allocation));
 	if (NULL != allocation)
 	{
-		u32 os_mem_max_usage = info->num_pages_max * _MALI_OSK_CPU_PAGE_SIZE;
+		u32 num_pages_reserved;
 		allocation->offset_start = *offset;
 		allocation->num_pages = ((left + _MALI_OSK_CPU_PAGE_SIZE - 1) & ~(_MALI_OSK_CPU_PAGE_SIZE - 1)) >> _MALI_OSK_CPU_PAGE_ORDER;
 		MALI_DEBUG_PRINT(6, ("Allocating page array of size %d bytes\n", allocation->num_pages * sizeof(struct page*)));
 
-		while (left > 0 && ((info->num_pages_allocated + pages_allocated) < info->num_pages_max) && _mali_osk_mem_check_allocated(os_mem_max_usage))
+		/* The whole request is reserved up front, the mutex is held until the pages are accounted for */
+		num_pages_reserved = os_allocator_reserve(info, allocation->num_pages);
+
+		while (left > 0 && pages_allocated < num_pages_reserved)
 		{
-			err = mali_allocation_engine_map_physical(engine, descriptor, *offset, MALI_MEMORY_ALLOCATION_OS_ALLOCATED_PHYSADDR_MAGIC, info->cpu_usage_adjust, _MALI_OSK_CPU_PAGE_SIZE);
+			/* Commit a batch of pages at once, limited by what is left of the reservation */
+			u32 num_pages = num_pages_reserved - pages_allocated;
+
+			if (num_pages > MALI_OS_ALLOCATOR_BATCH_PAGES)
+			{
+				num_pages = MALI_OS_ALLOCATOR_BATCH_PAGES;
+			}
+
+			err = mali_allocation_engine_map_os_pages(engine, descriptor, *offset, info->cpu_usage_adjust, phys_pages, &num_pages);
 			if ( _MALI_OSK_ERR_OK != err)
 			{
 				if (  _MALI_OSK_ERR_NOMEM == err)
@@ -158,12 +208,12 @@ static mali_physical_memory_allocation_result os_allocator_allocate(void* ctx, m
 			}
 
 			/* Loop iteration */
-			if (left < _MALI_OSK_CPU_PAGE_SIZE) left = 0;
-			else left -= _MALI_OSK_CPU_PAGE_SIZE;
+			if (left < num_pages * _MALI_OSK_CPU_PAGE_SIZE) left = 0;
+			else left -= num_pages * _MALI_OSK_CPU_PAGE_SIZE;
 
-			pages_allocated++;
+			pages_allocated += num_pages;
 
-			*offset += _MALI_OSK_CPU_PAGE_SIZE;
+			*offset += num_pages * _MALI_OSK_CPU_PAGE_SIZE;
 		}
 
 		if (left) MALI_PRINT(("Out of memory. Mali memory allocated: %d kB  Configured maximum OS memory usage: %d kB\n",
@@ -172,7 +222,7 @@ static mali_physical_memory_allocation_result os_allocator_allocate(void* ctx, m
 		/* Loop termination; decide on result */
 		if (pages_allocated)
 		{
-			MALI_DEBUG_PRINT(6, ("Allocated %d pages\n", pages_allocated));
+			MALI_DEBUG_PRINT(6, ("Allocated %d pages in %llu ns\n", pages_allocated, _mali_osk_time_get_monotonic_ns() - start_time));
 			if (left) result = MALI_MEM_ALLOC_PARTIAL;
 			else result = MALI_MEM_ALLOC_FINISHED;
 
@@ -201,6 +251,8 @@ static mali_physical_memory_allocation_result os_allocator_allocate(void* ctx, m
 
 	_mali_osk_lock_signal(info->mutex, _MALI_OSK_LOCKMODE_RW);
 
+	_mali_osk_free(phys_pages);
+
 	return result;
 }
 
@@ -240,6 +292,157 @@ static void os_allocator_release(void * ctx, void * handle)
 	_mali_osk_free(allocation);
 }
 
+_mali_osk_errcode_t mali_os_allocator_commit(mali_physical_memory_allocator *allocator, mali_allocation_engine engine, mali_memory_allocation *descriptor, u32 offset, u32 *num_pages)
+{
+	os_allocator * info;
+	u32 *phys_pages;
+	_mali_osk_errcode_t err;
+	u32 reserved;
+
+	MALI_DEBUG_ASSERT_POINTER(allocator);
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+	MALI_DEBUG_ASSERT_POINTER(num_pages);
+	MALI_DEBUG_ASSERT(0 < *num_pages && MALI_OS_ALLOCATOR_BATCH_PAGES >= *num_pages);
+
+	info = (os_allocator*)allocator->ctx;
+
+	phys_pages = _mali_osk_malloc(sizeof(u32) * *num_pages);
+	if (NULL == phys_pages) MALI_ERROR(_MALI_OSK_ERR_NOMEM);
+
+	if (_MALI_OSK_ERR_OK != _mali_osk_lock_wait(info->mutex, _MALI_OSK_LOCKMODE_RW))
+	{
+		_mali_osk_free(phys_pages);
+		MALI_ERROR(_MALI_OSK_ERR_FAULT);
+	}
+
+	reserved = os_allocator_reserve(info, *num_pages);
+	if (0 == reserved)
+	{
+		_mali_osk_lock_signal(info->mutex, _MALI_OSK_LOCKMODE_RW);
+		_mali_osk_free(phys_pages);
+		MALI_PRINT(("Out of memory. Mali memory allocated: %d kB  Configured maximum OS memory usage: %d kB\n",
+		            (info->num_pages_allocated * _MALI_OSK_CPU_PAGE_SIZE)/1024, (info->num_pages_max* _MALI_OSK_CPU_PAGE_SIZE)/1024));
+		MALI_ERROR(_MALI_OSK_ERR_NOMEM);
+	}
+
+	*num_pages = reserved;
+
+	err = mali_allocation_engine_map_os_pages(engine, descriptor, offset, info->cpu_usage_adjust, phys_pages, num_pages);
+	if (_MALI_OSK_ERR_OK == err)
+	{
+		_mali_osk_cache_ensure_uncached_range_flushed( (void *)descriptor, offset, *num_pages * _MALI_OSK_CPU_PAGE_SIZE );
+		info->num_pages_allocated += *num_pages;
+	}
+
+	_mali_osk_lock_signal(info->mutex, _MALI_OSK_LOCKMODE_RW);
+
+	_mali_osk_free(phys_pages);
+
+	return err;
+}
+
+void mali_os_allocator_decommit(mali_physical_memory_allocator *allocator, mali_allocation_engine engine, mali_memory_allocation *descriptor, u32 offset, u32 num_pages, _mali_osk_mem_mapregion_flags_t flags)
+{
+	os_allocator * info;
+
+	MALI_DEBUG_ASSERT_POINTER(allocator);
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+
+	info = (os_allocator*)allocator->ctx;
+
+	if (_MALI_OSK_ERR_OK != _mali_osk_lock_wait(info->mutex, _MALI_OSK_LOCKMODE_RW))
+	{
+		MALI_DEBUG_PRINT(1, ("allocator decommit: Failed to get mutex\n"));
+		return;
+	}
+
+	MALI_DEBUG_ASSERT( num_pages <= info->num_pages_allocated);
+	info->num_pages_allocated -= num_pages;
+
+	mali_allocation_engine_unmap_physical( engine, descriptor, offset, _MALI_OSK_CPU_PAGE_SIZE*num_pages,
+	                                       (_mali_osk_mem_mapregion_flags_t)(_MALI_OSK_MEM_MAPREGION_FLAG_OS_ALLOCATED_PHYSADDR | flags) );
+
+	_mali_osk_lock_signal(info->mutex, _MALI_OSK_LOCKMODE_RW);
+}
+
+u32 mali_os_allocator_available(mali_physical_memory_allocator *allocator)
+{
+	os_allocator * info;
+	u32 num_pages;
+
+	MALI_DEBUG_ASSERT_POINTER(allocator);
+
+	info = (os_allocator*)allocator->ctx;
+
+	_mali_osk_lock_wait(info->mutex, _MALI_OSK_LOCKMODE_RW);
+	/* Page table blocks may take the usage past the maximum */
+	num_pages = (info->num_pages_allocated < info->num_pages_max) ? info->num_pages_max - info->num_pages_allocated : 0;
+	_mali_osk_lock_signal(info->mutex, _MALI_OSK_LOCKMODE_RW);
+
+	return num_pages * _MALI_OSK_CPU_PAGE_SIZE;
+}
+
+mali_bool mali_os_allocator_backs(mali_physical_memory_allocator *allocator, mali_memory_allocation *descriptor)
+{
+	os_allocation * allocation;
+
+	MALI_DEBUG_ASSERT_POINTER(allocator);
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+
+	if (os_allocator_release != descriptor->physical_allocation.release
+	    || allocator->ctx != descriptor->physical_allocation.ctx
+	    || NULL != descriptor->physical_allocation.next)
+	{
+		return MALI_FALSE;
+	}
+
+	allocation = (os_allocation*)descriptor->physical_allocation.handle;
+
+	return (0 == allocation->offset_start && allocation->num_pages * _MALI_OSK_CPU_PAGE_SIZE >= descriptor->size) ? MALI_TRUE : MALI_FALSE;
+}
+
+_mali_osk_errcode_t mali_os_allocator_transfer(mali_physical_memory_allocator *allocator, mali_memory_allocation *from, mali_memory_allocation *to, u32 *phys_addrs, mali_physical_memory_allocation *alloc_info)
+{
+	os_allocator * info;
+	os_allocation * allocation;
+	_mali_osk_errcode_t err;
+	u32 i;
+
+	MALI_DEBUG_ASSERT_POINTER(allocator);
+	MALI_DEBUG_ASSERT_POINTER(phys_addrs);
+	MALI_DEBUG_ASSERT_POINTER(alloc_info);
+	MALI_DEBUG_ASSERT(MALI_TRUE == mali_os_allocator_backs(allocator, from));
+
+	info = (os_allocator*)allocator->ctx;
+	allocation = (os_allocation*)from->physical_allocation.handle;
+
+	if (from->size != to->size || 0 == (to->flags & MALI_MEMORY_ALLOCATION_FLAG_MAP_INTO_USERSPACE))
+	{
+		MALI_ERROR(_MALI_OSK_ERR_UNSUPPORTED);
+	}
+
+	err = _mali_osk_mem_mapregion_move(to, from, phys_addrs);
+	if (_MALI_OSK_ERR_OK != err)
+	{
+		MALI_ERROR(err);
+	}
+
+	/* Adjust for cpu physical address to mali physical address */
+	for (i = 0; i < allocation->num_pages; i++)
+	{
+		phys_addrs[i] -= info->cpu_usage_adjust;
+	}
+
+	/* Unmapped through the new allocation when released */
+	allocation->descriptor = to;
+
+	alloc_info->release = from->physical_allocation.release;
+	alloc_info->ctx = from->physical_allocation.ctx;
+	alloc_info->handle = from->physical_allocation.handle;
+
+	MALI_SUCCESS;
+}
+
 static mali_physical_memory_allocation_result os_allocator_allocate_page_table_block(void * ctx, mali_page_table_block * block)
 {
 	int allocation_order = 6; /* _MALI_OSK_CPU_PAGE_SIZE << 6 */
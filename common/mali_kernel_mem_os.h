@@ -11,6 +11,12 @@
 #ifndef __MALI_KERNEL_MEM_OS_H__
 #define __MALI_KERNEL_MEM_OS_H__
 
+/**
+ * Number of pages committed to an allocation at once. The MMU page table
+ * updates of a batch are made visible with a single barrier.
+ */
+#define MALI_OS_ALLOCATOR_BATCH_PAGES 512
+
 /**
  * @brief Creates an object that manages allocating OS memory
  *
@@ -32,6 +38,68 @@
  **/
 mali_physical_memory_allocator * mali_os_allocator_create(u32 max_allocation, u32 cpu_usage_adjust, const char *name);
 
+/**
+ * @brief Commit OS pages to part of a sparse allocation
+ *
+ * The pages are mapped at consecutive offsets on the CPU and the Mali side,
+ * and count against the maximum OS memory usage of the allocator.
+ *
+ * @param allocator OS memory allocator created by mali_os_allocator_create()
+ * @param engine The memory engine the allocation was made through
+ * @param descriptor The sparse allocation
+ * @param offset Offset from the start of the allocation of the first page
+ * @param num_pages [in,out] Number of pages to commit, at most MALI_OS_ALLOCATOR_BATCH_PAGES. Number of pages committed on return
+ * @return _MALI_OSK_ERR_OK if any pages were committed, _MALI_OSK_ERR_NOMEM if none could be
+ **/
+_mali_osk_errcode_t mali_os_allocator_commit(mali_physical_memory_allocator *allocator, mali_allocation_engine engine, mali_memory_allocation *descriptor, u32 offset, u32 *num_pages);
+
+/**
+ * @brief Decommit OS pages committed by mali_os_allocator_commit()
+ *
+ * The pages must already be removed from the Mali page tables.
+ *
+ * @param allocator OS memory allocator the pages were committed from
+ * @param engine The memory engine the allocation was made through
+ * @param descriptor The sparse allocation
+ * @param offset Offset from the start of the allocation of the first page
+ * @param num_pages Number of pages to decommit
+ * @param flags _MALI_OSK_MEM_MAPREGION_FLAG_DECOMMIT if the CPU mapping stays in use, 0 otherwise
+ **/
+void mali_os_allocator_decommit(mali_physical_memory_allocator *allocator, mali_allocation_engine engine, mali_memory_allocation *descriptor, u32 offset, u32 num_pages, _mali_osk_mem_mapregion_flags_t flags);
+
+/**
+ * @brief Check if all memory of an allocation comes from one allocation of an OS memory allocator
+ *
+ * @param allocator OS memory allocator created by mali_os_allocator_create()
+ * @param descriptor The allocation
+ * @return MALI_TRUE if the allocation's memory can be handed over with mali_os_allocator_transfer()
+ **/
+mali_bool mali_os_allocator_backs(mali_physical_memory_allocator *allocator, mali_memory_allocation *descriptor);
+
+/**
+ * @brief Hand the OS pages of a freed allocation over to a new allocation of the same size
+ *
+ * The pages are mapped into the CPU mapping of the new allocation, but not
+ * into the Mali page tables. The physical allocation is moved to alloc_info,
+ * the one of the freed allocation must not be released anymore.
+ *
+ * @param allocator OS memory allocator created by mali_os_allocator_create()
+ * @param from The freed allocation, for which mali_os_allocator_backs() is MALI_TRUE
+ * @param to The new allocation
+ * @param phys_addrs [out] Mali physical address of the page at each page offset
+ * @param alloc_info [out] Physical allocation of the new allocation
+ * @return _MALI_OSK_ERR_OK on success, nothing is changed otherwise
+ **/
+_mali_osk_errcode_t mali_os_allocator_transfer(mali_physical_memory_allocator *allocator, mali_memory_allocation *from, mali_memory_allocation *to, u32 *phys_addrs, mali_physical_memory_allocation *alloc_info);
+
+/**
+ * @brief Get how much more memory an OS memory allocator may hand out
+ *
+ * @param allocator OS memory allocator created by mali_os_allocator_create()
+ * @return Number of bytes left before the configured maximum OS memory usage is reached
+ **/
+u32 mali_os_allocator_available(mali_physical_memory_allocator *allocator);
+
 #endif /* __MALI_KERNEL_MEM_OS_H__ */
 
 
@@ -278,6 +278,64 @@ _mali_osk_errcode_t mali_allocation_engine_map_physical(mali_allocation_engine m
 	MALI_SUCCESS;
 }
 
+_mali_osk_errcode_t mali_allocation_engine_map_os_pages(mali_allocation_engine mem_engine, mali_memory_allocation * descriptor, u32 offset, u32 cpu_usage_adjust, u32 *phys_addrs, u32 *num_pages)
+{
+	_mali_osk_errcode_t err;
+	memory_engine * engine = (memory_engine*)mem_engine;
+	u32 i;
+
+	MALI_DEBUG_ASSERT_POINTER(engine);
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+	MALI_DEBUG_ASSERT_POINTER(phys_addrs);
+	MALI_DEBUG_ASSERT_POINTER(num_pages);
+	MALI_DEBUG_ASSERT(0 < *num_pages);
+
+	MALI_DEBUG_PRINT(7, ("Mapping %d OS pages at offset 0x%08X\n", *num_pages, offset));
+
+	/* The OS pages are allocated by the process address manager */
+	if (0 == (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_MAP_INTO_USERSPACE) || NULL == engine->process_address->map_physical_pages)
+	{
+		MALI_DEBUG_PRINT(2, ("Map failed: %s %d\n", __FUNCTION__, __LINE__));
+		MALI_ERROR(_MALI_OSK_ERR_UNSUPPORTED);
+	}
+
+	phys_addrs[0] = MALI_MEMORY_ALLOCATION_OS_ALLOCATED_PHYSADDR_MAGIC;
+	err = engine->process_address->map_physical_pages(descriptor, offset, phys_addrs, num_pages);
+	if ( _MALI_OSK_ERR_OK != err )
+	{
+		MALI_DEBUG_PRINT(2, ("Map failed: %s %d\n", __FUNCTION__, __LINE__));
+		MALI_ERROR( err );
+	}
+
+	/* Adjust for cpu physical address to mali physical address */
+	for (i = 0; i < *num_pages; i++)
+	{
+		phys_addrs[i] -= cpu_usage_adjust;
+	}
+
+	if (NULL != engine->mali_address->map_physical_pages)
+	{
+		err = engine->mali_address->map_physical_pages(descriptor, offset, phys_addrs, num_pages);
+	}
+	else
+	{
+		for (i = 0; i < *num_pages && _MALI_OSK_ERR_OK == err; i++)
+		{
+			err = engine->mali_address->map_physical(descriptor, offset + i * _MALI_OSK_CPU_PAGE_SIZE, &phys_addrs[i], _MALI_OSK_CPU_PAGE_SIZE);
+		}
+	}
+
+	if ( _MALI_OSK_ERR_OK != err )
+	{
+		MALI_DEBUG_PRINT( 2, ("Process address manager succeeded, but Mali Address manager failed for %d pages at offset=0x%08X. Will unmap.\n", *num_pages, offset));
+		engine->process_address->unmap_physical(descriptor, offset, *num_pages * _MALI_OSK_CPU_PAGE_SIZE, _MALI_OSK_MEM_MAPREGION_FLAG_OS_ALLOCATED_PHYSADDR);
+		MALI_DEBUG_PRINT(2, ("Map mali failed: %s %d\n", __FUNCTION__, __LINE__));
+		MALI_ERROR( err );
+	}
+
+	MALI_SUCCESS;
+}
+
 void mali_allocation_engine_unmap_physical(mali_allocation_engine mem_engine, mali_memory_allocation * descriptor, u32 offset, u32 size, _mali_osk_mem_mapregion_flags_t unmap_flags )
 {
 	memory_engine * engine = (memory_engine*)mem_engine;
@@ -43,6 +43,10 @@ typedef enum
 {
 	MALI_MEMORY_ALLOCATION_FLAG_MAP_INTO_USERSPACE = 0x1,
 	MALI_MEMORY_ALLOCATION_FLAG_MAP_GUARD_PAGE     = 0x2,
+	MALI_MEMORY_ALLOCATION_FLAG_SPARSE             = 0x4, /**< Pages are committed and decommitted after the allocation is made */
+	MALI_MEMORY_ALLOCATION_FLAG_CPU_CACHED         = 0x8, /**< Mapped cached into the process, kept coherent with _mali_osk_mem_mapregion_sync() */
+	MALI_MEMORY_ALLOCATION_FLAG_CPU_UNCACHED       = 0x10, /**< Mapped uncached into the process, rather than write-combined */
+	MALI_MEMORY_ALLOCATION_FLAG_USER_MEMORY        = 0x20, /**< Pinned process memory, kept coherent with _mali_osk_mem_mapregion_sync() */
 } mali_memory_allocation_flag;
 
 /**
@@ -66,6 +70,7 @@ typedef struct mali_memory_allocation
 	/* Manager specific information pointers */
 	void * mali_addr_mapping_info; /**< Mali address allocation specific info */
 	void * process_addr_mapping_info; /**< Mapping manager specific info */
+	void * va_range; /**< GPU virtual address range the Mali address manager tracks the allocation with */
 
 	mali_physical_memory_allocation physical_allocation;
 
@@ -128,6 +133,29 @@ typedef struct mali_kernel_mem_address_manager
 	  */
 	void (*unmap_physical)(mali_memory_allocation * descriptor, u32 offset, u32 size, _mali_osk_mem_mapregion_flags_t flags);
 
+	 /**
+	  * Function called to map a number of physical pages in one go.
+	  * The pages need not be physically contiguous, but are mapped at
+	  * consecutive offsets.
+	  *
+	  * @note this is optional. When not implemented, the value of this member
+	  * is NULL and map_physical is called for each page instead.
+	  *
+	  * @param[in] descriptor The memory descriptor in question
+	  * @param[in] offset Offset from the start of range of the first page
+	  * @param[in,out] phys_addrs Array of physical page addresses. When
+	  * phys_addrs[0] == MALI_MEMORY_ALLOCATION_OS_ALLOCATED_PHYSADDR_MAGIC, this
+	  * requests the function to allocate the physical pages itself, and return
+	  * their addresses through the array.
+	  * @param[in,out] num_pages Number of pages to map. When the function
+	  * allocates the pages itself, fewer pages may be mapped if memory runs out,
+	  * and the number of pages mapped is returned.
+	  * @return _MALI_OSK_ERR_OK on success, _MALI_OSK_ERR_NOMEM if no pages at
+	  * all could be allocated.
+	  * A value of type _mali_osk_errcode_t other than _MALI_OSK_ERR_OK indicates failure.
+	  */
+	_mali_osk_errcode_t (*map_physical_pages)(mali_memory_allocation * descriptor, u32 offset, u32 *phys_addrs, u32 *num_pages);
+
 } mali_kernel_mem_address_manager;
 
 mali_allocation_engine mali_allocation_engine_create(mali_kernel_mem_address_manager * mali_address_manager, mali_kernel_mem_address_manager * process_address_manager);
@@ -143,6 +171,14 @@ void mali_allocation_engine_release_pt2_physical_memory_free(mali_allocation_eng
 int mali_allocation_engine_map_physical(mali_allocation_engine engine, mali_memory_allocation * descriptor, u32 offset, u32 phys, u32 cpu_usage_adjust, u32 size);
 void mali_allocation_engine_unmap_physical(mali_allocation_engine engine, mali_memory_allocation * descriptor, u32 offset, u32 size, _mali_osk_mem_mapregion_flags_t unmap_flags);
 
+/**
+ * Allocate up to *num_pages OS pages and map them at consecutive offsets, starting at offset.
+ * The CPU and Mali side of the whole range are each set up in one pass.
+ * The Mali physical addresses of the pages are returned through phys_addrs,
+ * and the number of pages mapped through num_pages.
+ */
+_mali_osk_errcode_t mali_allocation_engine_map_os_pages(mali_allocation_engine engine, mali_memory_allocation * descriptor, u32 offset, u32 cpu_usage_adjust, u32 *phys_addrs, u32 *num_pages);
+
 int mali_allocation_engine_allocate_page_tables(mali_allocation_engine, mali_page_table_block * descriptor, mali_physical_memory_allocator * physical_provider);
 
 void mali_allocation_engine_report_allocators(mali_physical_memory_allocator * physical_provider);
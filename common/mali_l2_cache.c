@@ -25,6 +25,7 @@
  * See the hardware documentation for more information about each register
  */
 typedef enum mali_l2_cache_register {
+	MALI400_L2_CACHE_REGISTER_SIZE         = 0x0004, /**< Log2 of the cache geometry, see MALI400_L2_CACHE_SIZE_LOG2() */
 	MALI400_L2_CACHE_REGISTER_STATUS       = 0x0008,
 	/*unused                               = 0x000C */
 	MALI400_L2_CACHE_REGISTER_COMMAND      = 0x0010, /**< Misc cache commands, e.g. clear */
@@ -69,13 +70,60 @@ typedef enum mali_l2_cache_status
 
 #define MALI400_L2_MAX_READS_DEFAULT 0x1C
 
+/* Log2 of the cache size in bytes, from the size register */
+#define MALI400_L2_CACHE_SIZE_LOG2(size_reg) (((size_reg) >> 16) & 0xFF)
+
+/* Used when the size register does not describe the cache */
+#define MALI400_L2_CLEAR_PAGE_MAX_DEFAULT 16
+
 static struct mali_l2_cache_core *mali_global_l2_cache_cores[MALI_MAX_NUMBER_OF_L2_CACHE_CORES] = { NULL, };
 static u32 mali_global_num_l2_cache_cores = 0;
 
 int mali_l2_max_reads = MALI400_L2_MAX_READS_DEFAULT;
 
+/* Invalidations of more pages than this clear the whole cache, -1 picks it from the size of each cache */
+int mali_l2_clear_page_max = -1;
+
+static _mali_osk_atomic_t mali_l2_dirty_epoch;             /* Bumped on every recorded write the GPU did not do */
+static _mali_osk_atomic_t mali_l2_num_untracked_writers;   /* Memory written without it being recorded */
+static _mali_osk_atomic_t mali_l2_num_skipped_invalidations; /* Job start clears avoided since nothing was written */
+
 /* Local helper functions */
 static _mali_osk_errcode_t mali_l2_cache_send_command(struct mali_l2_cache_core *cache, u32 reg, u32 val);
+static _mali_osk_errcode_t mali_l2_cache_send_command_locked(struct mali_l2_cache_core *cache, u32 reg, u32 val);
+static _mali_osk_errcode_t mali_l2_cache_wait_command_idle(struct mali_l2_cache_core *cache);
+static u32 mali_l2_cache_get_clear_page_max(struct mali_l2_cache_core *cache);
+static _mali_osk_errcode_t mali_l2_cache_send_clear_all(struct mali_l2_cache_core *cache);
+
+_mali_osk_errcode_t mali_l2_cache_initialize(void)
+{
+	if (_MALI_OSK_ERR_OK != _mali_osk_atomic_init(&mali_l2_dirty_epoch, 0))
+	{
+		return _MALI_OSK_ERR_FAULT;
+	}
+
+	if (_MALI_OSK_ERR_OK != _mali_osk_atomic_init(&mali_l2_num_untracked_writers, 0))
+	{
+		_mali_osk_atomic_term(&mali_l2_dirty_epoch);
+		return _MALI_OSK_ERR_FAULT;
+	}
+
+	if (_MALI_OSK_ERR_OK != _mali_osk_atomic_init(&mali_l2_num_skipped_invalidations, 0))
+	{
+		_mali_osk_atomic_term(&mali_l2_num_untracked_writers);
+		_mali_osk_atomic_term(&mali_l2_dirty_epoch);
+		return _MALI_OSK_ERR_FAULT;
+	}
+
+	return _MALI_OSK_ERR_OK;
+}
+
+void mali_l2_cache_terminate(void)
+{
+	_mali_osk_atomic_term(&mali_l2_num_skipped_invalidations);
+	_mali_osk_atomic_term(&mali_l2_num_untracked_writers);
+	_mali_osk_atomic_term(&mali_l2_dirty_epoch);
+}
 
 
 struct mali_l2_cache_core *mali_l2_cache_create(_mali_osk_resource_t *resource)
@@ -97,7 +145,7 @@ struct mali_l2_cache_core *mali_l2_cache_create(_mali_osk_resource_t *resource)
 		return NULL;
 	}
 
-	cache = _mali_osk_malloc(sizeof(struct mali_l2_cache_core));
+	cache = _mali_osk_calloc(1, sizeof(struct mali_l2_cache_core));
 	if (NULL != cache)
 	{
 		cache->core_id =  mali_global_num_l2_cache_cores;
@@ -115,6 +163,7 @@ struct mali_l2_cache_core *mali_l2_cache_create(_mali_osk_resource_t *resource)
 					mali_l2_cache_reset(cache);
 
 					cache->last_invalidated_id = 0;
+					cache->clear_page_max = mali_l2_cache_get_clear_page_max(cache);
 
 					mali_global_l2_cache_cores[mali_global_num_l2_cache_cores] = cache;
 					mali_global_num_l2_cache_cores++;
@@ -300,7 +349,7 @@ u32 mali_l2_cache_core_get_glob_num_l2_cores(void)
 void mali_l2_cache_reset(struct mali_l2_cache_core *cache)
 {
 	/* Invalidate cache (just to keep it in a known state at startup) */
-	mali_l2_cache_send_command(cache, MALI400_L2_CACHE_REGISTER_COMMAND, MALI400_L2_CACHE_COMMAND_CLEAR_ALL);
+	mali_l2_cache_send_clear_all(cache);
 
 	/* Enable cache */
 	mali_hw_core_register_write(&cache->hw_core, MALI400_L2_CACHE_REGISTER_ENABLE, (u32)MALI400_L2_CACHE_ENABLE_ACCESS | (u32)MALI400_L2_CACHE_ENABLE_READ_ALLOCATE);
@@ -340,7 +389,7 @@ void mali_l2_cache_invalidate(struct mali_l2_cache_core *cache)
 	if (NULL != cache)
 	{
 		cache->last_invalidated_id = mali_scheduler_get_new_id();
-		mali_l2_cache_send_command(cache, MALI400_L2_CACHE_REGISTER_COMMAND, MALI400_L2_CACHE_COMMAND_CLEAR_ALL);
+		mali_l2_cache_send_clear_all(cache);
 	}
 }
 
@@ -365,7 +414,20 @@ mali_bool mali_l2_cache_invalidate_conditional(struct mali_l2_cache_core *cache,
 			cache->last_invalidated_id = mali_scheduler_get_new_id();
 		}
 
-		mali_l2_cache_send_command(cache, MALI400_L2_CACHE_REGISTER_COMMAND, MALI400_L2_CACHE_COMMAND_CLEAR_ALL);
+		/*
+		 * Nothing the job can read was written since the cache was last cleared.
+		 * With more than one L2 cache, GPU writes through another cache could
+		 * leave stale lines in this one, so it is only trusted with a single cache.
+		 */
+		if (1 == mali_global_num_l2_cache_cores
+		    && 0 == _mali_osk_atomic_read(&mali_l2_num_untracked_writers)
+		    && cache->dirty_epoch_seen == _mali_osk_atomic_read(&mali_l2_dirty_epoch))
+		{
+			_mali_osk_atomic_inc(&mali_l2_num_skipped_invalidations);
+			return MALI_FALSE;
+		}
+
+		mali_l2_cache_send_clear_all(cache);
 	}
 	return MALI_TRUE;
 }
@@ -380,7 +442,7 @@ void mali_l2_cache_invalidate_all(void)
 		{
 			_mali_osk_errcode_t ret;
 			mali_global_l2_cache_cores[i]->last_invalidated_id = mali_scheduler_get_new_id();
-			ret = mali_l2_cache_send_command(mali_global_l2_cache_cores[i], MALI400_L2_CACHE_REGISTER_COMMAND, MALI400_L2_CACHE_COMMAND_CLEAR_ALL);
+			ret = mali_l2_cache_send_clear_all(mali_global_l2_cache_cores[i]);
 			if (_MALI_OSK_ERR_OK != ret)
 			{
 				MALI_PRINT_ERROR(("Failed to invalidate cache\n"));
@@ -390,6 +452,69 @@ void mali_l2_cache_invalidate_all(void)
 	}
 }
 
+/* Accumulate a duration in microseconds, carrying the leftover nanoseconds to avoid a 64-bit division */
+MALI_STATIC_INLINE void mali_l2_cache_stats_add_time(u32 *us, u32 *ns, u64 start, u64 end)
+{
+	*ns += (u32)(end - start);
+	*us += *ns / 1000;
+	*ns %= 1000;
+}
+
+static void mali_l2_cache_invalidate_pages(struct mali_l2_cache_core *cache, u32 *pages, u32 num_pages)
+{
+	/* One clear all is cheaper than clearing more pages than the cache holds, one by one */
+	mali_bool clear_all = (num_pages > cache->clear_page_max) ? MALI_TRUE : MALI_FALSE;
+	_mali_osk_errcode_t ret = _MALI_OSK_ERR_OK;
+	u64 start;
+	u32 j;
+
+	if (clear_all)
+	{
+		cache->last_invalidated_id = mali_scheduler_get_new_id();
+	}
+
+	_mali_osk_lock_wait(cache->command_lock, _MALI_OSK_LOCKMODE_RW);
+
+	start = _mali_osk_time_get_monotonic_ns();
+
+	if (clear_all)
+	{
+		cache->dirty_epoch_seen = _mali_osk_atomic_read(&mali_l2_dirty_epoch);
+		ret = mali_l2_cache_send_command_locked(cache, MALI400_L2_CACHE_REGISTER_COMMAND, MALI400_L2_CACHE_COMMAND_CLEAR_ALL);
+		if (_MALI_OSK_ERR_OK == ret)
+		{
+			ret = mali_l2_cache_wait_command_idle(cache);
+		}
+
+		cache->num_all_clears++;
+		cache->num_pages_all_cleared += num_pages;
+		mali_l2_cache_stats_add_time(&cache->all_clear_us, &cache->all_clear_ns, start, _mali_osk_time_get_monotonic_ns());
+	}
+	else
+	{
+		/* The command lock is held for the whole run instead of once per page */
+		for (j = 0; j < num_pages && _MALI_OSK_ERR_OK == ret; j++)
+		{
+			ret = mali_l2_cache_send_command_locked(cache, MALI400_L2_CACHE_REGISTER_CLEAR_PAGE, pages[j]);
+		}
+		if (_MALI_OSK_ERR_OK == ret)
+		{
+			ret = mali_l2_cache_wait_command_idle(cache);
+		}
+
+		cache->num_page_clears++;
+		cache->num_pages_cleared += num_pages;
+		mali_l2_cache_stats_add_time(&cache->page_clear_us, &cache->page_clear_ns, start, _mali_osk_time_get_monotonic_ns());
+	}
+
+	_mali_osk_lock_signal(cache->command_lock, _MALI_OSK_LOCKMODE_RW);
+
+	if (_MALI_OSK_ERR_OK != ret)
+	{
+		MALI_PRINT_ERROR(("Failed to invalidate page cache\n"));
+	}
+}
+
 void mali_l2_cache_invalidate_all_pages(u32 *pages, u32 num_pages)
 {
 	u32 i;
@@ -398,21 +523,72 @@ void mali_l2_cache_invalidate_all_pages(u32 *pages, u32 num_pages)
 		/*additional check*/
 		if (MALI_TRUE == mali_l2_cache_lock_power_state(mali_global_l2_cache_cores[i]))
 		{
-			u32 j;
-			for (j = 0; j < num_pages; j++)
-			{
-				_mali_osk_errcode_t ret;
-				ret = mali_l2_cache_send_command(mali_global_l2_cache_cores[i], MALI400_L2_CACHE_REGISTER_CLEAR_PAGE, pages[j]);
-				if (_MALI_OSK_ERR_OK != ret)
-				{
-					MALI_PRINT_ERROR(("Failed to invalidate page cache\n"));
-				}
-			}
+			mali_l2_cache_invalidate_pages(mali_global_l2_cache_cores[i], pages, num_pages);
 		}
 		mali_l2_cache_unlock_power_state(mali_global_l2_cache_cores[i]);
 	}
 }
 
+void mali_l2_cache_mark_dirty(void)
+{
+	_mali_osk_atomic_inc(&mali_l2_dirty_epoch);
+}
+
+void mali_l2_cache_untracked_writer_add(void)
+{
+	_mali_osk_atomic_inc(&mali_l2_num_untracked_writers);
+}
+
+void mali_l2_cache_untracked_writer_remove(void)
+{
+	MALI_DEBUG_ASSERT(0 < _mali_osk_atomic_read(&mali_l2_num_untracked_writers));
+	_mali_osk_atomic_dec(&mali_l2_num_untracked_writers);
+}
+
+u32 mali_l2_cache_dump_stats(char *buf, u32 size)
+{
+	u32 n;
+	u32 i;
+
+	n = _mali_osk_snprintf(buf, size, "Job start clears skipped: %u, untracked writers: %u\n",
+	                       _mali_osk_atomic_read(&mali_l2_num_skipped_invalidations),
+	                       _mali_osk_atomic_read(&mali_l2_num_untracked_writers));
+	if (n >= size)
+	{
+		return size;
+	}
+
+	for (i = 0; i < mali_global_num_l2_cache_cores; i++)
+	{
+		struct mali_l2_cache_core *cache = mali_global_l2_cache_cores[i];
+		u32 num_page_clears, num_pages_cleared, page_clear_us;
+		u32 num_all_clears, num_pages_all_cleared, all_clear_us;
+
+		_mali_osk_lock_wait(cache->command_lock, _MALI_OSK_LOCKMODE_RW);
+		num_page_clears = cache->num_page_clears;
+		num_pages_cleared = cache->num_pages_cleared;
+		page_clear_us = cache->page_clear_us;
+		num_all_clears = cache->num_all_clears;
+		num_pages_all_cleared = cache->num_pages_all_cleared;
+		all_clear_us = cache->all_clear_us;
+		_mali_osk_lock_signal(cache->command_lock, _MALI_OSK_LOCKMODE_RW);
+
+		n += _mali_osk_snprintf(buf + n, size - n,
+		                        "%s: clear all above %u pages\n"
+		                        "  per page: %u invalidations, %u pages, %u us\n"
+		                        "  clear all: %u invalidations, %u pages, %u us\n",
+		                        cache->hw_core.description, cache->clear_page_max,
+		                        num_page_clears, num_pages_cleared, page_clear_us,
+		                        num_all_clears, num_pages_all_cleared, all_clear_us);
+		if (n >= size)
+		{
+			return size;
+		}
+	}
+
+	return n;
+}
+
 mali_bool mali_l2_cache_lock_power_state(struct mali_l2_cache_core *cache)
 {
 	return mali_pm_domain_lock_state(cache->pm_domain);
@@ -426,18 +602,29 @@ void mali_l2_cache_unlock_power_state(struct mali_l2_cache_core *cache)
 /* -------- local helper functions below -------- */
 
 
-static _mali_osk_errcode_t mali_l2_cache_send_command(struct mali_l2_cache_core *cache, u32 reg, u32 val)
+static u32 mali_l2_cache_get_clear_page_max(struct mali_l2_cache_core *cache)
 {
-	int i = 0;
-	const int loop_count = 100000;
+	u32 size_log2;
 
-	/*
-	 * Grab lock in order to send commands to the L2 cache in a serialized fashion.
-	 * The L2 cache will ignore commands if it is busy.
-	 */
-	_mali_osk_lock_wait(cache->command_lock, _MALI_OSK_LOCKMODE_RW);
+	if (0 <= mali_l2_clear_page_max)
+	{
+		return (u32)mali_l2_clear_page_max;
+	}
 
-	/* First, wait for L2 cache command handler to go idle */
+	/* Past as many pages as the cache holds, clearing page by page walks more lines than clearing it all */
+	size_log2 = MALI400_L2_CACHE_SIZE_LOG2(mali_hw_core_register_read(&cache->hw_core, MALI400_L2_CACHE_REGISTER_SIZE));
+	if (_MALI_OSK_MALI_PAGE_ORDER > size_log2 || 31 < size_log2)
+	{
+		return MALI400_L2_CLEAR_PAGE_MAX_DEFAULT;
+	}
+
+	return 1 << (size_log2 - _MALI_OSK_MALI_PAGE_ORDER);
+}
+
+static _mali_osk_errcode_t mali_l2_cache_wait_command_idle(struct mali_l2_cache_core *cache)
+{
+	int i = 0;
+	const int loop_count = 100000;
 
 	for (i = 0; i < loop_count; i++)
 	{
@@ -449,15 +636,43 @@ static _mali_osk_errcode_t mali_l2_cache_send_command(struct mali_l2_cache_core
 
 	if (i == loop_count)
 	{
-		_mali_osk_lock_signal(cache->command_lock, _MALI_OSK_LOCKMODE_RW);
 		MALI_DEBUG_PRINT(1, ( "Mali L2 cache: aborting wait for command interface to go idle\n"));
 		MALI_ERROR( _MALI_OSK_ERR_FAULT );
 	}
 
+	MALI_SUCCESS;
+}
+
+static _mali_osk_errcode_t mali_l2_cache_send_clear_all(struct mali_l2_cache_core *cache)
+{
+	/* Read before clearing, a write recorded meanwhile leaves the cache dirty */
+	cache->dirty_epoch_seen = _mali_osk_atomic_read(&mali_l2_dirty_epoch);
+	return mali_l2_cache_send_command(cache, MALI400_L2_CACHE_REGISTER_COMMAND, MALI400_L2_CACHE_COMMAND_CLEAR_ALL);
+}
+
+/* Must be called with the command lock held */
+static _mali_osk_errcode_t mali_l2_cache_send_command_locked(struct mali_l2_cache_core *cache, u32 reg, u32 val)
+{
+	/* First, wait for L2 cache command handler to go idle */
+	MALI_CHECK_NO_ERROR(mali_l2_cache_wait_command_idle(cache));
+
 	/* then issue the command */
 	mali_hw_core_register_write(&cache->hw_core, reg, val);
 
+	MALI_SUCCESS;
+}
+
+static _mali_osk_errcode_t mali_l2_cache_send_command(struct mali_l2_cache_core *cache, u32 reg, u32 val)
+{
+	_mali_osk_errcode_t ret;
+
+	/*
+	 * Grab lock in order to send commands to the L2 cache in a serialized fashion.
+	 * The L2 cache will ignore commands if it is busy.
+	 */
+	_mali_osk_lock_wait(cache->command_lock, _MALI_OSK_LOCKMODE_RW);
+	ret = mali_l2_cache_send_command_locked(cache, reg, val);
 	_mali_osk_lock_signal(cache->command_lock, _MALI_OSK_LOCKMODE_RW);
 
-	MALI_SUCCESS;
+	return ret;
 }
@@ -36,6 +36,16 @@ struct mali_l2_cache_core
 	u32                  counter_src1; /**< Performance counter 1, MALI_HW_CORE_NO_COUNTER for disabled */
 	u32                  last_invalidated_id;
 	struct mali_pm_domain *pm_domain;
+	u32                  clear_page_max;  /**< Invalidations of more pages than this clear the whole cache instead */
+	u32                  num_page_clears; /**< Page invalidations done page by page, protected by command_lock */
+	u32                  num_pages_cleared; /**< Pages cleared by those */
+	u32                  page_clear_us;   /**< Time spent clearing page by page, in microseconds */
+	u32                  page_clear_ns;   /**< Nanoseconds left over from page_clear_us */
+	u32                  num_all_clears;  /**< Page invalidations done by clearing the whole cache */
+	u32                  num_pages_all_cleared; /**< Pages asked for by those */
+	u32                  all_clear_us;    /**< Time spent clearing the whole cache for those, in microseconds */
+	u32                  all_clear_ns;    /**< Nanoseconds left over from all_clear_us */
+	u32                  dirty_epoch_seen; /**< Dirty epoch when the whole cache was last cleared */
 };
 
 _mali_osk_errcode_t mali_l2_cache_initialize(void);
@@ -69,6 +79,25 @@ mali_bool mali_l2_cache_invalidate_conditional(struct mali_l2_cache_core *cache,
 void mali_l2_cache_invalidate_all(void);
 void mali_l2_cache_invalidate_all_pages(u32 *pages, u32 num_pages);
 
+/**
+ * @brief Record that memory the GPU may read was written by someone else than the GPU
+ *
+ * Job start only clears an L2 cache if memory was recorded as written since the cache was last cleared.
+ */
+void mali_l2_cache_mark_dirty(void);
+
+/**
+ * @brief Register memory the GPU may read which can be written without it being recorded
+ *
+ * Like memory mapped uncached into a process, or owned by another driver.
+ * Job start clears the L2 caches unconditionally while any is registered.
+ */
+void mali_l2_cache_untracked_writer_add(void);
+void mali_l2_cache_untracked_writer_remove(void);
+
+/* Print how page invalidations were done on each L2 cache core */
+u32 mali_l2_cache_dump_stats(char *buf, u32 size);
+
 mali_bool mali_l2_cache_lock_power_state(struct mali_l2_cache_core *cache);
 void mali_l2_cache_unlock_power_state(struct mali_l2_cache_core *cache);
 
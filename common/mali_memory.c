@@ -80,6 +80,8 @@ typedef struct external_mem_allocation
  * @return _MALI_OSK_ERR_OK on success, otherwise a suitable _mali_osk_errcode_t on failure.
  */
 static _mali_osk_errcode_t _mali_ukk_mem_munmap_internal( _mali_uk_mem_munmap_s *args );
+static void mali_memory_free_deferred(void *data);
+static void mali_memory_make_room(struct mali_session_data *session_data, u32 size);
 
 #if defined(CONFIG_MALI400_UMP)
 static void ump_memory_release(void * ctx, void * handle);
@@ -96,10 +98,165 @@ static mali_physical_memory_allocation_result external_memory_commit(void* ctx,
 /* mali address manager needs to allocate page tables on allocate, write to page table(s) on map, write to page table(s) and release page tables on release */
 static _mali_osk_errcode_t  mali_address_manager_allocate(mali_memory_allocation * descriptor); /* validates the range, allocates memory for the page tables if needed */
 static _mali_osk_errcode_t  mali_address_manager_map(mali_memory_allocation * descriptor, u32 offset, u32 *phys_addr, u32 size);
+static _mali_osk_errcode_t  mali_address_manager_map_pages(mali_memory_allocation * descriptor, u32 offset, u32 *phys_addrs, u32 *num_pages);
 static void mali_address_manager_release(mali_memory_allocation * descriptor);
+static _mali_osk_errcode_t mali_process_address_allocate(mali_memory_allocation * descriptor); /* maps into the process, tracking mappings the CPU writes through unseen */
+static void mali_process_address_release(mali_memory_allocation * descriptor);
+
+/* Pages committed at once to grow-on-fault memory, around the faulting page */
+#define MALI_GROW_ON_FAULT_PAGES 16
+
+/* Part of the GPU virtual address space handed out by _mali_ukk_mem_alloc_va() */
+#define MALI_VA_ALLOC_START MALI_MMU_VIRTUAL_PAGE_SIZE
+#define MALI_VA_ALLOC_END   0xFFFFF000
+
+/**
+ * A range of GPU virtual address space in use by a session.
+ * Ranges are either reserved by _mali_ukk_mem_alloc_va(), or created on the fly
+ * for allocations placed by user space. They may overlap, as user space is free
+ * to place allocations where it likes.
+ */
+typedef struct mali_va_range
+{
+	_mali_osk_rbtree_node_t node;         /**< Node in the session's va_ranges tree, keyed by start */
+	u32 start;                            /**< First GPU virtual address of the range */
+	u32 size;                             /**< Size of the range, in bytes */
+	mali_bool reserved;                   /**< MALI_TRUE if reserved by _mali_ukk_mem_alloc_va() */
+	mali_bool sparse;                     /**< MALI_TRUE if memory mapped at the reservation is sparse */
+	mali_bool grow_on_fault;              /**< MALI_TRUE if GPU page faults on the sparse memory commit pages */
+	mali_memory_allocation_flag cpu_cache; /**< CPU cache flags for memory mapped at the reservation */
+	mali_memory_allocation *descriptor;   /**< Allocation mapped at the range, NULL if none */
+} mali_va_range;
+
+MALI_STATIC_INLINE mali_va_range *mali_va_range_entry(_mali_osk_rbtree_node_t *node)
+{
+	return (NULL == node) ? NULL : _MALI_OSK_CONTAINER_OF(node, mali_va_range, node);
+}
+
+/* Ranges in order of their start address. Must be called with the session memory lock held */
+MALI_STATIC_INLINE mali_va_range *mali_va_range_first(struct mali_session_data *session_data)
+{
+	return mali_va_range_entry(_mali_osk_rbtree_first(&session_data->va_ranges));
+}
+
+MALI_STATIC_INLINE mali_va_range *mali_va_range_next(mali_va_range *range)
+{
+	return mali_va_range_entry(_mali_osk_rbtree_next(&range->node));
+}
+
+MALI_STATIC_INLINE mali_va_range *mali_va_range_prev(mali_va_range *range)
+{
+	return mali_va_range_entry(_mali_osk_rbtree_prev(&range->node));
+}
+
+static void mali_va_range_remove(struct mali_session_data *session_data, mali_va_range *range);
+
+struct mali_slab_heap;
+
+/**
+ * Pages committed to a sparse allocation. Sparse allocations get their
+ * address space when they are mapped, but pages only through
+ * _mali_ukk_mem_commit(). Pages are committed from the OS memory allocator.
+ */
+typedef struct mali_sparse_allocation
+{
+	mali_allocation_engine engine;        /**< Engine the allocation was made through */
+	mali_memory_allocation *descriptor;   /**< The sparse allocation */
+	u32 num_pages;                        /**< Size of the allocation, in pages */
+	u32 num_committed;                    /**< Number of pages committed */
+	u32 *commit_map;                      /**< One bit per page, set if the page is committed */
+	_mali_osk_list_t purgeable_link;      /**< Link on the session's purgeable list, empty unless purgeable */
+	mali_bool purgeable;                  /**< MALI_TRUE if the pages may be decommitted under memory pressure */
+	mali_bool purged;                     /**< MALI_TRUE if the pages were decommitted since the allocation was made purgeable */
+	u32 purgeable_generation;             /**< Job generation of the session when the allocation was made purgeable */
+	struct mali_slab_heap *slab_heap;     /**< Set if small objects are suballocated from the memory */
+} mali_sparse_allocation;
+
+/* Slab suballocator for small objects in sparse memory, see _mali_ukk_mem_suballoc() */
+#define MALI_SLAB_PAGES 16 /* Size of a slab, in pages */
+#define MALI_SLAB_SIZE (MALI_SLAB_PAGES * _MALI_OSK_MALI_PAGE_SIZE)
+#define MALI_SLAB_MIN_ORDER 4  /* Smallest size class, 16 bytes */
+#define MALI_SLAB_MAX_ORDER 14 /* Largest size class, _MALI_MEM_SUBALLOC_MAX_SIZE */
+#define MALI_SLAB_NUM_CLASSES (MALI_SLAB_MAX_ORDER - MALI_SLAB_MIN_ORDER + 1)
+
+/**
+ * A slab holds objects of one size class in MALI_SLAB_SIZE bytes of a heap.
+ * Its pages are committed while the slab exists.
+ */
+typedef struct mali_slab
+{
+	_mali_osk_list_t list;                /**< Link on the size class' partial or full list */
+	u32 chunk;                            /**< Index of the slab sized chunk of the heap holding the slab */
+	u32 order;                            /**< Objects are 2^order bytes */
+	u32 num_used;                         /**< Number of objects allocated */
+	u32 *used_map;                        /**< One bit per object, set if the object is allocated */
+} mali_slab;
+
+/** Slabs and statistics of one size class */
+typedef struct mali_slab_class
+{
+	_mali_osk_list_t partial;             /**< Slabs with both allocated and free objects */
+	_mali_osk_list_t full;                /**< Slabs without free objects */
+	mali_slab *empty;                     /**< Empty slab kept to avoid decommitting and recommitting its pages */
+	u32 num_slabs;                        /**< Number of slabs, including the empty one */
+	u32 num_objects;                      /**< Number of objects allocated */
+	u32 num_allocs;                       /**< Objects allocated since the heap was created */
+	u32 num_frees;                        /**< Objects freed since the heap was created */
+} mali_slab_class;
+
+typedef struct mali_slab_heap
+{
+	_mali_osk_list_t list;                /**< Link on the session's slab_heaps list */
+	mali_sparse_allocation *sparse;       /**< Sparse memory the objects are placed in */
+	u32 num_chunks;                       /**< Number of slabs the memory can hold */
+	mali_slab **chunks;                   /**< Slab at each chunk, NULL if the chunk is unused */
+	mali_slab_class classes[MALI_SLAB_NUM_CLASSES];
+} mali_slab_heap;
+
+static void mali_slab_heap_destroy(mali_slab_heap *heap);
+
+/**
+ * Memory of a freed allocation, kept for a new allocation of the same size
+ * and cache settings. The allocation is gone from the GPU and the CPU, only
+ * its physical memory is left.
+ */
+typedef struct mali_free_cache_entry
+{
+	_mali_osk_list_t bucket_link;         /**< Link on the session's free_cache list for the size and cache settings */
+	_mali_osk_list_t lru_link;            /**< Link on the session's free_cache_lru list */
+	mali_memory_allocation *descriptor;   /**< The freed allocation */
+	u32 freed;                            /**< Tick count at which the allocation was freed */
+} mali_free_cache_entry;
+
+int mali_free_cache_max_size = 16 * 1024 * 1024; /* Bytes of freed memory each session keeps for reuse */
+int mali_free_cache_max_age_ms = 1000;           /* Time freed memory is kept for reuse */
+
+static mali_physical_memory_allocation_result sparse_memory_reserve(void* ctx, mali_allocation_engine * engine, mali_memory_allocation * descriptor, u32* offset, mali_physical_memory_allocation * alloc_info);
+static void sparse_memory_release(void * ctx, void * handle);
 
 /* MMU variables */
 
+/*
+ * Page table blocks are indexed by physical address so a released page finds
+ * its block without searching. The index hashes 256 KiB chunks of the
+ * physical address space, each block is linked into every chunk it spans.
+ */
+#define MALI_MMU_PAGE_TABLE_INDEX_SHIFT 18
+#define MALI_MMU_PAGE_TABLE_INDEX_SIZE 64
+
+/* Number of empty blocks kept to avoid freeing and reallocating blocks as page tables come and go */
+#ifndef MALI_MMU_PAGE_TABLE_CACHE_EMPTY_RESERVE
+#define MALI_MMU_PAGE_TABLE_CACHE_EMPTY_RESERVE 2
+#endif
+
+struct mali_mmu_page_table_allocation;
+
+typedef struct mali_mmu_page_table_index_link
+{
+	_mali_osk_list_t list;
+	struct mali_mmu_page_table_allocation *alloc;
+} mali_mmu_page_table_index_link;
+
 typedef struct mali_mmu_page_table_allocation
 {
 	_mali_osk_list_t list;
@@ -107,6 +264,8 @@ typedef struct mali_mmu_page_table_allocation
 	u32 usage_count;
 	u32 num_pages;
 	mali_page_table_block pages;
+	mali_mmu_page_table_index_link *index_links; /**< Links into the physical address index, one per chunk the block spans */
+	u32 num_index_links;
 } mali_mmu_page_table_allocation;
 
 typedef struct mali_mmu_page_table_allocations
@@ -114,7 +273,11 @@ typedef struct mali_mmu_page_table_allocations
 	_mali_osk_lock_t *lock;
 	_mali_osk_list_t partial;
 	_mali_osk_list_t full;
-	/* we never hold on to a empty allocation */
+	_mali_osk_list_t empty;    /**< Empty allocations kept in reserve */
+	u32 num_empty;
+	_mali_osk_list_t index[MALI_MMU_PAGE_TABLE_INDEX_SIZE];
+	_mali_osk_shrinker_t *shrinker; /**< Lets the OS reclaim the empty allocations */
+	_mali_osk_wq_work_t *shrink_work; /**< Releases the empty allocations, scheduled by shrinker */
 } mali_mmu_page_table_allocations;
 
 static mali_kernel_mem_address_manager mali_address_manager =
@@ -122,7 +285,8 @@ static mali_kernel_mem_address_manager mali_address_manager =
 	mali_address_manager_allocate, /* allocate */
 	mali_address_manager_release,  /* release */
 	mali_address_manager_map,      /* map_physical */
-	NULL                           /* unmap_physical not present*/
+	NULL,                          /* unmap_physical not present*/
+	mali_address_manager_map_pages /* map_physical_pages */
 };
 
 /* the mmu page table cache */
@@ -131,17 +295,27 @@ static struct mali_mmu_page_table_allocations page_table_cache;
 
 static mali_kernel_mem_address_manager process_address_manager =
 {
-	_mali_osk_mem_mapregion_init,  /* allocate */
-	_mali_osk_mem_mapregion_term,  /* release */
+	mali_process_address_allocate, /* allocate */
+	mali_process_address_release,  /* release */
 	_mali_osk_mem_mapregion_map,   /* map_physical */
-	_mali_osk_mem_mapregion_unmap  /* unmap_physical */
+	_mali_osk_mem_mapregion_unmap, /* unmap_physical */
+	_mali_osk_mem_mapregion_map_pages /* map_physical_pages */
 };
 
 static _mali_osk_errcode_t mali_mmu_page_table_cache_create(void);
 static void mali_mmu_page_table_cache_destroy(void);
+static u32 mali_memory_purgeable_shrink(u32 nr_pages, void *data);
+static void mali_memory_purge_work(void *data);
+static u32 mali_memory_free_cache_shrink(u32 nr_pages, void *data);
+static void mali_free_cache_trim(struct mali_session_data *session_data, mali_bool all);
+static void mali_free_cache_timeout(void *data);
 
 static mali_allocation_engine memory_engine = NULL;
 static mali_physical_memory_allocator * physical_memory_allocators = NULL;
+static mali_physical_memory_allocator * os_memory_allocator = NULL; /**< Also on physical_memory_allocators, commits pages to sparse allocations */
+static _mali_osk_shrinker_t *purgeable_shrinker = NULL; /**< Purges purgeable sparse allocations under memory pressure */
+static _mali_osk_wq_work_t *purge_work = NULL; /**< Purges the purgeable sparse allocations no job uses anymore, scheduled by purgeable_shrinker */
+static _mali_osk_shrinker_t *free_cache_shrinker = NULL; /**< Releases the freed memory sessions keep for reuse under memory pressure */
 
 static dedicated_memory_info * mem_region_registrations = NULL;
 
@@ -166,6 +340,18 @@ _mali_osk_errcode_t mali_memory_initialize(void)
 	memory_engine = mali_allocation_engine_create(&mali_address_manager, &process_address_manager);
 	MALI_CHECK_NON_NULL( memory_engine, _MALI_OSK_ERR_FAULT);
 
+	/* Not fatal, purgeable memory then just keeps its pages */
+	purge_work = _mali_osk_wq_create_work(mali_memory_purge_work, NULL);
+	if (NULL != purge_work)
+	{
+		purgeable_shrinker = _mali_osk_shrinker_register(mali_memory_purgeable_shrink, NULL);
+	}
+	MALI_DEBUG_PRINT_IF(1, NULL == purgeable_shrinker, ("Failed to register purgeable memory shrinker\n"));
+
+	/* Not fatal, freed memory is then only released when it ages */
+	free_cache_shrinker = _mali_osk_shrinker_register(mali_memory_free_cache_shrink, NULL);
+	MALI_DEBUG_PRINT_IF(1, NULL == free_cache_shrinker, ("Failed to register freed memory cache shrinker\n"));
+
 	MALI_SUCCESS;
 }
 
@@ -174,6 +360,24 @@ void mali_memory_terminate(void)
 {
 	MALI_DEBUG_PRINT(2, ("Memory system terminating\n"));
 
+	if (NULL != purgeable_shrinker)
+	{
+		_mali_osk_shrinker_unregister(purgeable_shrinker);
+		purgeable_shrinker = NULL;
+	}
+
+	if (NULL != purge_work)
+	{
+		_mali_osk_wq_delete_work(purge_work);
+		purge_work = NULL;
+	}
+
+	if (NULL != free_cache_shrinker)
+	{
+		_mali_osk_shrinker_unregister(free_cache_shrinker);
+		free_cache_shrinker = NULL;
+	}
+
 	mali_mmu_page_table_cache_destroy();
 
 	while ( NULL != mem_region_registrations)
@@ -185,6 +389,7 @@ void mali_memory_terminate(void)
 		_mali_osk_free(m);
 	}
 
+	os_memory_allocator = NULL;
 	while ( NULL != physical_memory_allocators)
 	{
 		mali_physical_memory_allocator * m;
@@ -202,6 +407,8 @@ void mali_memory_terminate(void)
 
 _mali_osk_errcode_t mali_memory_session_begin(struct mali_session_data * session_data)
 {
+	u32 i;
+
 	MALI_DEBUG_PRINT(5, ("Memory session begin\n"));
 
 	/* create descriptor mapping table */
@@ -223,6 +430,29 @@ _mali_osk_errcode_t mali_memory_session_begin(struct mali_session_data * session
 
 	/* Init the session's memory allocation list */
 	_MALI_OSK_INIT_LIST_HEAD( &session_data->memory_head );
+	_mali_osk_rbtree_init( &session_data->va_ranges );
+	_MALI_OSK_INIT_LIST_HEAD( &session_data->purgeable );
+	_MALI_OSK_INIT_LIST_HEAD( &session_data->free_pending );
+	_MALI_OSK_INIT_LIST_HEAD( &session_data->free_deferred );
+	_MALI_OSK_INIT_LIST_HEAD( &session_data->slab_heaps );
+	_MALI_OSK_INIT_LIST_HEAD( &session_data->free_cache_lru );
+	for (i = 0; i < MALI_SESSION_FREE_CACHE_BUCKETS; i++)
+	{
+		_MALI_OSK_INIT_LIST_HEAD( &session_data->free_cache[i] );
+	}
+	session_data->free_cache_size = 0;
+	session_data->free_cache_shrink = MALI_FALSE;
+
+	/* Not fatal, memory is then released right away when freed */
+	session_data->free_work = _mali_osk_wq_create_work(mali_memory_free_deferred, session_data);
+	MALI_DEBUG_PRINT_IF(2, NULL == session_data->free_work, ("Failed to create deferred free work\n"));
+
+	/* Not fatal either, freed memory is then not kept for reuse */
+	session_data->free_cache_timer = _mali_osk_timer_init();
+	if (NULL != session_data->free_cache_timer)
+	{
+		_mali_osk_timer_setcallback(session_data->free_cache_timer, mali_free_cache_timeout, session_data);
+	}
 
 	MALI_DEBUG_PRINT(5, ("MMU session begin: success\n"));
 	MALI_SUCCESS;
@@ -244,6 +474,8 @@ static void descriptor_table_cleanup_callback(int descriptor_id, void* map_targe
 void mali_memory_session_end(struct mali_session_data *session_data)
 {
 	_mali_osk_errcode_t err = _MALI_OSK_ERR_BUSY;
+	mali_va_range *range;
+	_mali_osk_timer_t *free_cache_timer;
 
 	MALI_DEBUG_PRINT(3, ("MMU session end\n"));
 
@@ -253,6 +485,27 @@ void mali_memory_session_end(struct mali_session_data *session_data)
 		return;
 	}
 
+	/* The timer is not armed again once it is gone from the session */
+	_mali_osk_lock_wait(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+	free_cache_timer = session_data->free_cache_timer;
+	session_data->free_cache_timer = NULL;
+	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	if (NULL != free_cache_timer)
+	{
+		_mali_osk_timer_del(free_cache_timer);
+		_mali_osk_timer_term(free_cache_timer);
+	}
+
+	/* Waits for the deferred frees in progress, memory freed from now on is released right away */
+	if (NULL != session_data->free_work)
+	{
+		_mali_osk_wq_delete_work(session_data->free_work);
+		session_data->free_work = NULL;
+	}
+	mali_memory_free_deferred(session_data);
+	MALI_DEBUG_ASSERT(_mali_osk_list_empty(&session_data->free_pending));
+
 	while (err == _MALI_OSK_ERR_BUSY)
 	{
 		/* Lock the session so we can modify the memory list */
@@ -318,6 +571,15 @@ void mali_memory_session_end(struct mali_session_data *session_data)
 		session_data->descriptor_mapping = NULL;
 	}
 
+	/* Free what is left, reservations user space never freed */
+	while (NULL != (range = mali_va_range_first(session_data)))
+	{
+		mali_va_range_remove(session_data, range);
+	}
+
+	/* Nothing is added to the cache anymore without free_work */
+	mali_free_cache_trim(session_data, MALI_TRUE);
+
 	_mali_osk_lock_signal( session_data->memory_lock, _MALI_OSK_LOCKMODE_RW );
 
 	/**
@@ -360,6 +622,8 @@ _mali_osk_errcode_t mali_memory_core_resource_os_memory(u32 size)
 	allocator->next = (*next_allocator_list);
 	(*next_allocator_list) = allocator;
 
+	os_memory_allocator = allocator;
+
 	MALI_SUCCESS;
 }
 
@@ -522,6 +786,9 @@ static mali_physical_memory_allocation_result ump_memory_commit(void* ctx, mali_
 	alloc_info->next = NULL;
 	alloc_info->release = ump_memory_release;
 
+	/* Other UMP users write to the memory without going through this driver */
+	mali_l2_cache_untracked_writer_add();
+
 	return MALI_MEM_ALLOC_FINISHED;
 }
 
@@ -548,6 +815,7 @@ static void ump_memory_release(void * ctx, void * handle)
 										   );
 	_mali_osk_free( allocation );
 
+	mali_l2_cache_untracked_writer_remove();
 
 	ump_dd_reference_release(ump_mem) ;
 	return;
@@ -731,6 +999,9 @@ static mali_physical_memory_allocation_result external_memory_commit(void* ctx,
 
 	ret_allocation->size = *offset - ret_allocation->initial_offset;
 
+	/* The owner of the memory writes to it without going through this driver */
+	mali_l2_cache_untracked_writer_add();
+
 	return MALI_MEM_ALLOC_FINISHED;
 }
 
@@ -753,6 +1024,8 @@ static void external_memory_release(void * ctx, void * handle)
 
 	_mali_osk_free( allocation );
 
+	mali_l2_cache_untracked_writer_remove();
+
 	return;
 }
 
@@ -767,6 +1040,7 @@ _mali_osk_errcode_t _mali_ukk_mem_write_safe(_mali_uk_mem_write_safe_s *args)
 
 	/* Return number of bytes actually copied */
 	args->size = _mali_osk_mem_write_safe(args->dest, args->src, args->size);
+	mali_l2_cache_mark_dirty();
 	return _MALI_OSK_ERR_OK;
 }
 
@@ -907,166 +1181,1903 @@ _mali_osk_errcode_t _mali_ukk_term_mem( _mali_uk_term_mem_s *args )
 	MALI_SUCCESS;
 }
 
-static _mali_osk_errcode_t mali_address_manager_allocate(mali_memory_allocation * descriptor)
+/* Insert a range into the session's range tree. Must be called with the session memory lock held */
+static mali_va_range *mali_va_range_insert(struct mali_session_data *session_data, u32 start, u32 size)
 {
-	struct mali_session_data *session_data;
-	u32 actual_size;
-
-	MALI_DEBUG_ASSERT_POINTER(descriptor);
+	mali_va_range *range;
+	_mali_osk_rbtree_node_t **link = _mali_osk_rbtree_root(&session_data->va_ranges);
+	_mali_osk_rbtree_node_t *parent = NULL;
 
-	session_data = (struct mali_session_data *)descriptor->mali_addr_mapping_info;
+	range = _mali_osk_calloc(1, sizeof(mali_va_range));
+	if (NULL == range)
+	{
+		return NULL;
+	}
 
-	actual_size = descriptor->size;
+	range->start = start;
+	range->size = size;
 
-	if (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_MAP_GUARD_PAGE)
+	/* Ranges starting at the same address go after the ones already there */
+	while (NULL != *link)
 	{
-		actual_size += _MALI_OSK_MALI_PAGE_SIZE;
+		parent = *link;
+		if (start < mali_va_range_entry(parent)->start)
+		{
+			link = _mali_osk_rbtree_left(parent);
+		}
+		else
+		{
+			link = _mali_osk_rbtree_right(parent);
+		}
 	}
 
-	return mali_mmu_pagedir_map(session_data->page_directory, descriptor->mali_address, actual_size);
+	_mali_osk_rbtree_insert(&session_data->va_ranges, &range->node, parent, link);
+
+	return range;
 }
 
-static void mali_address_manager_release(mali_memory_allocation * descriptor)
+static void mali_va_range_remove(struct mali_session_data *session_data, mali_va_range *range)
 {
-	const u32 illegal_mali_address = 0xffffffff;
-	struct mali_session_data *session_data;
-	MALI_DEBUG_ASSERT_POINTER(descriptor);
+	_mali_osk_rbtree_erase(&session_data->va_ranges, &range->node);
+	_mali_osk_free(range);
+}
 
-	/* It is allowed to call this function several times on the same descriptor.
-	   When memory is released we set the illegal_mali_address so we can early out here. */
-	if ( illegal_mali_address == descriptor->mali_address) return;
+/* First range starting at or above start, NULL if none */
+static mali_va_range *mali_va_range_find_from(struct mali_session_data *session_data, u32 start)
+{
+	_mali_osk_rbtree_node_t *node = *_mali_osk_rbtree_root(&session_data->va_ranges);
+	mali_va_range *found = NULL;
 
-	session_data = (struct mali_session_data *)descriptor->mali_addr_mapping_info;
-	mali_mmu_pagedir_unmap(session_data->page_directory, descriptor->mali_address, descriptor->size);
+	while (NULL != node)
+	{
+		mali_va_range *range = mali_va_range_entry(node);
 
-	descriptor->mali_address = illegal_mali_address ;
+		if (range->start >= start)
+		{
+			found = range;
+			node = *_mali_osk_rbtree_left(node);
+		}
+		else
+		{
+			node = *_mali_osk_rbtree_right(node);
+		}
+	}
+
+	return found;
 }
 
-static _mali_osk_errcode_t mali_address_manager_map(mali_memory_allocation * descriptor, u32 offset, u32 *phys_addr, u32 size)
+/* Last range starting at or below address, NULL if none */
+static mali_va_range *mali_va_range_find_below(struct mali_session_data *session_data, u32 address)
 {
-	struct mali_session_data *session_data;
-	u32 mali_address;
+	_mali_osk_rbtree_node_t *node = *_mali_osk_rbtree_root(&session_data->va_ranges);
+	mali_va_range *found = NULL;
 
-	MALI_DEBUG_ASSERT_POINTER(descriptor);
-	MALI_DEBUG_ASSERT_POINTER(phys_addr);
+	while (NULL != node)
+	{
+		mali_va_range *range = mali_va_range_entry(node);
 
-	session_data = (struct mali_session_data *)descriptor->mali_addr_mapping_info;
-	MALI_DEBUG_ASSERT_POINTER(session_data);
+		if (range->start <= address)
+		{
+			found = range;
+			node = *_mali_osk_rbtree_right(node);
+		}
+		else
+		{
+			node = *_mali_osk_rbtree_left(node);
+		}
+	}
 
-	mali_address = descriptor->mali_address + offset;
+	return found;
+}
 
-	MALI_DEBUG_PRINT(7, ("Mali map: mapping 0x%08X to Mali address 0x%08X length 0x%08X\n", *phys_addr, mali_address, size));
+static mali_va_range *mali_va_range_find_reserved(struct mali_session_data *session_data, u32 start)
+{
+	mali_va_range *range;
 
-	mali_mmu_pagedir_update(session_data->page_directory, mali_address, *phys_addr, size, descriptor->cache_settings);
+	for (range = mali_va_range_find_from(session_data, start); NULL != range && range->start == start; range = mali_va_range_next(range))
+	{
+		if (MALI_TRUE == range->reserved)
+		{
+			return range;
+		}
+	}
 
-	MALI_SUCCESS;
+	return NULL;
 }
 
-/* This handler registered to mali_mmap for MMU builds */
-_mali_osk_errcode_t _mali_ukk_mem_mmap( _mali_uk_mem_mmap_s *args )
+static mali_va_range *mali_va_range_find_mapped(struct mali_session_data *session_data, u32 start)
 {
-	struct mali_session_data *session_data;
-	mali_memory_allocation * descriptor;
-
-	/* validate input */
-	if (NULL == args) { MALI_DEBUG_PRINT(3,("mali_ukk_mem_mmap: args was NULL\n")); MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS); }
-
-	/* Unpack arguments */
-	session_data = (struct mali_session_data *)args->ctx;
+	mali_va_range *range;
 
-	/* validate input */
-	if (NULL == session_data) { MALI_DEBUG_PRINT(3,("mali_ukk_mem_mmap: session data was NULL\n")); MALI_ERROR(_MALI_OSK_ERR_FAULT); }
+	for (range = mali_va_range_find_from(session_data, start); NULL != range && range->start == start; range = mali_va_range_next(range))
+	{
+		if (NULL != range->descriptor)
+		{
+			return range;
+		}
+	}
 
-	descriptor = (mali_memory_allocation*) _mali_osk_calloc( 1, sizeof(mali_memory_allocation) );
-	if (NULL == descriptor) { MALI_DEBUG_PRINT(3,("mali_ukk_mem_mmap: descriptor was NULL\n")); MALI_ERROR(_MALI_OSK_ERR_NOMEM); }
+	return NULL;
+}
 
-	descriptor->size = args->size;
-	descriptor->mali_address = args->phys_addr;
-	descriptor->mali_addr_mapping_info = (void*)session_data;
+/* End of a range, saturated so ranges placed by user space at the top of the address space do not wrap */
+MALI_STATIC_INLINE u32 mali_va_range_end(mali_va_range *range)
+{
+	u32 end = range->start + range->size;
+	return (end < range->start) ? 0xFFFFFFFF : end;
+}
 
-	descriptor->process_addr_mapping_info = args->ukk_private; /* save to be used during physical manager callback */
-	descriptor->flags = MALI_MEMORY_ALLOCATION_FLAG_MAP_INTO_USERSPACE;
-	descriptor->cache_settings = (u32) args->cache_settings ;
-	descriptor->lock = session_data->memory_lock;
-	_mali_osk_list_init( &descriptor->list );
+/* Number of page tables which have to be created to map [start, start + size), tables_below as set up by mali_va_place() */
+MALI_STATIC_INLINE u32 mali_va_new_page_tables(const u16 *tables_below, u32 start, u32 size)
+{
+	u32 first = MALI_MMU_PDE_ENTRY(start);
+	u32 last = MALI_MMU_PDE_ENTRY(start + size - 1);
 
-	_mali_osk_lock_wait(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+	return (last + 1 - first) - (tables_below[last + 1] - tables_below[first]);
+}
 
-	if (0 == mali_allocation_engine_allocate_memory(memory_engine, descriptor, physical_memory_allocators, &session_data->memory_head))
-	{
-		/* We do not FLUSH nor TLB_ZAP on MMAP, since we do both of those on job start*/
-	   	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+/**
+ * Best placement found so far by mali_va_place()
+ */
+struct mali_va_placement
+{
+	u32 address;   /**< Candidate address, 0 if none found yet */
+	u32 cost;      /**< Number of page tables the candidate needs */
+	u32 gap_size;  /**< Size of the gap the candidate is in */
+};
 
-		args->mapping = descriptor->mapping;
-		args->cookie = (u32)descriptor;
+static void mali_va_place_candidate(const u16 *tables_below, struct mali_va_placement *best, u32 address, u32 size, u32 gap_size)
+{
+	u32 cost = mali_va_new_page_tables(tables_below, address, size);
 
-		MALI_DEBUG_PRINT(7, ("MMAP OK\n"));
-		MALI_SUCCESS;
-	}
-	else
+	if (0 == best->address
+	    || cost < best->cost
+	    || (cost == best->cost && gap_size < best->gap_size)
+	    || (cost == best->cost && gap_size == best->gap_size && address < best->address))
 	{
-	   	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
-		/* OOM, but not a fatal error */
-		MALI_DEBUG_PRINT(4, ("Memory allocation failure, OOM\n"));
-		_mali_osk_free(descriptor);
-		/* Linux will free the CPU address allocation, userspace client the Mali address allocation */
-		MALI_ERROR(_MALI_OSK_ERR_FAULT);
+		best->address = address;
+		best->cost = cost;
+		best->gap_size = gap_size;
 	}
 }
 
-static _mali_osk_errcode_t _mali_ukk_mem_munmap_internal( _mali_uk_mem_munmap_s *args )
+static void mali_va_place_in_gap(const u16 *tables_below, struct mali_va_placement *best, u32 gap_start, u32 gap_end, u32 size)
 {
-	struct mali_session_data *session_data;
-	mali_memory_allocation * descriptor;
+	u32 aligned;
 
-	descriptor = (mali_memory_allocation *)args->cookie;
-	MALI_DEBUG_ASSERT_POINTER(descriptor);
+	if (gap_start < MALI_VA_ALLOC_START) gap_start = MALI_VA_ALLOC_START;
+	if (gap_end > MALI_VA_ALLOC_END) gap_end = MALI_VA_ALLOC_END;
+	if (gap_end <= gap_start || gap_end - gap_start < size) return;
 
-	/** @note args->context unused; we use the memory_session from the cookie */
-	/* args->mapping and args->size are also discarded. They are only necessary
-	   for certain do_munmap implementations. However, they could be used to check the
-	   descriptor at this point. */
+	/* Either end of the gap packs the range against its neighbours, which share their page tables */
+	mali_va_place_candidate(tables_below, best, gap_start, size, gap_end - gap_start);
+	mali_va_place_candidate(tables_below, best, gap_end - size, size, gap_end - gap_start);
 
-	session_data = (struct mali_session_data *)descriptor->mali_addr_mapping_info;
-	MALI_DEBUG_ASSERT_POINTER(session_data);
+	/* Starting on a page table boundary needs the fewest page tables in an empty area */
+	aligned = (gap_start + MALI_MMU_VIRTUAL_PAGE_SIZE - 1) & ~(MALI_MMU_VIRTUAL_PAGE_SIZE - 1);
+	if (aligned > gap_start && aligned < gap_end && gap_end - aligned >= size)
+	{
+		mali_va_place_candidate(tables_below, best, aligned, size, gap_end - gap_start);
+	}
+}
 
-	/* Unmapping the memory from the mali virtual address space.
-	   It is allowed to call this function severeal times, which might happen if zapping below fails. */
-	mali_allocation_engine_release_pt1_mali_pagetables_unmap(memory_engine, descriptor);
+/**
+ * Find a free range of GPU virtual address space for a session.
+ * Of the free gaps large enough, the placement which needs the fewest new page
+ * tables wins, then the one in the smallest gap, to keep large gaps intact.
+ * The page tables are counted once up front, so each candidate costs the same
+ * regardless of its size.
+ * Must be called with the session memory lock held.
+ * @return The address of the range, 0 if no gap is large enough
+ */
+static u32 mali_va_place(struct mali_session_data *session_data, u32 size)
+{
+	struct mali_va_placement best = { 0, 0, 0 };
+	mali_va_range *range;
+	u32 gap_start = 0;
+	u16 *tables_below;
+	u32 i;
 
-	mali_scheduler_zap_all_active(session_data);
+	/* tables_below[i] is the number of page tables in use below PDE i */
+	tables_below = _mali_osk_malloc((MALI_MMU_PDE_ENTRY(0xFFFFFFFF) + 2) * sizeof(u16));
+	if (NULL == tables_below)
+	{
+		return 0;
+	}
 
-	/* Removes the descriptor from the session's memory list, releases physical memory, releases descriptor */
-	mali_allocation_engine_release_pt2_physical_memory_free(memory_engine, descriptor);
+	tables_below[0] = 0;
+	for (i = 0; i <= MALI_MMU_PDE_ENTRY(0xFFFFFFFF); i++)
+	{
+		tables_below[i + 1] = tables_below[i] + ((NULL != session_data->page_directory->page_entries_mapped[i]) ? 1 : 0);
+	}
 
-	_mali_osk_free(descriptor);
+	for (range = mali_va_range_first(session_data); NULL != range; range = mali_va_range_next(range))
+	{
+		if (range->start > gap_start)
+		{
+			mali_va_place_in_gap(tables_below, &best, gap_start, range->start, size);
+		}
+		if (mali_va_range_end(range) > gap_start)
+		{
+			gap_start = mali_va_range_end(range);
+		}
+	}
+	mali_va_place_in_gap(tables_below, &best, gap_start, MALI_VA_ALLOC_END, size);
 
-	return _MALI_OSK_ERR_OK;
+	_mali_osk_free(tables_below);
+
+	return best.address;
 }
 
-/* Handler for unmapping memory for MMU builds */
-_mali_osk_errcode_t _mali_ukk_mem_munmap( _mali_uk_mem_munmap_s *args )
+_mali_osk_errcode_t _mali_ukk_mem_alloc_va( _mali_uk_mem_alloc_va_s *args )
 {
-	mali_memory_allocation * descriptor;
-	_mali_osk_lock_t *descriptor_lock;
-	_mali_osk_errcode_t err;
-
-	descriptor = (mali_memory_allocation *)args->cookie;
-	MALI_DEBUG_ASSERT_POINTER(descriptor);
+	struct mali_session_data *session_data;
+	mali_va_range *range;
+	u32 address;
 
-	/** @note args->context unused; we use the memory_session from the cookie */
-	/* args->mapping and args->size are also discarded. They are only necessary
-	for certain do_munmap implementations. However, they could be used to check the
-	descriptor at this point. */
+	MALI_DEBUG_ASSERT_POINTER(args);
+	MALI_CHECK_NON_NULL(args->ctx, _MALI_OSK_ERR_INVALID_ARGS);
 
-	MALI_DEBUG_ASSERT_POINTER((struct mali_session_data *)descriptor->mali_addr_mapping_info);
+	session_data = (struct mali_session_data *)args->ctx;
 
-	descriptor_lock = descriptor->lock; /* should point to the session data lock... */
+	if (0 == args->size || 0 != (args->size % _MALI_OSK_MALI_PAGE_SIZE) || args->size > MALI_VA_ALLOC_END - MALI_VA_ALLOC_START)
+	{
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
 
-	err = _MALI_OSK_ERR_BUSY;
-	while (err == _MALI_OSK_ERR_BUSY)
+	/* Pages for sparse memory come from OS memory only */
+	if ((args->flags & _MALI_MEM_ALLOC_VA_GROW_ON_FAULT) && 0 == (args->flags & _MALI_MEM_ALLOC_VA_SPARSE))
 	{
-		if (descriptor_lock)
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
+	if ((args->flags & _MALI_MEM_ALLOC_VA_SPARSE) && NULL == os_memory_allocator)
+	{
+		MALI_ERROR(_MALI_OSK_ERR_UNSUPPORTED);
+	}
+	if ((args->flags & _MALI_MEM_ALLOC_VA_CPU_CACHED) && (args->flags & _MALI_MEM_ALLOC_VA_CPU_UNCACHED))
+	{
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
+
+	_mali_osk_lock_wait(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	address = mali_va_place(session_data, args->size);
+	if (0 == address)
+	{
+		_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_DEBUG_PRINT(2, ("No GPU virtual address range of 0x%08X bytes left\n", args->size));
+		MALI_ERROR(_MALI_OSK_ERR_NOMEM);
+	}
+
+	range = mali_va_range_insert(session_data, address, args->size);
+	if (NULL == range)
+	{
+		_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_ERROR(_MALI_OSK_ERR_NOMEM);
+	}
+	range->reserved = MALI_TRUE;
+	range->sparse = (args->flags & _MALI_MEM_ALLOC_VA_SPARSE) ? MALI_TRUE : MALI_FALSE;
+	range->grow_on_fault = (args->flags & _MALI_MEM_ALLOC_VA_GROW_ON_FAULT) ? MALI_TRUE : MALI_FALSE;
+	if (args->flags & _MALI_MEM_ALLOC_VA_CPU_CACHED)
+	{
+		range->cpu_cache = MALI_MEMORY_ALLOCATION_FLAG_CPU_CACHED;
+	}
+	else if (args->flags & _MALI_MEM_ALLOC_VA_CPU_UNCACHED)
+	{
+		range->cpu_cache = MALI_MEMORY_ALLOCATION_FLAG_CPU_UNCACHED;
+	}
+
+	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	MALI_DEBUG_PRINT(4, ("Reserved GPU virtual range 0x%08X-0x%08X\n", address, address + args->size - 1));
+
+	args->mali_address = address;
+	MALI_SUCCESS;
+}
+
+_mali_osk_errcode_t _mali_ukk_mem_free_va( _mali_uk_mem_free_va_s *args )
+{
+	struct mali_session_data *session_data;
+	mali_va_range *range;
+
+	MALI_DEBUG_ASSERT_POINTER(args);
+	MALI_CHECK_NON_NULL(args->ctx, _MALI_OSK_ERR_INVALID_ARGS);
+
+	session_data = (struct mali_session_data *)args->ctx;
+
+	_mali_osk_lock_wait(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	range = mali_va_range_find_reserved(session_data, args->mali_address);
+	if (NULL == range || NULL != range->descriptor)
+	{
+		_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_DEBUG_PRINT(2, ("Unable to free GPU virtual range at 0x%08X, not reserved or still mapped\n", args->mali_address));
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
+
+	mali_va_range_remove(session_data, range);
+
+	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	MALI_SUCCESS;
+}
+
+static mali_physical_memory_allocation_result sparse_memory_reserve(void* ctx, mali_allocation_engine * engine, mali_memory_allocation * descriptor, u32* offset, mali_physical_memory_allocation * alloc_info)
+{
+	mali_sparse_allocation *sparse;
+
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+	MALI_DEBUG_ASSERT_POINTER(offset);
+	MALI_DEBUG_ASSERT_POINTER(alloc_info);
+
+	sparse = _mali_osk_calloc(1, sizeof(mali_sparse_allocation));
+	if (NULL == sparse) return MALI_MEM_ALLOC_INTERNAL_FAILURE;
+
+	sparse->engine = (mali_allocation_engine)engine;
+	sparse->descriptor = descriptor;
+	sparse->num_pages = descriptor->size / _MALI_OSK_MALI_PAGE_SIZE;
+	sparse->commit_map = _mali_osk_calloc((sparse->num_pages + 31) / 32, sizeof(u32));
+	if (NULL == sparse->commit_map)
+	{
+		_mali_osk_free(sparse);
+		return MALI_MEM_ALLOC_INTERNAL_FAILURE;
+	}
+	_MALI_OSK_INIT_LIST_HEAD(&sparse->purgeable_link);
+
+	/* The whole range is accounted for, without any pages */
+	*offset = descriptor->size;
+
+	alloc_info->ctx = NULL;
+	alloc_info->handle = sparse;
+	alloc_info->release = sparse_memory_release;
+
+	return MALI_MEM_ALLOC_FINISHED;
+}
+
+/* Commit the pages of [first_page, first_page + num_pages) which are not committed yet */
+static _mali_osk_errcode_t mali_sparse_commit(mali_sparse_allocation *sparse, u32 first_page, u32 num_pages)
+{
+	const u32 end = first_page + num_pages;
+	u32 page = first_page;
+
+	while (page < end)
+	{
+		u32 count, i;
+
+		if (_mali_osk_test_bit(page, sparse->commit_map))
+		{
+			page++;
+			continue;
+		}
+
+		/* Commit the whole run of uncommitted pages in one go */
+		for (count = 1; page + count < end && count < MALI_OS_ALLOCATOR_BATCH_PAGES && !_mali_osk_test_bit(page + count, sparse->commit_map); count++);
+
+		if (_MALI_OSK_ERR_OK != mali_os_allocator_commit(os_memory_allocator, sparse->engine, sparse->descriptor, page * _MALI_OSK_MALI_PAGE_SIZE, &count))
+		{
+			MALI_ERROR(_MALI_OSK_ERR_NOMEM);
+		}
+
+		for (i = 0; i < count; i++)
+		{
+			_mali_osk_set_nonatomic_bit(page + i, sparse->commit_map);
+		}
+		sparse->num_committed += count;
+		page += count;
+	}
+
+	MALI_SUCCESS;
+}
+
+/* Decommit the committed pages of [first_page, first_page + num_pages), they must already be gone from the Mali page tables */
+static void mali_sparse_decommit(mali_sparse_allocation *sparse, u32 first_page, u32 num_pages, _mali_osk_mem_mapregion_flags_t flags)
+{
+	const u32 end = first_page + num_pages;
+	u32 page = first_page;
+
+	while (page < end && 0 < sparse->num_committed)
+	{
+		u32 count, i;
+
+		if (!_mali_osk_test_bit(page, sparse->commit_map))
+		{
+			page++;
+			continue;
+		}
+
+		for (count = 1; page + count < end && _mali_osk_test_bit(page + count, sparse->commit_map); count++);
+
+		mali_os_allocator_decommit(os_memory_allocator, sparse->engine, sparse->descriptor, page * _MALI_OSK_MALI_PAGE_SIZE, count, flags);
+
+		for (i = 0; i < count; i++)
+		{
+			_mali_osk_clear_nonatomic_bit(page + i, sparse->commit_map);
+		}
+		sparse->num_committed -= count;
+		page += count;
+	}
+}
+
+static void sparse_memory_release(void * ctx, void * handle)
+{
+	mali_sparse_allocation *sparse = (mali_sparse_allocation *)handle;
+
+	MALI_DEBUG_ASSERT_POINTER(sparse);
+
+	/* The allocation is gone from the Mali page tables and its CPU mapping is going away */
+	mali_sparse_decommit(sparse, 0, sparse->num_pages, (_mali_osk_mem_mapregion_flags_t)0);
+
+	/* Released with the session's memory lock held, like the list is changed */
+	_mali_osk_list_delinit(&sparse->purgeable_link);
+
+	if (NULL != sparse->slab_heap)
+	{
+		mali_slab_heap_destroy(sparse->slab_heap);
+	}
+
+	_mali_osk_free(sparse->commit_map);
+	_mali_osk_free(sparse);
+}
+
+/* Look up the sparse allocation a commit or decommit is for. Must be called with the session memory lock held */
+static mali_sparse_allocation *mali_sparse_get(struct mali_session_data *session_data, _mali_uk_mem_commit_s *args)
+{
+	mali_va_range *range;
+	mali_memory_allocation *descriptor;
+
+	range = mali_va_range_find_reserved(session_data, args->mali_address);
+	if (NULL == range || NULL == range->descriptor || 0 == (range->descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_SPARSE))
+	{
+		MALI_DEBUG_PRINT(2, ("No sparse memory mapped at 0x%08X\n", args->mali_address));
+		return NULL;
+	}
+
+	descriptor = range->descriptor;
+	if (NULL != ((mali_sparse_allocation *)descriptor->physical_allocation.handle)->slab_heap)
+	{
+		MALI_DEBUG_PRINT(2, ("Pages of the slab heap at 0x%08X are managed by the kernel\n", args->mali_address));
+		return NULL;
+	}
+	if (0 == args->size || 0 != (args->offset % _MALI_OSK_MALI_PAGE_SIZE) || 0 != (args->size % _MALI_OSK_MALI_PAGE_SIZE)
+	    || args->offset >= descriptor->size || args->size > descriptor->size - args->offset)
+	{
+		MALI_DEBUG_PRINT(2, ("Invalid range 0x%08X+0x%08X of sparse memory at 0x%08X\n", args->offset, args->size, args->mali_address));
+		return NULL;
+	}
+
+	return (mali_sparse_allocation *)descriptor->physical_allocation.handle;
+}
+
+_mali_osk_errcode_t _mali_ukk_mem_commit( _mali_uk_mem_commit_s *args )
+{
+	struct mali_session_data *session_data;
+	mali_sparse_allocation *sparse;
+	_mali_osk_errcode_t err;
+
+	MALI_DEBUG_ASSERT_POINTER(args);
+	MALI_CHECK_NON_NULL(args->ctx, _MALI_OSK_ERR_INVALID_ARGS);
+
+	session_data = (struct mali_session_data *)args->ctx;
+
+	_mali_osk_lock_wait(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	sparse = mali_sparse_get(session_data, args);
+	if (NULL == sparse)
+	{
+		_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
+
+	mali_memory_make_room(session_data, args->size);
+
+	/* New pages replace invalid PTEs only, the MMU TLB and L2 cache are brought up to date on job start */
+	err = mali_sparse_commit(sparse, args->offset / _MALI_OSK_MALI_PAGE_SIZE, args->size / _MALI_OSK_MALI_PAGE_SIZE);
+
+	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	return err;
+}
+
+_mali_osk_errcode_t _mali_ukk_mem_decommit( _mali_uk_mem_commit_s *args )
+{
+	struct mali_session_data *session_data;
+	mali_sparse_allocation *sparse;
+
+	MALI_DEBUG_ASSERT_POINTER(args);
+	MALI_CHECK_NON_NULL(args->ctx, _MALI_OSK_ERR_INVALID_ARGS);
+
+	session_data = (struct mali_session_data *)args->ctx;
+
+	_mali_osk_lock_wait(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	sparse = mali_sparse_get(session_data, args);
+	if (NULL == sparse)
+	{
+		_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
+
+	/* The GPU must be done with the pages before they go back to the page pool */
+	mali_mmu_pagedir_clear(session_data->page_directory, args->mali_address + args->offset, args->size);
+	mali_scheduler_zap_range_all_active(session_data, args->mali_address + args->offset, args->size);
+
+	mali_sparse_decommit(sparse, args->offset / _MALI_OSK_MALI_PAGE_SIZE, args->size / _MALI_OSK_MALI_PAGE_SIZE, _MALI_OSK_MEM_MAPREGION_FLAG_DECOMMIT);
+
+	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	MALI_SUCCESS;
+}
+
+_mali_osk_errcode_t _mali_ukk_mem_set_purgeable( _mali_uk_mem_set_purgeable_s *args )
+{
+	struct mali_session_data *session_data;
+	mali_va_range *range;
+	mali_sparse_allocation *sparse;
+
+	MALI_DEBUG_ASSERT_POINTER(args);
+	MALI_CHECK_NON_NULL(args->ctx, _MALI_OSK_ERR_INVALID_ARGS);
+
+	session_data = (struct mali_session_data *)args->ctx;
+
+	_mali_osk_lock_wait(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	range = mali_va_range_find_reserved(session_data, args->mali_address);
+	if (NULL == range || NULL == range->descriptor || 0 == (range->descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_SPARSE))
+	{
+		_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_DEBUG_PRINT(2, ("No sparse memory mapped at 0x%08X\n", args->mali_address));
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
+
+	sparse = (mali_sparse_allocation *)range->descriptor->physical_allocation.handle;
+	if (NULL != sparse->slab_heap)
+	{
+		/* Purging would take the objects of the heap away */
+		_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
+
+	args->purged = (MALI_TRUE == sparse->purged) ? 1 : 0;
+
+	if (0 != args->purgeable)
+	{
+		if (MALI_FALSE == sparse->purgeable)
+		{
+			/* Purged in the order the allocations were made purgeable, once the jobs which existed by then are gone */
+			sparse->purgeable = MALI_TRUE;
+			sparse->purgeable_generation = mali_session_job_generation(session_data);
+			_mali_osk_list_addtail(&sparse->purgeable_link, &session_data->purgeable);
+		}
+	}
+	else
+	{
+		sparse->purgeable = MALI_FALSE;
+		sparse->purged = MALI_FALSE;
+		_mali_osk_list_delinit(&sparse->purgeable_link);
+	}
+
+	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	MALI_SUCCESS;
+}
+
+_mali_osk_errcode_t _mali_ukk_mem_sync( _mali_uk_mem_sync_s *args )
+{
+	struct mali_session_data *session_data;
+	mali_memory_allocation *descriptor;
+	mali_va_range *range;
+	u32 start;
+	u32 end;
+
+	MALI_DEBUG_ASSERT_POINTER(args);
+	MALI_CHECK_NON_NULL(args->ctx, _MALI_OSK_ERR_INVALID_ARGS);
+
+	session_data = (struct mali_session_data *)args->ctx;
+
+	if (_MALI_MEM_SYNC_TO_DEVICE != args->direction && _MALI_MEM_SYNC_TO_CPU != args->direction)
+	{
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
+
+	_mali_osk_lock_wait(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	range = mali_va_range_find_mapped(session_data, args->mali_address);
+	if (NULL == range || 0 == (range->descriptor->flags & (MALI_MEMORY_ALLOCATION_FLAG_MAP_INTO_USERSPACE | MALI_MEMORY_ALLOCATION_FLAG_USER_MEMORY)))
+	{
+		_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_DEBUG_PRINT(2, ("No memory mapped into the process at 0x%08X\n", args->mali_address));
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
+
+	descriptor = range->descriptor;
+	if (0 == args->size || args->offset >= descriptor->size || args->size > descriptor->size - args->offset)
+	{
+		_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_DEBUG_PRINT(2, ("Invalid range 0x%08X+0x%08X of memory at 0x%08X\n", args->offset, args->size, args->mali_address));
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
+
+	/* Cache maintenance is done on whole pages */
+	start = args->offset & _MALI_OSK_CPU_PAGE_MASK;
+	end = (args->offset + args->size + _MALI_OSK_CPU_PAGE_SIZE - 1) & _MALI_OSK_CPU_PAGE_MASK;
+
+	_mali_osk_mem_mapregion_sync(descriptor, start, end - start, (_MALI_MEM_SYNC_TO_DEVICE == args->direction) ? MALI_TRUE : MALI_FALSE);
+	if (_MALI_MEM_SYNC_TO_DEVICE == args->direction)
+	{
+		/* The process wrote through its cached mapping */
+		mali_l2_cache_mark_dirty();
+	}
+
+	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	MALI_SUCCESS;
+}
+
+static mali_slab_heap *mali_slab_heap_create(struct mali_session_data *session_data, mali_sparse_allocation *sparse)
+{
+	mali_slab_heap *heap;
+	u32 i;
+
+	heap = _mali_osk_calloc(1, sizeof(mali_slab_heap));
+	if (NULL == heap) return NULL;
+
+	heap->sparse = sparse;
+	heap->num_chunks = sparse->num_pages / MALI_SLAB_PAGES;
+	if (0 == heap->num_chunks)
+	{
+		_mali_osk_free(heap);
+		return NULL;
+	}
+
+	heap->chunks = _mali_osk_calloc(heap->num_chunks, sizeof(mali_slab *));
+	if (NULL == heap->chunks)
+	{
+		_mali_osk_free(heap);
+		return NULL;
+	}
+
+	for (i = 0; i < MALI_SLAB_NUM_CLASSES; i++)
+	{
+		_MALI_OSK_INIT_LIST_HEAD(&heap->classes[i].partial);
+		_MALI_OSK_INIT_LIST_HEAD(&heap->classes[i].full);
+	}
+
+	_mali_osk_list_addtail(&heap->list, &session_data->slab_heaps);
+
+	return heap;
+}
+
+/* Called when the sparse memory is released, its pages are decommitted by the caller */
+static void mali_slab_heap_destroy(mali_slab_heap *heap)
+{
+	u32 i;
+
+	for (i = 0; i < heap->num_chunks; i++)
+	{
+		if (NULL != heap->chunks[i])
+		{
+			_mali_osk_free(heap->chunks[i]->used_map);
+			_mali_osk_free(heap->chunks[i]);
+		}
+	}
+
+	_mali_osk_list_del(&heap->list);
+	heap->sparse->slab_heap = NULL;
+
+	_mali_osk_free(heap->chunks);
+	_mali_osk_free(heap);
+}
+
+/* Find the slab heap at a reserved range, turning sparse memory without pages into one if create is set */
+static mali_slab_heap *mali_slab_heap_get(struct mali_session_data *session_data, u32 heap_address, mali_bool create)
+{
+	mali_va_range *range;
+	mali_sparse_allocation *sparse;
+
+	range = mali_va_range_find_reserved(session_data, heap_address);
+	if (NULL == range || NULL == range->descriptor || 0 == (range->descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_SPARSE))
+	{
+		MALI_DEBUG_PRINT(2, ("No sparse memory mapped at 0x%08X\n", heap_address));
+		return NULL;
+	}
+
+	sparse = (mali_sparse_allocation *)range->descriptor->physical_allocation.handle;
+	if (NULL == sparse->slab_heap && MALI_TRUE == create)
+	{
+		/* Pages committed by anyone else would end up under the slabs */
+		if (0 != sparse->num_committed || MALI_TRUE == range->grow_on_fault || MALI_TRUE == sparse->purgeable)
+		{
+			MALI_DEBUG_PRINT(2, ("Sparse memory at 0x%08X can not be used as slab heap\n", heap_address));
+			return NULL;
+		}
+
+		sparse->slab_heap = mali_slab_heap_create(session_data, sparse);
+	}
+
+	return sparse->slab_heap;
+}
+
+MALI_STATIC_INLINE u32 mali_slab_num_objects(u32 order)
+{
+	return MALI_SLAB_SIZE >> order;
+}
+
+static mali_slab *mali_slab_create(mali_slab_heap *heap, u32 order)
+{
+	mali_slab *slab;
+	u32 chunk;
+
+	for (chunk = 0; chunk < heap->num_chunks && NULL != heap->chunks[chunk]; chunk++);
+	if (heap->num_chunks == chunk)
+	{
+		MALI_DEBUG_PRINT(2, ("Slab heap at 0x%08X is full\n", heap->sparse->descriptor->mali_address));
+		return NULL;
+	}
+
+	slab = _mali_osk_calloc(1, sizeof(mali_slab));
+	if (NULL == slab) return NULL;
+
+	slab->used_map = _mali_osk_calloc((mali_slab_num_objects(order) + 31) / 32, sizeof(u32));
+	if (NULL == slab->used_map)
+	{
+		_mali_osk_free(slab);
+		return NULL;
+	}
+
+	/* Pages committed before running out of memory stay, the chunk is committed in full when used again */
+	if (_MALI_OSK_ERR_OK != mali_sparse_commit(heap->sparse, chunk * MALI_SLAB_PAGES, MALI_SLAB_PAGES))
+	{
+		_mali_osk_free(slab->used_map);
+		_mali_osk_free(slab);
+		return NULL;
+	}
+
+	slab->chunk = chunk;
+	slab->order = order;
+	heap->chunks[chunk] = slab;
+	heap->classes[order - MALI_SLAB_MIN_ORDER].num_slabs++;
+
+	return slab;
+}
+
+/* Give the pages of an empty slab back, the slab is already off the class lists */
+static void mali_slab_destroy(mali_slab_heap *heap, mali_slab *slab)
+{
+	mali_memory_allocation *descriptor = heap->sparse->descriptor;
+	struct mali_session_data *session_data = (struct mali_session_data *)descriptor->mali_addr_mapping_info;
+
+	MALI_DEBUG_ASSERT(0 == slab->num_used);
+
+	mali_mmu_pagedir_clear(session_data->page_directory, descriptor->mali_address + slab->chunk * MALI_SLAB_SIZE, MALI_SLAB_SIZE);
+	mali_scheduler_zap_range_all_active(session_data, descriptor->mali_address + slab->chunk * MALI_SLAB_SIZE, MALI_SLAB_SIZE);
+	mali_sparse_decommit(heap->sparse, slab->chunk * MALI_SLAB_PAGES, MALI_SLAB_PAGES, _MALI_OSK_MEM_MAPREGION_FLAG_DECOMMIT);
+
+	heap->chunks[slab->chunk] = NULL;
+	heap->classes[slab->order - MALI_SLAB_MIN_ORDER].num_slabs--;
+
+	_mali_osk_free(slab->used_map);
+	_mali_osk_free(slab);
+}
+
+_mali_osk_errcode_t _mali_ukk_mem_suballoc( _mali_uk_mem_suballoc_s *args )
+{
+	struct mali_session_data *session_data;
+	mali_slab_heap *heap;
+	mali_slab_class *class;
+	mali_slab *slab;
+	u32 order, index;
+
+	MALI_DEBUG_ASSERT_POINTER(args);
+	MALI_CHECK_NON_NULL(args->ctx, _MALI_OSK_ERR_INVALID_ARGS);
+
+	if (0 == args->size || _MALI_MEM_SUBALLOC_MAX_SIZE < args->size)
+	{
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
+
+	for (order = MALI_SLAB_MIN_ORDER; (1U << order) < args->size; order++);
+	MALI_DEBUG_ASSERT(MALI_SLAB_MAX_ORDER >= order);
+
+	session_data = (struct mali_session_data *)args->ctx;
+
+	_mali_osk_lock_wait(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	heap = mali_slab_heap_get(session_data, args->heap_address, MALI_TRUE);
+	if (NULL == heap)
+	{
+		_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
+
+	class = &heap->classes[order - MALI_SLAB_MIN_ORDER];
+
+	if (!_mali_osk_list_empty(&class->partial))
+	{
+		slab = _MALI_OSK_LIST_ENTRY(class->partial.next, mali_slab, list);
+	}
+	else
+	{
+		slab = class->empty;
+		class->empty = NULL;
+		if (NULL == slab)
+		{
+			slab = mali_slab_create(heap, order);
+			if (NULL == slab)
+			{
+				_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+				MALI_ERROR(_MALI_OSK_ERR_NOMEM);
+			}
+		}
+		_mali_osk_list_add(&slab->list, &class->partial);
+	}
+
+	index = _mali_osk_find_first_zero_bit(slab->used_map, mali_slab_num_objects(order));
+	MALI_DEBUG_ASSERT(mali_slab_num_objects(order) > index);
+	_mali_osk_set_nonatomic_bit(index, slab->used_map);
+
+	slab->num_used++;
+	if (mali_slab_num_objects(order) == slab->num_used)
+	{
+		_mali_osk_list_move(&slab->list, &class->full);
+	}
+
+	class->num_objects++;
+	class->num_allocs++;
+
+	args->mali_address = heap->sparse->descriptor->mali_address + slab->chunk * MALI_SLAB_SIZE + (index << order);
+
+	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	MALI_SUCCESS;
+}
+
+_mali_osk_errcode_t _mali_ukk_mem_subfree( _mali_uk_mem_subfree_s *args )
+{
+	struct mali_session_data *session_data;
+	mali_slab_heap *heap;
+	mali_slab_class *class;
+	mali_slab *slab;
+	u32 offset, index;
+
+	MALI_DEBUG_ASSERT_POINTER(args);
+	MALI_CHECK_NON_NULL(args->ctx, _MALI_OSK_ERR_INVALID_ARGS);
+
+	session_data = (struct mali_session_data *)args->ctx;
+
+	_mali_osk_lock_wait(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	heap = mali_slab_heap_get(session_data, args->heap_address, MALI_FALSE);
+	if (NULL == heap)
+	{
+		_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
+
+	offset = args->mali_address - heap->sparse->descriptor->mali_address;
+	slab = (offset / MALI_SLAB_SIZE < heap->num_chunks) ? heap->chunks[offset / MALI_SLAB_SIZE] : NULL;
+	if (NULL == slab || 0 != (offset & ((1U << slab->order) - 1))
+	    || !_mali_osk_test_bit((offset % MALI_SLAB_SIZE) >> slab->order, slab->used_map))
+	{
+		_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_DEBUG_PRINT(2, ("No object allocated at 0x%08X\n", args->mali_address));
+		MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS);
+	}
+
+	index = (offset % MALI_SLAB_SIZE) >> slab->order;
+	class = &heap->classes[slab->order - MALI_SLAB_MIN_ORDER];
+
+	_mali_osk_clear_nonatomic_bit(index, slab->used_map);
+
+	if (mali_slab_num_objects(slab->order) == slab->num_used)
+	{
+		_mali_osk_list_move(&slab->list, &class->partial);
+	}
+	slab->num_used--;
+
+	class->num_objects--;
+	class->num_frees++;
+
+	if (0 == slab->num_used)
+	{
+		_mali_osk_list_delinit(&slab->list);
+		if (NULL == class->empty)
+		{
+			class->empty = slab;
+		}
+		else
+		{
+			mali_slab_destroy(heap, slab);
+		}
+	}
+
+	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	MALI_SUCCESS;
+}
+
+u32 mali_memory_dump_slab_stats(char *buf, u32 size)
+{
+	struct mali_session_data *session, *tmp;
+	u32 slabs[MALI_SLAB_NUM_CLASSES] = { 0, };
+	u32 objects[MALI_SLAB_NUM_CLASSES] = { 0, };
+	u32 allocs[MALI_SLAB_NUM_CLASSES] = { 0, };
+	u32 frees[MALI_SLAB_NUM_CLASSES] = { 0, };
+	u32 num_heaps = 0;
+	u32 i;
+	int n = 0;
+
+	mali_session_lock();
+	MALI_SESSION_FOREACH(session, tmp, link)
+	{
+		mali_slab_heap *heap, *temp;
+
+		_mali_osk_lock_wait(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		_MALI_OSK_LIST_FOREACHENTRY(heap, temp, &session->slab_heaps, mali_slab_heap, list)
+		{
+			num_heaps++;
+			for (i = 0; i < MALI_SLAB_NUM_CLASSES; i++)
+			{
+				slabs[i] += heap->classes[i].num_slabs;
+				objects[i] += heap->classes[i].num_objects;
+				allocs[i] += heap->classes[i].num_allocs;
+				frees[i] += heap->classes[i].num_frees;
+			}
+		}
+		_mali_osk_lock_signal(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+	}
+	mali_session_unlock();
+
+	n += _mali_osk_snprintf(buf + n, size - n, "%u slab heaps\n", num_heaps);
+	n += _mali_osk_snprintf(buf + n, size - n, "%8s %8s %10s %10s %10s %10s %10s\n",
+	                        "size", "slabs", "objects", "used KiB", "waste KiB", "allocs", "frees");
+	for (i = 0; i < MALI_SLAB_NUM_CLASSES; i++)
+	{
+		const u32 order = MALI_SLAB_MIN_ORDER + i;
+		const u32 used = objects[i] << order;
+
+		n += _mali_osk_snprintf(buf + n, size - n, "%8u %8u %10u %10u %10u %10u %10u\n",
+		                        1U << order, slabs[i], objects[i], used / 1024,
+		                        (slabs[i] * MALI_SLAB_SIZE - used) / 1024, allocs[i], frees[i]);
+	}
+
+	return n;
+}
+
+/*
+ * Purge one purgeable allocation no job may use anymore. The address
+ * space the allocation is mapped into is returned locked through owner, it
+ * must be unlocked by the caller once no Mali locks are held.
+ * Returns the number of pages freed, 0 if there was nothing to purge.
+ */
+static u32 mali_memory_purge_one(void **owner)
+{
+	struct mali_session_data *session, *tmp;
+	u32 num_pages = 0;
+
+	*owner = NULL;
+
+	/* Sessions busy with other work are skipped */
+	if (_MALI_OSK_ERR_OK != _mali_osk_lock_trywait(mali_sessions_lock, _MALI_OSK_LOCKMODE_RO))
+	{
+		return 0;
+	}
+
+	MALI_SESSION_FOREACH(session, tmp, link)
+	{
+		mali_sparse_allocation *sparse, *temp;
+
+		if (_MALI_OSK_ERR_OK != _mali_osk_lock_trywait(session->memory_lock, _MALI_OSK_LOCKMODE_RW))
+		{
+			continue;
+		}
+
+		_MALI_OSK_LIST_FOREACHENTRY(sparse, temp, &session->purgeable, mali_sparse_allocation, purgeable_link)
+		{
+			/*
+			 * Pages are only purged once the jobs which existed when the allocation was
+			 * made purgeable are gone. Later jobs must not use it, if one does it faults
+			 * on the purged pages, since they are gone from the MMU before they are freed.
+			 */
+			if (0 == sparse->num_committed
+			    || MALI_TRUE != mali_session_jobs_done(session, sparse->purgeable_generation)
+			    || _MALI_OSK_ERR_OK != _mali_osk_mem_mapregion_trylock(sparse->descriptor, owner))
+			{
+				continue;
+			}
+
+			num_pages = sparse->num_committed;
+
+			mali_mmu_pagedir_clear(session->page_directory, sparse->descriptor->mali_address, sparse->descriptor->size);
+			mali_scheduler_zap_range_all_active(session, sparse->descriptor->mali_address, sparse->descriptor->size);
+			mali_sparse_decommit(sparse, 0, sparse->num_pages, _MALI_OSK_MEM_MAPREGION_FLAG_DECOMMIT);
+			sparse->purged = MALI_TRUE;
+
+			MALI_DEBUG_PRINT(3, ("Purged %d pages of memory at 0x%08X\n", num_pages, sparse->descriptor->mali_address));
+			break;
+		}
+
+		_mali_osk_lock_signal(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+		if (0 != num_pages)
+		{
+			break;
+		}
+	}
+
+	_mali_osk_lock_signal(mali_sessions_lock, _MALI_OSK_LOCKMODE_RO);
+
+	return num_pages;
+}
+
+/* Number of pages which could be purged, sessions busy with other work are not counted */
+static u32 mali_memory_purgeable_pages(void)
+{
+	struct mali_session_data *session, *tmp;
+	u32 num_pages = 0;
+
+	if (_MALI_OSK_ERR_OK != _mali_osk_lock_trywait(mali_sessions_lock, _MALI_OSK_LOCKMODE_RO))
+	{
+		return 0;
+	}
+
+	MALI_SESSION_FOREACH(session, tmp, link)
+	{
+		mali_sparse_allocation *sparse, *temp;
+
+		if (_MALI_OSK_ERR_OK != _mali_osk_lock_trywait(session->memory_lock, _MALI_OSK_LOCKMODE_RW))
+		{
+			continue;
+		}
+
+		_MALI_OSK_LIST_FOREACHENTRY(sparse, temp, &session->purgeable, mali_sparse_allocation, purgeable_link)
+		{
+			if (MALI_TRUE == mali_session_jobs_done(session, sparse->purgeable_generation))
+			{
+				num_pages += sparse->num_committed;
+			}
+		}
+
+		_mali_osk_lock_signal(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+	}
+
+	_mali_osk_lock_signal(mali_sessions_lock, _MALI_OSK_LOCKMODE_RO);
+
+	return num_pages;
+}
+
+/* Purge everything which can be purged, the work handler of purge_work */
+static void mali_memory_purge_work(void *data)
+{
+	for (;;)
+	{
+		void *owner;
+		u32 num_pages = mali_memory_purge_one(&owner);
+
+		_mali_osk_mem_mapregion_unlock(owner);
+
+		if (0 == num_pages)
+		{
+			break;
+		}
+	}
+}
+
+/*
+ * The pages are not purged here, since the OS memory allocator may be
+ * allocating pages with its lock held, which decommitting waits for.
+ */
+static u32 mali_memory_purgeable_shrink(u32 nr_pages, void *data)
+{
+	u32 num_pages = mali_memory_purgeable_pages();
+
+	if (0 != nr_pages && 0 != num_pages)
+	{
+		_mali_osk_wq_schedule_work(purge_work);
+	}
+
+	return num_pages;
+}
+
+_mali_osk_errcode_t mali_memory_grow_on_fault(struct mali_session_data *session, u32 fault_address)
+{
+	mali_va_range *range;
+	mali_memory_allocation *descriptor = NULL;
+	mali_sparse_allocation *sparse;
+	u32 first_page, last_page, num_pages, page_table, chunk_start;
+	_mali_osk_errcode_t err;
+
+	MALI_DEBUG_ASSERT_POINTER(session);
+
+	_mali_osk_lock_wait(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	/* Ranges may overlap, so walk back from the last one starting at or below the faulting address */
+	for (range = mali_va_range_find_below(session, fault_address); NULL != range; range = mali_va_range_prev(range))
+	{
+		if (MALI_TRUE == range->grow_on_fault && NULL != range->descriptor
+		    && fault_address - range->descriptor->mali_address < range->descriptor->size)
+		{
+			descriptor = range->descriptor;
+			break;
+		}
+	}
+
+	if (NULL == descriptor)
+	{
+		_mali_osk_lock_signal(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_ERROR(_MALI_OSK_ERR_FAULT);
+	}
+
+	sparse = (mali_sparse_allocation *)descriptor->physical_allocation.handle;
+
+	/*
+	 * Commit an aligned chunk around the faulting page, the GPU will most likely touch its neighbours next.
+	 * The chunk is aligned in the Mali address space, so it never crosses into another page table.
+	 */
+	chunk_start = fault_address & ~(MALI_GROW_ON_FAULT_PAGES * _MALI_OSK_MALI_PAGE_SIZE - 1);
+	first_page = 0;
+	if (chunk_start > descriptor->mali_address)
+	{
+		first_page = (chunk_start - descriptor->mali_address) / _MALI_OSK_MALI_PAGE_SIZE;
+	}
+	/* The chunk end lies above the faulting page, which lies inside the descriptor */
+	last_page = (chunk_start + MALI_GROW_ON_FAULT_PAGES * _MALI_OSK_MALI_PAGE_SIZE - descriptor->mali_address) / _MALI_OSK_MALI_PAGE_SIZE;
+	if (last_page > sparse->num_pages)
+	{
+		last_page = sparse->num_pages;
+	}
+	num_pages = last_page - first_page;
+	MALI_DEBUG_ASSERT(MALI_MMU_PDE_ENTRY(descriptor->mali_address + first_page * _MALI_OSK_MALI_PAGE_SIZE) == MALI_MMU_PDE_ENTRY(fault_address));
+	MALI_DEBUG_ASSERT(MALI_MMU_PDE_ENTRY(descriptor->mali_address + last_page * _MALI_OSK_MALI_PAGE_SIZE - 1) == MALI_MMU_PDE_ENTRY(fault_address));
+
+	err = mali_sparse_commit(sparse, first_page, num_pages);
+	if (_MALI_OSK_ERR_OK != err)
+	{
+		_mali_osk_lock_signal(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		MALI_PRINT(("Out of memory growing GPU memory at 0x%08X on page fault\n", fault_address));
+		MALI_ERROR(err);
+	}
+
+	/* The MMU reads page tables through the L2 cache, which may hold the invalid PTEs */
+	page_table = mali_page_directory_get_phys_address(session->page_directory, MALI_MMU_PDE_ENTRY(fault_address));
+	mali_l2_cache_invalidate_all_pages(&page_table, 1);
+
+	_mali_osk_lock_signal(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	MALI_DEBUG_PRINT(3, ("Grew GPU memory by %d pages at 0x%08X on page fault\n", num_pages, descriptor->mali_address + first_page * _MALI_OSK_MALI_PAGE_SIZE));
+
+	MALI_SUCCESS;
+}
+
+u32 mali_memory_dump_va_stats(char *buf, u32 size)
+{
+	struct mali_session_data *session, *tmp;
+	int n = 0;
+
+	mali_session_lock();
+	MALI_SESSION_FOREACH(session, tmp, link)
+	{
+		mali_va_range *range;
+		u32 num_ranges = 0, num_reserved = 0, num_gaps = 0, num_page_tables = 0;
+		u32 mapped = 0, reserved = 0, free_bytes = 0, largest_gap = 0;
+		u32 gap_start = MALI_VA_ALLOC_START;
+		u32 i;
+
+		_mali_osk_lock_wait(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+		for (range = mali_va_range_first(session); NULL != range; range = mali_va_range_next(range))
+		{
+			num_ranges++;
+			if (NULL != range->descriptor) mapped += range->size;
+			if (MALI_TRUE == range->reserved)
+			{
+				num_reserved++;
+				reserved += range->size;
+			}
+
+			if (range->start > gap_start && range->start <= MALI_VA_ALLOC_END)
+			{
+				u32 gap = range->start - gap_start;
+				num_gaps++;
+				free_bytes += gap;
+				if (gap > largest_gap) largest_gap = gap;
+			}
+			if (mali_va_range_end(range) > gap_start)
+			{
+				gap_start = mali_va_range_end(range);
+			}
+		}
+		if (MALI_VA_ALLOC_END > gap_start)
+		{
+			u32 gap = MALI_VA_ALLOC_END - gap_start;
+			num_gaps++;
+			free_bytes += gap;
+			if (gap > largest_gap) largest_gap = gap;
+		}
+
+		for (i = 0; i < 1024; i++)
+		{
+			if (NULL != session->page_directory->page_entries_mapped[i]) num_page_tables++;
+		}
+
+		_mali_osk_lock_signal(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+		n += _mali_osk_snprintf(buf + n, size - n, "Session 0x%08X: %u ranges, %u reserved (%u KiB), %u KiB mapped, %u page tables\n",
+		                        session, num_ranges, num_reserved, reserved / 1024, mapped / 1024, num_page_tables);
+		n += _mali_osk_snprintf(buf + n, size - n, "\t%u free gaps, %u KiB free, largest gap %u KiB, fragmentation %u%%\n",
+		                        num_gaps, free_bytes / 1024, largest_gap / 1024,
+		                        (0 == free_bytes) ? 0 : 100 - (u32)(((u64)largest_gap * 100) / free_bytes));
+	}
+	mali_session_unlock();
+
+	return n;
+}
+
+static _mali_osk_errcode_t mali_address_manager_allocate(mali_memory_allocation * descriptor)
+{
+	struct mali_session_data *session_data;
+	mali_va_range *range;
+	_mali_osk_errcode_t err;
+	u32 actual_size;
+
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+
+	session_data = (struct mali_session_data *)descriptor->mali_addr_mapping_info;
+
+	actual_size = descriptor->size;
+
+	if (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_MAP_GUARD_PAGE)
+	{
+		actual_size += _MALI_OSK_MALI_PAGE_SIZE;
+	}
+
+	/* Track the range, taking over a reservation if the allocation was placed in one */
+	range = mali_va_range_find_reserved(session_data, descriptor->mali_address);
+	if (NULL == range || NULL != range->descriptor || range->size < actual_size)
+	{
+		range = mali_va_range_insert(session_data, descriptor->mali_address, actual_size);
+		if (NULL == range)
+		{
+			MALI_ERROR(_MALI_OSK_ERR_NOMEM);
+		}
+	}
+	range->descriptor = descriptor;
+	descriptor->va_range = range;
+
+	err = mali_mmu_pagedir_map(session_data->page_directory, descriptor->mali_address, actual_size);
+	if (_MALI_OSK_ERR_OK != err)
+	{
+		range->descriptor = NULL;
+		descriptor->va_range = NULL;
+		if (MALI_TRUE != range->reserved)
+		{
+			mali_va_range_remove(session_data, range);
+		}
+	}
+
+	return err;
+}
+
+static void mali_address_manager_release(mali_memory_allocation * descriptor)
+{
+	const u32 illegal_mali_address = 0xffffffff;
+	struct mali_session_data *session_data;
+	mali_va_range *range;
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+
+	/* It is allowed to call this function several times on the same descriptor.
+	   When memory is released we set the illegal_mali_address so we can early out here. */
+	if ( illegal_mali_address == descriptor->mali_address) return;
+
+	session_data = (struct mali_session_data *)descriptor->mali_addr_mapping_info;
+	mali_mmu_pagedir_unmap(session_data->page_directory, descriptor->mali_address, descriptor->size);
+
+	/* Reservations stay until _mali_ukk_mem_free_va(), other ranges go with their allocation */
+	range = (mali_va_range *)descriptor->va_range;
+	if (NULL != range)
+	{
+		MALI_DEBUG_ASSERT(descriptor == range->descriptor);
+		range->descriptor = NULL;
+		descriptor->va_range = NULL;
+		if (MALI_TRUE != range->reserved)
+		{
+			mali_va_range_remove(session_data, range);
+		}
+	}
+
+	descriptor->mali_address = illegal_mali_address ;
+}
+
+static _mali_osk_errcode_t mali_address_manager_map(mali_memory_allocation * descriptor, u32 offset, u32 *phys_addr, u32 size)
+{
+	struct mali_session_data *session_data;
+	u32 mali_address;
+
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+	MALI_DEBUG_ASSERT_POINTER(phys_addr);
+
+	session_data = (struct mali_session_data *)descriptor->mali_addr_mapping_info;
+	MALI_DEBUG_ASSERT_POINTER(session_data);
+
+	mali_address = descriptor->mali_address + offset;
+
+	MALI_DEBUG_PRINT(7, ("Mali map: mapping 0x%08X to Mali address 0x%08X length 0x%08X\n", *phys_addr, mali_address, size));
+
+	mali_mmu_pagedir_update(session_data->page_directory, mali_address, *phys_addr, size, descriptor->cache_settings);
+
+	MALI_SUCCESS;
+}
+
+static _mali_osk_errcode_t mali_address_manager_map_pages(mali_memory_allocation * descriptor, u32 offset, u32 *phys_addrs, u32 *num_pages)
+{
+	struct mali_session_data *session_data;
+	u32 mali_address;
+
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+	MALI_DEBUG_ASSERT_POINTER(phys_addrs);
+	MALI_DEBUG_ASSERT_POINTER(num_pages);
+
+	session_data = (struct mali_session_data *)descriptor->mali_addr_mapping_info;
+	MALI_DEBUG_ASSERT_POINTER(session_data);
+
+	mali_address = descriptor->mali_address + offset;
+
+	MALI_DEBUG_PRINT(7, ("Mali map: mapping %d pages to Mali address 0x%08X\n", *num_pages, mali_address));
+
+	mali_mmu_pagedir_update_pages(session_data->page_directory, mali_address, phys_addrs, *num_pages, descriptor->cache_settings);
+
+	MALI_SUCCESS;
+}
+
+static _mali_osk_errcode_t mali_process_address_allocate(mali_memory_allocation * descriptor)
+{
+	MALI_CHECK_NO_ERROR(_mali_osk_mem_mapregion_init(descriptor));
+
+	/* Writes through a cached mapping are announced by the cache sync before the GPU may use them */
+	if (0 == (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_CPU_CACHED))
+	{
+		mali_l2_cache_untracked_writer_add();
+	}
+
+	MALI_SUCCESS;
+}
+
+static void mali_process_address_release(mali_memory_allocation * descriptor)
+{
+	if (0 == (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_CPU_CACHED))
+	{
+		mali_l2_cache_untracked_writer_remove();
+	}
+
+	_mali_osk_mem_mapregion_term(descriptor);
+}
+
+MALI_STATIC_INLINE _mali_osk_list_t *mali_free_cache_bucket(struct mali_session_data *session_data, u32 size, u32 cache_settings)
+{
+	return &session_data->free_cache[((size >> _MALI_OSK_MALI_PAGE_ORDER) ^ cache_settings) % MALI_SESSION_FREE_CACHE_BUCKETS];
+}
+
+/* Release the memory of an entry already taken off the cache lists */
+static void mali_free_cache_entry_release(mali_free_cache_entry *entry)
+{
+	mali_allocation_engine_release_pt2_physical_memory_free(memory_engine, entry->descriptor);
+	_mali_osk_free(entry->descriptor);
+	_mali_osk_free(entry);
+}
+
+/*
+ * Release the memory kept for reuse which is too old or above the size limit,
+ * or all of it. Must be called with the session memory lock held.
+ */
+static void mali_free_cache_trim(struct mali_session_data *session_data, mali_bool all)
+{
+	const u32 now = _mali_osk_time_tickcount();
+	const u32 max_age = _mali_osk_time_mstoticks(mali_free_cache_max_age_ms);
+
+	while (!_mali_osk_list_empty(&session_data->free_cache_lru))
+	{
+		mali_free_cache_entry *entry = _MALI_OSK_LIST_ENTRY(session_data->free_cache_lru.prev, mali_free_cache_entry, lru_link);
+
+		if (MALI_TRUE != all && session_data->free_cache_size <= (u32)mali_free_cache_max_size
+		    && !_mali_osk_time_after(now, entry->freed + max_age))
+		{
+			break;
+		}
+
+		_mali_osk_list_del(&entry->bucket_link);
+		_mali_osk_list_del(&entry->lru_link);
+		session_data->free_cache_size -= entry->descriptor->size;
+
+		mali_free_cache_entry_release(entry);
+	}
+}
+
+/* Have free_work trim the cache once its oldest entry gets too old. Must be called with the session memory lock held */
+static void mali_free_cache_arm_timer(struct mali_session_data *session_data)
+{
+	mali_free_cache_entry *oldest;
+	u32 now, expires;
+
+	if (NULL == session_data->free_cache_timer || _mali_osk_list_empty(&session_data->free_cache_lru))
+	{
+		return;
+	}
+
+	oldest = _MALI_OSK_LIST_ENTRY(session_data->free_cache_lru.prev, mali_free_cache_entry, lru_link);
+	now = _mali_osk_time_tickcount();
+	expires = oldest->freed + _mali_osk_time_mstoticks(mali_free_cache_max_age_ms);
+
+	/* One tick late, mali_free_cache_trim() only releases entries past their age */
+	_mali_osk_timer_mod(session_data->free_cache_timer, _mali_osk_time_after(now, expires) ? 1 : expires - now + 1);
+}
+
+/* Timer callback, the memory lock can not be taken here */
+static void mali_free_cache_timeout(void *data)
+{
+	struct mali_session_data *session_data = (struct mali_session_data *)data;
+
+	_mali_osk_wq_schedule_work(session_data->free_work);
+}
+
+/*
+ * Keep the memory of an allocation gone from the GPU and the CPU for reuse.
+ * Must be called with the session memory lock held.
+ * Returns MALI_FALSE if the memory must be released instead.
+ */
+static mali_bool mali_free_cache_put(struct mali_session_data *session_data, mali_memory_allocation *descriptor)
+{
+	mali_free_cache_entry *entry;
+
+	/* Only plain OS memory, which is moved to the new allocation without touching the pages */
+	if (0 >= mali_free_cache_max_size || descriptor->size > (u32)mali_free_cache_max_size
+	    || NULL == session_data->free_work || NULL == session_data->free_cache_timer || MALI_TRUE == session_data->free_cache_shrink
+	    || MALI_MEMORY_ALLOCATION_FLAG_MAP_INTO_USERSPACE != descriptor->flags
+	    || NULL == os_memory_allocator || MALI_TRUE != mali_os_allocator_backs(os_memory_allocator, descriptor))
+	{
+		return MALI_FALSE;
+	}
+
+	entry = _mali_osk_malloc(sizeof(mali_free_cache_entry));
+	if (NULL == entry)
+	{
+		return MALI_FALSE;
+	}
+
+	/* Off the session's memory or free_deferred list */
+	_mali_osk_list_delinit(&descriptor->list);
+
+	entry->descriptor = descriptor;
+	entry->freed = _mali_osk_time_tickcount();
+	_mali_osk_list_add(&entry->bucket_link, mali_free_cache_bucket(session_data, descriptor->size, descriptor->cache_settings));
+	_mali_osk_list_add(&entry->lru_link, &session_data->free_cache_lru);
+	session_data->free_cache_size += descriptor->size;
+
+	mali_free_cache_trim(session_data, MALI_FALSE);
+	mali_free_cache_arm_timer(session_data);
+
+	return MALI_TRUE;
+}
+
+/* Take the most recently freed memory matching a new allocation off the cache. Must be called with the session memory lock held */
+static mali_free_cache_entry *mali_free_cache_take(struct mali_session_data *session_data, mali_memory_allocation *descriptor)
+{
+	mali_free_cache_entry *entry, *temp;
+
+	mali_free_cache_trim(session_data, MALI_FALSE);
+
+	/* Only write-combined memory is cached, its pages must not change CPU mapping type */
+	if (MALI_MEMORY_ALLOCATION_FLAG_MAP_INTO_USERSPACE != descriptor->flags)
+	{
+		return NULL;
+	}
+
+	_MALI_OSK_LIST_FOREACHENTRY(entry, temp, mali_free_cache_bucket(session_data, descriptor->size, descriptor->cache_settings), mali_free_cache_entry, bucket_link)
+	{
+		if (entry->descriptor->size == descriptor->size && entry->descriptor->cache_settings == descriptor->cache_settings)
+		{
+			_mali_osk_list_del(&entry->bucket_link);
+			_mali_osk_list_del(&entry->lru_link);
+			session_data->free_cache_size -= entry->descriptor->size;
+
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+/* Release the memory of an allocation gone from the GPU, or keep it for reuse. Must be called with the session memory lock held */
+static void mali_memory_release_freed(struct mali_session_data *session_data, mali_memory_allocation *descriptor)
+{
+	if (MALI_TRUE == mali_free_cache_put(session_data, descriptor))
+	{
+		return;
+	}
+
+	/* Removes the descriptor from the session's memory list, releases physical memory, releases descriptor */
+	mali_allocation_engine_release_pt2_physical_memory_free(memory_engine, descriptor);
+	_mali_osk_free(descriptor);
+}
+
+/* The memory was moved to another allocation */
+static void free_cache_memory_moved(void * ctx, void * handle)
+{
+}
+
+/* Physical allocator taking over the memory of a freed allocation, ctx is its free cache entry */
+static mali_physical_memory_allocation_result free_cache_memory_reuse(void* ctx, mali_allocation_engine * engine, mali_memory_allocation * descriptor, u32* offset, mali_physical_memory_allocation * alloc_info)
+{
+	mali_free_cache_entry *entry = (mali_free_cache_entry *)ctx;
+	u32 num_pages = (descriptor->size + _MALI_OSK_MALI_PAGE_SIZE - 1) >> _MALI_OSK_MALI_PAGE_ORDER;
+	u32 *phys_addrs;
+
+	MALI_DEBUG_ASSERT_POINTER(entry);
+	MALI_DEBUG_ASSERT(0 == *offset);
+
+	phys_addrs = _mali_osk_malloc(sizeof(u32) * num_pages);
+	if (NULL == phys_addrs)
+	{
+		return MALI_MEM_ALLOC_NONE;
+	}
+
+	/* On failure the memory stays with the freed allocation, the next allocator is used */
+	if (_MALI_OSK_ERR_OK != mali_os_allocator_transfer(os_memory_allocator, entry->descriptor, descriptor, phys_addrs, alloc_info))
+	{
+		_mali_osk_free(phys_addrs);
+		return MALI_MEM_ALLOC_NONE;
+	}
+
+	/* The page tables of the range were allocated by the Mali address manager already */
+	mali_address_manager_map_pages(descriptor, 0, phys_addrs, &num_pages);
+
+	entry->descriptor->physical_allocation.release = free_cache_memory_moved;
+	*offset = descriptor->size;
+
+	_mali_osk_free(phys_addrs);
+
+	MALI_DEBUG_PRINT(4, ("Reused %d bytes of freed memory at 0x%08X\n", descriptor->size, descriptor->mali_address));
+
+	return MALI_MEM_ALLOC_FINISHED;
+}
+
+/*
+ * Ask the free work of each session to release the memory it keeps for reuse.
+ * The memory is not released here, since the OS memory allocator may be
+ * allocating pages with its lock held.
+ */
+static u32 mali_memory_free_cache_shrink(u32 nr_pages, void *data)
+{
+	struct mali_session_data *session, *tmp;
+	u32 num_pages = 0;
+
+	if (_MALI_OSK_ERR_OK != _mali_osk_lock_trywait(mali_sessions_lock, _MALI_OSK_LOCKMODE_RO))
+	{
+		return 0;
+	}
+
+	MALI_SESSION_FOREACH(session, tmp, link)
+	{
+		u32 session_pages;
+
+		if (_MALI_OSK_ERR_OK != _mali_osk_lock_trywait(session->memory_lock, _MALI_OSK_LOCKMODE_RW))
+		{
+			continue;
+		}
+
+		session_pages = session->free_cache_size >> _MALI_OSK_MALI_PAGE_ORDER;
+		if (0 != nr_pages && 0 != session_pages && MALI_TRUE != session->free_cache_shrink && NULL != session->free_work)
+		{
+			session->free_cache_shrink = MALI_TRUE;
+			_mali_osk_wq_schedule_work(session->free_work);
+			nr_pages -= (nr_pages < session_pages) ? nr_pages : session_pages;
+		}
+		else if (MALI_TRUE != session->free_cache_shrink)
+		{
+			num_pages += session_pages;
+		}
+
+		_mali_osk_lock_signal(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+	}
+
+	_mali_osk_lock_signal(mali_sessions_lock, _MALI_OSK_LOCKMODE_RO);
+
+	return num_pages;
+}
+
+/* This handler registered to mali_mmap for MMU builds */
+_mali_osk_errcode_t _mali_ukk_mem_mmap( _mali_uk_mem_mmap_s *args )
+{
+	struct mali_session_data *session_data;
+	mali_memory_allocation * descriptor;
+	mali_physical_memory_allocator * allocators = physical_memory_allocators;
+	mali_physical_memory_allocator sparse_memory_allocator;
+	mali_physical_memory_allocator free_cache_allocator;
+	mali_physical_memory_allocator os_only_allocator;
+	mali_free_cache_entry *cached = NULL;
+	mali_va_range *range;
+	_mali_osk_errcode_t err;
+
+	/* validate input */
+	if (NULL == args) { MALI_DEBUG_PRINT(3,("mali_ukk_mem_mmap: args was NULL\n")); MALI_ERROR(_MALI_OSK_ERR_INVALID_ARGS); }
+
+	/* Unpack arguments */
+	session_data = (struct mali_session_data *)args->ctx;
+
+	/* validate input */
+	if (NULL == session_data) { MALI_DEBUG_PRINT(3,("mali_ukk_mem_mmap: session data was NULL\n")); MALI_ERROR(_MALI_OSK_ERR_FAULT); }
+
+	descriptor = (mali_memory_allocation*) _mali_osk_calloc( 1, sizeof(mali_memory_allocation) );
+	if (NULL == descriptor) { MALI_DEBUG_PRINT(3,("mali_ukk_mem_mmap: descriptor was NULL\n")); MALI_ERROR(_MALI_OSK_ERR_NOMEM); }
+
+	descriptor->size = args->size;
+	descriptor->mali_address = args->phys_addr;
+	descriptor->mali_addr_mapping_info = (void*)session_data;
+
+	descriptor->process_addr_mapping_info = args->ukk_private; /* save to be used during physical manager callback */
+	descriptor->flags = MALI_MEMORY_ALLOCATION_FLAG_MAP_INTO_USERSPACE;
+	descriptor->cache_settings = (u32) args->cache_settings ;
+	descriptor->lock = session_data->memory_lock;
+	_mali_osk_list_init( &descriptor->list );
+
+	_mali_osk_lock_wait(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	/* Memory mapped at a sparse reservation gets its pages through _mali_ukk_mem_commit() */
+	range = mali_va_range_find_reserved(session_data, descriptor->mali_address);
+	if (NULL != range && NULL == range->descriptor && range->size >= descriptor->size)
+	{
+		descriptor->flags |= range->cpu_cache;
+	}
+
+	if (NULL != range && MALI_TRUE == range->sparse && NULL == range->descriptor && range->size >= descriptor->size)
+	{
+		sparse_memory_allocator.allocate = sparse_memory_reserve;
+		sparse_memory_allocator.allocate_page_table_block = NULL;
+		sparse_memory_allocator.ctx = NULL;
+		sparse_memory_allocator.name = "Sparse Memory";
+		sparse_memory_allocator.next = NULL;
+
+		descriptor->flags |= MALI_MEMORY_ALLOCATION_FLAG_SPARSE;
+		allocators = &sparse_memory_allocator;
+	}
+	else if (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_CPU_CACHED)
+	{
+		/* Only OS pages are kept coherent by _mali_osk_mem_mapregion_sync(), without them the memory is mapped write-combined */
+		if (NULL != os_memory_allocator)
+		{
+			os_only_allocator = *os_memory_allocator;
+			os_only_allocator.next = NULL;
+
+			allocators = &os_only_allocator;
+			mali_memory_make_room(session_data, descriptor->size);
+		}
+		else
+		{
+			descriptor->flags &= ~MALI_MEMORY_ALLOCATION_FLAG_CPU_CACHED;
+		}
+	}
+	else
+	{
+		/* Take over the memory of a recently freed allocation of the same size, if any */
+		cached = mali_free_cache_take(session_data, descriptor);
+		if (NULL != cached)
+		{
+			free_cache_allocator.allocate = free_cache_memory_reuse;
+			free_cache_allocator.allocate_page_table_block = NULL;
+			free_cache_allocator.ctx = cached;
+			free_cache_allocator.name = "Freed Memory Cache";
+			free_cache_allocator.next = physical_memory_allocators;
+
+			allocators = &free_cache_allocator;
+		}
+		else
+		{
+			mali_memory_make_room(session_data, descriptor->size);
+		}
+	}
+
+	err = mali_allocation_engine_allocate_memory(memory_engine, descriptor, allocators, &session_data->memory_head);
+
+	if (NULL != cached)
+	{
+		/* Whatever memory was not taken over is released */
+		mali_free_cache_entry_release(cached);
+	}
+
+	if (_MALI_OSK_ERR_OK == err)
+	{
+		/* We do not FLUSH nor TLB_ZAP on MMAP, since we do both of those on job start*/
+	   	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+		args->mapping = descriptor->mapping;
+		args->cookie = (u32)descriptor;
+
+		MALI_DEBUG_PRINT(7, ("MMAP OK\n"));
+		MALI_SUCCESS;
+	}
+	else
+	{
+	   	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		/* OOM, but not a fatal error */
+		MALI_DEBUG_PRINT(4, ("Memory allocation failure, OOM\n"));
+		_mali_osk_free(descriptor);
+		/* Linux will free the CPU address allocation, userspace client the Mali address allocation */
+		MALI_ERROR(_MALI_OSK_ERR_FAULT);
+	}
+}
+
+static _mali_osk_errcode_t _mali_ukk_mem_munmap_internal( _mali_uk_mem_munmap_s *args )
+{
+	struct mali_session_data *session_data;
+	mali_memory_allocation * descriptor;
+
+	descriptor = (mali_memory_allocation *)args->cookie;
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+
+	/** @note args->context unused; we use the memory_session from the cookie */
+	/* args->mapping and args->size are also discarded. They are only necessary
+	   for certain do_munmap implementations. However, they could be used to check the
+	   descriptor at this point. */
+
+	session_data = (struct mali_session_data *)descriptor->mali_addr_mapping_info;
+	MALI_DEBUG_ASSERT_POINTER(session_data);
+
+	/* Unmapping the memory from the mali virtual address space.
+	   It is allowed to call this function severeal times, which might happen if zapping below fails. */
+	mali_allocation_engine_release_pt1_mali_pagetables_unmap(memory_engine, descriptor);
+
+	if (0 != session_data->free_batch)
+	{
+		/* The TLBs are zapped once for the whole batch, when it ends */
+		_mali_osk_list_move(&descriptor->list, &session_data->free_pending);
+		return _MALI_OSK_ERR_OK;
+	}
+
+	mali_scheduler_zap_all_active(session_data);
+
+	if (NULL != session_data->free_work)
+	{
+		/* The GPU can no longer reach the memory, release it in the background */
+		_mali_osk_list_move(&descriptor->list, &session_data->free_deferred);
+		_mali_osk_wq_schedule_work(session_data->free_work);
+		return _MALI_OSK_ERR_OK;
+	}
+
+	mali_memory_release_freed(session_data, descriptor);
+
+	return _MALI_OSK_ERR_OK;
+}
+
+/* Release the memory of allocations already gone from the GPU, the work handler of free_work */
+static void mali_memory_free_deferred(void *data)
+{
+	struct mali_session_data *session_data = (struct mali_session_data *)data;
+
+	_mali_osk_lock_wait(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	while (!_mali_osk_list_empty(&session_data->free_deferred))
+	{
+		mali_memory_allocation *descriptor;
+
+		descriptor = _MALI_OSK_LIST_ENTRY(session_data->free_deferred.next, mali_memory_allocation, list);
+
+		/* Takes the descriptor off the free_deferred list */
+		mali_memory_release_freed(session_data, descriptor);
+
+		/* Let allocations in between, the list may be long */
+		_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		_mali_osk_lock_wait(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+	}
+
+	if (MALI_TRUE == session_data->free_cache_shrink)
+	{
+		/* Asked for by the shrinker */
+		mali_free_cache_trim(session_data, MALI_TRUE);
+		session_data->free_cache_shrink = MALI_FALSE;
+	}
+	else
+	{
+		/* Also run by free_cache_timer, while the session neither allocates nor frees */
+		mali_free_cache_trim(session_data, MALI_FALSE);
+		mali_free_cache_arm_timer(session_data);
+	}
+
+	_mali_osk_lock_signal(session_data->memory_lock, _MALI_OSK_LOCKMODE_RW);
+}
+
+/*
+ * Release the memory of freed allocations right away if an allocation of size bytes would otherwise
+ * run the OS memory allocator out of memory. The caller holds memory_lock.
+ */
+static void mali_memory_make_room(struct mali_session_data *session_data, u32 size)
+{
+	if (NULL == os_memory_allocator
+	    || (_mali_osk_list_empty(&session_data->free_deferred) && 0 == session_data->free_cache_size)
+	    || mali_os_allocator_available(os_memory_allocator) >= size)
+	{
+		return;
+	}
+
+	MALI_DEBUG_PRINT(4, ("Mali memory: Releasing freed memory synchronously to make room for %u bytes\n", size));
+
+	while (!_mali_osk_list_empty(&session_data->free_deferred))
+	{
+		mali_memory_allocation *descriptor;
+
+		descriptor = _MALI_OSK_LIST_ENTRY(session_data->free_deferred.next, mali_memory_allocation, list);
+		mali_memory_release_freed(session_data, descriptor);
+	}
+
+	/* The released memory may have been kept for reuse */
+	mali_free_cache_trim(session_data, MALI_TRUE);
+}
+
+void mali_memory_free_batch_begin(struct mali_session_data *session)
+{
+	MALI_DEBUG_ASSERT_POINTER(session);
+
+	_mali_osk_lock_wait(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+	session->free_batch++;
+	_mali_osk_lock_signal(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+}
+
+void mali_memory_free_batch_end(struct mali_session_data *session)
+{
+	MALI_DEBUG_ASSERT_POINTER(session);
+
+	_mali_osk_lock_wait(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	MALI_DEBUG_ASSERT(0 < session->free_batch);
+	session->free_batch--;
+
+	if (0 == session->free_batch && !_mali_osk_list_empty(&session->free_pending))
+	{
+		mali_memory_allocation *descriptor, *temp;
+
+		mali_scheduler_zap_all_active(session);
+
+		_MALI_OSK_LIST_FOREACHENTRY(descriptor, temp, &session->free_pending, mali_memory_allocation, list)
+		{
+			if (NULL != session->free_work)
+			{
+				_mali_osk_list_move(&descriptor->list, &session->free_deferred);
+			}
+			else
+			{
+				mali_memory_release_freed(session, descriptor);
+			}
+		}
+
+		if (NULL != session->free_work)
+		{
+			_mali_osk_wq_schedule_work(session->free_work);
+		}
+	}
+
+	_mali_osk_lock_signal(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+}
+
+/* Handler for unmapping memory for MMU builds */
+_mali_osk_errcode_t _mali_ukk_mem_munmap( _mali_uk_mem_munmap_s *args )
+{
+	mali_memory_allocation * descriptor;
+	_mali_osk_lock_t *descriptor_lock;
+	_mali_osk_errcode_t err;
+
+	descriptor = (mali_memory_allocation *)args->cookie;
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+
+	/** @note args->context unused; we use the memory_session from the cookie */
+	/* args->mapping and args->size are also discarded. They are only necessary
+	for certain do_munmap implementations. However, they could be used to check the
+	descriptor at this point. */
+
+	MALI_DEBUG_ASSERT_POINTER((struct mali_session_data *)descriptor->mali_addr_mapping_info);
+
+	descriptor_lock = descriptor->lock; /* should point to the session data lock... */
+
+	err = _MALI_OSK_ERR_BUSY;
+	while (err == _MALI_OSK_ERR_BUSY)
+	{
+		if (descriptor_lock)
 		{
 			_mali_osk_lock_wait( descriptor_lock, _MALI_OSK_LOCKMODE_RW );
 		}
@@ -1098,172 +3109,308 @@ u32 _mali_ukk_report_memory_usage(void)
 	return mali_allocation_engine_memory_usage(physical_memory_allocators);
 }
 
-_mali_osk_errcode_t mali_mmu_get_table_page(u32 *table_page, mali_io_address *mapping)
+MALI_STATIC_INLINE _mali_osk_list_t *mali_mmu_page_table_index_bucket(u32 pa)
 {
-	_mali_osk_lock_wait(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
+	return &page_table_cache.index[(pa >> MALI_MMU_PAGE_TABLE_INDEX_SHIFT) % MALI_MMU_PAGE_TABLE_INDEX_SIZE];
+}
 
-	if (!_mali_osk_list_empty(&page_table_cache.partial))
+static _mali_osk_errcode_t mali_mmu_page_table_index_add(mali_mmu_page_table_allocation *alloc)
+{
+	u32 first_chunk = alloc->pages.phys_base >> MALI_MMU_PAGE_TABLE_INDEX_SHIFT;
+	u32 last_chunk = (alloc->pages.phys_base + alloc->pages.size - 1) >> MALI_MMU_PAGE_TABLE_INDEX_SHIFT;
+	u32 i;
+
+	alloc->num_index_links = last_chunk - first_chunk + 1;
+	alloc->index_links = _mali_osk_calloc(alloc->num_index_links, sizeof(mali_mmu_page_table_index_link));
+	if (NULL == alloc->index_links)
 	{
-		mali_mmu_page_table_allocation * alloc = _MALI_OSK_LIST_ENTRY(page_table_cache.partial.next, mali_mmu_page_table_allocation, list);
-		int page_number = _mali_osk_find_first_zero_bit(alloc->usage_map, alloc->num_pages);
-		MALI_DEBUG_PRINT(6, ("Partial page table allocation found, using page offset %d\n", page_number));
-		_mali_osk_set_nonatomic_bit(page_number, alloc->usage_map);
-		alloc->usage_count++;
-		if (alloc->num_pages == alloc->usage_count)
-		{
-			/* full, move alloc to full list*/
-			_mali_osk_list_move(&alloc->list, &page_table_cache.full);
-		}
-		_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
+		return _MALI_OSK_ERR_NOMEM;
+	}
 
-		*table_page = (MALI_MMU_PAGE_SIZE * page_number) + alloc->pages.phys_base;
-		*mapping =  (mali_io_address)((MALI_MMU_PAGE_SIZE * page_number) + (u32)alloc->pages.mapping);
-		MALI_DEBUG_PRINT(4, ("Page table allocated for VA=0x%08X, MaliPA=0x%08X\n", *mapping, *table_page ));
-		MALI_SUCCESS;
+	for (i = 0; i < alloc->num_index_links; i++)
+	{
+		alloc->index_links[i].alloc = alloc;
+		_mali_osk_list_add(&alloc->index_links[i].list,
+		                   mali_mmu_page_table_index_bucket((first_chunk + i) << MALI_MMU_PAGE_TABLE_INDEX_SHIFT));
 	}
-	else
+
+	return _MALI_OSK_ERR_OK;
+}
+
+static void mali_mmu_page_table_index_remove(mali_mmu_page_table_allocation *alloc)
+{
+	u32 i;
+
+	for (i = 0; i < alloc->num_index_links; i++)
 	{
-		mali_mmu_page_table_allocation * alloc;
-		/* no free pages, allocate a new one */
+		_mali_osk_list_del(&alloc->index_links[i].list);
+	}
 
-		alloc = (mali_mmu_page_table_allocation *)_mali_osk_calloc(1, sizeof(mali_mmu_page_table_allocation));
-		if (NULL == alloc)
-		{
-			_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
-			*table_page = MALI_INVALID_PAGE;
-			MALI_ERROR(_MALI_OSK_ERR_NOMEM);
-		}
+	_mali_osk_free(alloc->index_links);
+	alloc->index_links = NULL;
+	alloc->num_index_links = 0;
+}
 
-		_MALI_OSK_INIT_LIST_HEAD(&alloc->list);
+static mali_mmu_page_table_allocation *mali_mmu_page_table_index_find(u32 pa)
+{
+	mali_mmu_page_table_index_link *link, *temp;
 
-		if (_MALI_OSK_ERR_OK != mali_allocation_engine_allocate_page_tables(memory_engine, &alloc->pages, physical_memory_allocators))
+	_MALI_OSK_LIST_FOREACHENTRY(link, temp, mali_mmu_page_table_index_bucket(pa), mali_mmu_page_table_index_link, list)
+	{
+		u32 start = link->alloc->pages.phys_base;
+		if (pa >= start && pa < start + link->alloc->pages.size)
 		{
-			MALI_DEBUG_PRINT(1, ("No more memory for page tables\n"));
-			_mali_osk_free(alloc);
-			_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
-			*table_page = MALI_INVALID_PAGE;
-			*mapping = NULL;
-			MALI_ERROR(_MALI_OSK_ERR_NOMEM);
+			return link->alloc;
 		}
+	}
+
+	return NULL;
+}
+
+/* Must be called with the page table cache lock held */
+static mali_mmu_page_table_allocation *mali_mmu_page_table_block_create(void)
+{
+	mali_mmu_page_table_allocation * alloc;
+
+	alloc = (mali_mmu_page_table_allocation *)_mali_osk_calloc(1, sizeof(mali_mmu_page_table_allocation));
+	if (NULL == alloc)
+	{
+		return NULL;
+	}
+
+	_MALI_OSK_INIT_LIST_HEAD(&alloc->list);
+
+	if (_MALI_OSK_ERR_OK != mali_allocation_engine_allocate_page_tables(memory_engine, &alloc->pages, physical_memory_allocators))
+	{
+		MALI_DEBUG_PRINT(1, ("No more memory for page tables\n"));
+		_mali_osk_free(alloc);
+		return NULL;
+	}
+
+	/* create the usage map */
+	alloc->num_pages = alloc->pages.size / MALI_MMU_PAGE_SIZE;
+	alloc->usage_count = 0;
+	MALI_DEBUG_PRINT(3, ("New page table cache expansion, %d pages in new cache allocation\n", alloc->num_pages));
+	alloc->usage_map = _mali_osk_calloc(1, ((alloc->num_pages + BITS_PER_LONG - 1) & ~(BITS_PER_LONG-1) / BITS_PER_LONG) * sizeof(unsigned long));
+	if (NULL == alloc->usage_map)
+	{
+		MALI_DEBUG_PRINT(1, ("Failed to allocate memory to describe MMU page table cache usage\n"));
+		alloc->pages.release(&alloc->pages);
+		_mali_osk_free(alloc);
+		return NULL;
+	}
+
+	if (_MALI_OSK_ERR_OK != mali_mmu_page_table_index_add(alloc))
+	{
+		MALI_DEBUG_PRINT(1, ("Failed to index MMU page table cache allocation\n"));
+		alloc->pages.release(&alloc->pages);
+		_mali_osk_free(alloc->usage_map);
+		_mali_osk_free(alloc);
+		return NULL;
+	}
+
+	return alloc;
+}
+
+/* The allocation must already be off the cache lists and out of the index */
+static void mali_mmu_page_table_block_destroy(mali_mmu_page_table_allocation *alloc)
+{
+	alloc->pages.release(&alloc->pages);
+	_mali_osk_free(alloc->usage_map);
+	_mali_osk_free(alloc);
+}
+
+_mali_osk_errcode_t mali_mmu_get_table_page(u32 *table_page, mali_io_address *mapping)
+{
+	mali_mmu_page_table_allocation * alloc;
+	int page_number;
+
+	_mali_osk_lock_wait(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
 
-		/* create the usage map */
-		alloc->num_pages = alloc->pages.size / MALI_MMU_PAGE_SIZE;
-		alloc->usage_count = 1;
-		MALI_DEBUG_PRINT(3, ("New page table cache expansion, %d pages in new cache allocation\n", alloc->num_pages));
-		alloc->usage_map = _mali_osk_calloc(1, ((alloc->num_pages + BITS_PER_LONG - 1) & ~(BITS_PER_LONG-1) / BITS_PER_LONG) * sizeof(unsigned long));
-		if (NULL == alloc->usage_map)
+	if (!_mali_osk_list_empty(&page_table_cache.partial))
+	{
+		alloc = _MALI_OSK_LIST_ENTRY(page_table_cache.partial.next, mali_mmu_page_table_allocation, list);
+	}
+	else if (!_mali_osk_list_empty(&page_table_cache.empty))
+	{
+		/* reuse an allocation from the reserve */
+		alloc = _MALI_OSK_LIST_ENTRY(page_table_cache.empty.next, mali_mmu_page_table_allocation, list);
+		_mali_osk_list_move(&alloc->list, &page_table_cache.partial);
+		page_table_cache.num_empty--;
+	}
+	else
+	{
+		/* no free pages, allocate a new one */
+		alloc = mali_mmu_page_table_block_create();
+		if (NULL == alloc)
 		{
-			MALI_DEBUG_PRINT(1, ("Failed to allocate memory to describe MMU page table cache usage\n"));
-			alloc->pages.release(&alloc->pages);
-			_mali_osk_free(alloc);
 			_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
 			*table_page = MALI_INVALID_PAGE;
 			*mapping = NULL;
 			MALI_ERROR(_MALI_OSK_ERR_NOMEM);
 		}
+		_mali_osk_list_add(&alloc->list, &page_table_cache.partial);
+	}
 
-		_mali_osk_set_nonatomic_bit(0, alloc->usage_map);
+	page_number = _mali_osk_find_first_zero_bit(alloc->usage_map, alloc->num_pages);
+	MALI_DEBUG_PRINT(6, ("Page table allocation found, using page offset %d\n", page_number));
+	_mali_osk_set_nonatomic_bit(page_number, alloc->usage_map);
+	alloc->usage_count++;
+	if (alloc->num_pages == alloc->usage_count)
+	{
+		/* full, move alloc to full list*/
+		_mali_osk_list_move(&alloc->list, &page_table_cache.full);
+	}
 
-		if (alloc->num_pages > 1)
-		{
-			_mali_osk_list_add(&alloc->list, &page_table_cache.partial);
-		}
-		else
-		{
-			_mali_osk_list_add(&alloc->list, &page_table_cache.full);
-		}
+	*table_page = (MALI_MMU_PAGE_SIZE * page_number) + alloc->pages.phys_base;
+	*mapping =  (mali_io_address)((MALI_MMU_PAGE_SIZE * page_number) + (u32)alloc->pages.mapping);
 
-		_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
-		*table_page = alloc->pages.phys_base; /* return the first page */
-		*mapping = alloc->pages.mapping; /* Mapping for first page */
-		MALI_DEBUG_PRINT(4, ("Page table allocated: VA=0x%08X, MaliPA=0x%08X\n", *mapping, *table_page ));
-		MALI_SUCCESS;
-	}
+	_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
+
+	/* The page is ours now, clear it without holding up the cache */
+	_mali_osk_memset((void*)*mapping, 0, MALI_MMU_PAGE_SIZE);
+
+	MALI_DEBUG_PRINT(4, ("Page table allocated for VA=0x%08X, MaliPA=0x%08X\n", *mapping, *table_page ));
+	MALI_SUCCESS;
 }
 
 void mali_mmu_release_table_page(u32 pa)
 {
-	mali_mmu_page_table_allocation * alloc, * temp_alloc;
+	mali_mmu_page_table_allocation * alloc;
+	mali_mmu_page_table_allocation * free_alloc = NULL;
+	u32 start;
 
 	MALI_DEBUG_PRINT_IF(1, pa & 4095, ("Bad page address 0x%x given to mali_mmu_release_table_page\n", (void*)pa));
 
 	MALI_DEBUG_PRINT(4, ("Releasing table page 0x%08X to the cache\n", pa));
 
-   	_mali_osk_lock_wait(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
+	_mali_osk_lock_wait(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
 
 	/* find the entry this address belongs to */
-	/* first check the partial list */
-	_MALI_OSK_LIST_FOREACHENTRY(alloc, temp_alloc, &page_table_cache.partial, mali_mmu_page_table_allocation, list)
+	alloc = mali_mmu_page_table_index_find(pa);
+	if (NULL == alloc)
 	{
-		u32 start = alloc->pages.phys_base;
-		u32 last = start + (alloc->num_pages - 1) * MALI_MMU_PAGE_SIZE;
-		if (pa >= start && pa <= last)
-		{
-			MALI_DEBUG_ASSERT(0 != _mali_osk_test_bit((pa - start)/MALI_MMU_PAGE_SIZE, alloc->usage_map));
-			_mali_osk_clear_nonatomic_bit((pa - start)/MALI_MMU_PAGE_SIZE, alloc->usage_map);
-			alloc->usage_count--;
+		MALI_DEBUG_PRINT(1, ("pa 0x%x not found in the page table cache\n", (void*)pa));
+		_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
+		return;
+	}
 
-			_mali_osk_memset((void*)( ((u32)alloc->pages.mapping) + (pa - start) ), 0, MALI_MMU_PAGE_SIZE);
+	start = alloc->pages.phys_base;
+	MALI_DEBUG_ASSERT(0 != _mali_osk_test_bit((pa - start)/MALI_MMU_PAGE_SIZE, alloc->usage_map));
+	_mali_osk_clear_nonatomic_bit((pa - start)/MALI_MMU_PAGE_SIZE, alloc->usage_map);
+	alloc->usage_count--;
 
-			if (0 == alloc->usage_count)
-			{
-				/* empty, release whole page alloc */
-				_mali_osk_list_del(&alloc->list);
-				alloc->pages.release(&alloc->pages);
-				_mali_osk_free(alloc->usage_map);
-				_mali_osk_free(alloc);
-			}
-		   	_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
-			MALI_DEBUG_PRINT(4, ("(partial list)Released table page 0x%08X to the cache\n", pa));
-			return;
+	if (0 == alloc->usage_count)
+	{
+		if (MALI_MMU_PAGE_TABLE_CACHE_EMPTY_RESERVE > page_table_cache.num_empty)
+		{
+			/* keep it for the next expansion */
+			_mali_osk_list_move(&alloc->list, &page_table_cache.empty);
+			page_table_cache.num_empty++;
+		}
+		else
+		{
+			/* release whole page alloc, once the lock is dropped */
+			_mali_osk_list_del(&alloc->list);
+			mali_mmu_page_table_index_remove(alloc);
+			free_alloc = alloc;
 		}
 	}
+	else if (alloc->num_pages - 1 == alloc->usage_count)
+	{
+		/* was full, transfer to partial list */
+		_mali_osk_list_move(&alloc->list, &page_table_cache.partial);
+	}
 
-	/* the check the full list */
-	_MALI_OSK_LIST_FOREACHENTRY(alloc, temp_alloc, &page_table_cache.full, mali_mmu_page_table_allocation, list)
+	_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
+
+	if (NULL != free_alloc)
 	{
-		u32 start = alloc->pages.phys_base;
-		u32 last = start + (alloc->num_pages - 1) * MALI_MMU_PAGE_SIZE;
-		if (pa >= start && pa <= last)
-		{
-			_mali_osk_clear_nonatomic_bit((pa - start)/MALI_MMU_PAGE_SIZE, alloc->usage_map);
-			alloc->usage_count--;
+		mali_mmu_page_table_block_destroy(free_alloc);
+	}
 
-			_mali_osk_memset((void*)( ((u32)alloc->pages.mapping) + (pa - start) ), 0, MALI_MMU_PAGE_SIZE);
+	MALI_DEBUG_PRINT(4, ("Released table page 0x%08X to the cache\n", pa));
+}
 
+/* Release all empty allocations, the work handler of shrink_work */
+static void mali_mmu_page_table_cache_shrink_work(void *data)
+{
+	mali_mmu_page_table_allocation * alloc, * temp;
+	_MALI_OSK_LIST_HEAD_STATIC_INIT(free_list);
 
-			if (0 == alloc->usage_count)
-			{
-				/* empty, release whole page alloc */
-				_mali_osk_list_del(&alloc->list);
-				alloc->pages.release(&alloc->pages);
-				_mali_osk_free(alloc->usage_map);
-				_mali_osk_free(alloc);
-			}
-			else
-			{
-				/* transfer to partial list */
-				_mali_osk_list_move(&alloc->list, &page_table_cache.partial);
-			}
+	_mali_osk_lock_wait(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
 
-		   	_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
-			MALI_DEBUG_PRINT(4, ("(full list)Released table page 0x%08X to the cache\n", pa));
-			return;
-		}
+	_MALI_OSK_LIST_FOREACHENTRY(alloc, temp, &page_table_cache.empty, mali_mmu_page_table_allocation, list)
+	{
+		_mali_osk_list_move(&alloc->list, &free_list);
+		mali_mmu_page_table_index_remove(alloc);
+		page_table_cache.num_empty--;
+	}
+
+	_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
+
+	_MALI_OSK_LIST_FOREACHENTRY(alloc, temp, &free_list, mali_mmu_page_table_allocation, list)
+	{
+		_mali_osk_list_del(&alloc->list);
+		mali_mmu_page_table_block_destroy(alloc);
+	}
+}
+
+/*
+ * The allocations are not released here, since the OS memory allocator
+ * may be allocating pages with its lock held, which releasing waits for.
+ */
+static u32 mali_mmu_page_table_cache_shrink(u32 nr_pages, void *data)
+{
+	mali_mmu_page_table_allocation * alloc, * temp;
+	u32 reclaimable = 0;
+
+	/* Page tables are allocated with the cache lock held, never wait for it here */
+	if (_MALI_OSK_ERR_OK != _mali_osk_lock_trywait(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW))
+	{
+		return 0;
+	}
+
+	_MALI_OSK_LIST_FOREACHENTRY(alloc, temp, &page_table_cache.empty, mali_mmu_page_table_allocation, list)
+	{
+		reclaimable += alloc->num_pages;
 	}
 
-	MALI_DEBUG_PRINT(1, ("pa 0x%x not found in the page table cache\n", (void*)pa));
+	_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
+
+	if (0 != nr_pages && 0 != reclaimable)
+	{
+		_mali_osk_wq_schedule_work(page_table_cache.shrink_work);
+	}
 
-   	_mali_osk_lock_signal(page_table_cache.lock, _MALI_OSK_LOCKMODE_RW);
+	return reclaimable;
 }
 
 static _mali_osk_errcode_t mali_mmu_page_table_cache_create(void)
 {
+	u32 i;
+
 	page_table_cache.lock = _mali_osk_lock_init( _MALI_OSK_LOCKFLAG_ORDERED | _MALI_OSK_LOCKFLAG_ONELOCK
 	                            | _MALI_OSK_LOCKFLAG_NONINTERRUPTABLE, 0, _MALI_OSK_LOCK_ORDER_MEM_PT_CACHE);
 	MALI_CHECK_NON_NULL( page_table_cache.lock, _MALI_OSK_ERR_FAULT );
 	_MALI_OSK_INIT_LIST_HEAD(&page_table_cache.partial);
 	_MALI_OSK_INIT_LIST_HEAD(&page_table_cache.full);
+	_MALI_OSK_INIT_LIST_HEAD(&page_table_cache.empty);
+	page_table_cache.num_empty = 0;
+	for (i = 0; i < MALI_MMU_PAGE_TABLE_INDEX_SIZE; i++)
+	{
+		_MALI_OSK_INIT_LIST_HEAD(&page_table_cache.index[i]);
+	}
+
+	/* Not fatal, the reserve is just not given back under memory pressure */
+	page_table_cache.shrinker = NULL;
+	page_table_cache.shrink_work = _mali_osk_wq_create_work(mali_mmu_page_table_cache_shrink_work, NULL);
+	if (NULL != page_table_cache.shrink_work)
+	{
+		page_table_cache.shrinker = _mali_osk_shrinker_register(mali_mmu_page_table_cache_shrink, NULL);
+	}
+	MALI_DEBUG_PRINT_IF(1, NULL == page_table_cache.shrinker, ("Failed to register page table cache shrinker\n"));
+
 	MALI_SUCCESS;
 }
 
@@ -1271,13 +3418,32 @@ static void mali_mmu_page_table_cache_destroy(void)
 {
 	mali_mmu_page_table_allocation * alloc, *temp;
 
+	if (NULL != page_table_cache.shrinker)
+	{
+		_mali_osk_shrinker_unregister(page_table_cache.shrinker);
+		page_table_cache.shrinker = NULL;
+	}
+
+	if (NULL != page_table_cache.shrink_work)
+	{
+		_mali_osk_wq_delete_work(page_table_cache.shrink_work);
+		page_table_cache.shrink_work = NULL;
+	}
+
+	_MALI_OSK_LIST_FOREACHENTRY(alloc, temp, &page_table_cache.empty, mali_mmu_page_table_allocation, list)
+	{
+		_mali_osk_list_del(&alloc->list);
+		mali_mmu_page_table_index_remove(alloc);
+		mali_mmu_page_table_block_destroy(alloc);
+	}
+	page_table_cache.num_empty = 0;
+
 	_MALI_OSK_LIST_FOREACHENTRY(alloc, temp, &page_table_cache.partial, mali_mmu_page_table_allocation, list)
 	{
 		MALI_DEBUG_PRINT_IF(1, 0 != alloc->usage_count, ("Destroying page table cache while pages are tagged as in use. %d allocations still marked as in use.\n", alloc->usage_count));
 		_mali_osk_list_del(&alloc->list);
-		alloc->pages.release(&alloc->pages);
-		_mali_osk_free(alloc->usage_map);
-		_mali_osk_free(alloc);
+		mali_mmu_page_table_index_remove(alloc);
+		mali_mmu_page_table_block_destroy(alloc);
 	}
 
 	MALI_DEBUG_PRINT_IF(1, !_mali_osk_list_empty(&page_table_cache.full), ("Page table cache full list contains one or more elements \n"));
@@ -1286,9 +3452,8 @@ static void mali_mmu_page_table_cache_destroy(void)
 	{
 		MALI_DEBUG_PRINT(1, ("Destroy alloc 0x%08X with usage count %d\n", (u32)alloc, alloc->usage_count));
 		_mali_osk_list_del(&alloc->list);
-		alloc->pages.release(&alloc->pages);
-		_mali_osk_free(alloc->usage_map);
-		_mali_osk_free(alloc);
+		mali_mmu_page_table_index_remove(alloc);
+		mali_mmu_page_table_block_destroy(alloc);
 	}
 
 	_mali_osk_lock_term(page_table_cache.lock);
@@ -83,4 +83,45 @@ _mali_osk_errcode_t mali_memory_core_resource_dedicated_memory(u32 start, u32 si
 
 mali_allocation_engine mali_mem_get_memory_engine(void);
 
+/**
+ * Start freeing a batch of allocations.
+ * Until mali_memory_free_batch_end(), freed allocations only leave the page
+ * tables. The TLBs are then zapped once for the whole batch.
+ * @param session Session the allocations belong to
+ */
+void mali_memory_free_batch_begin(struct mali_session_data *session);
+
+/**
+ * Finish freeing a batch of allocations started with mali_memory_free_batch_begin().
+ * @param session Session the allocations belong to
+ */
+void mali_memory_free_batch_end(struct mali_session_data *session);
+
+/**
+ * Commit pages to grow-on-fault memory to resolve a GPU page fault.
+ * Called from the MMU bottom half, without any group lock held. The owning
+ * process' mmap semaphore is not taken, the CPU page fault handler reads the
+ * committed pages under the session memory lock instead.
+ * @param session Session the faulting job belongs to
+ * @param fault_address GPU virtual address the MMU faulted on
+ * @return _MALI_OSK_ERR_OK if the page is now mapped and the faulting access can be retried
+ */
+_mali_osk_errcode_t mali_memory_grow_on_fault(struct mali_session_data *session, u32 fault_address);
+
+/**
+ * Dump statistics of the small object slab heaps of all sessions, per size class
+ * @param buf Buffer to write to
+ * @param size Size of the buffer
+ * @return Number of bytes written
+ */
+u32 mali_memory_dump_slab_stats(char *buf, u32 size);
+
+/**
+ * Dump the GPU virtual address space usage and fragmentation of each session.
+ * @param buf Buffer to write the statistics to
+ * @param size Size of buf
+ * @return Number of bytes written to buf
+ */
+u32 mali_memory_dump_va_stats(char *buf, u32 size);
+
 #endif /* __MALI_MEMORY_H__ */
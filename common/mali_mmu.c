@@ -268,6 +268,17 @@ void mali_mmu_page_fault_done(struct mali_mmu_core *mmu)
 	mali_hw_core_register_write(&mmu->hw_core, MALI_MMU_REGISTER_COMMAND, MALI_MMU_COMMAND_PAGE_FAULT_DONE);
 }
 
+void mali_mmu_page_fault_resume(struct mali_mmu_core *mmu)
+{
+	MALI_DEBUG_ASSERT(mali_hw_core_register_read(&mmu->hw_core, MALI_MMU_REGISTER_STATUS) & MALI_MMU_STATUS_BIT_PAGE_FAULT_ACTIVE);
+
+	/* Stall is not possible in page fault mode, and not needed since the MMU is not translating */
+	mali_mmu_zap_tlb_without_stall(mmu);
+	mali_hw_core_register_write(&mmu->hw_core, MALI_MMU_REGISTER_INT_CLEAR, MALI_MMU_INTERRUPT_PAGE_FAULT);
+	mali_mmu_page_fault_done(mmu);
+	mali_hw_core_register_write(&mmu->hw_core, MALI_MMU_REGISTER_INT_MASK, MALI_MMU_INTERRUPT_PAGE_FAULT | MALI_MMU_INTERRUPT_READ_BUS_ERROR);
+}
+
 MALI_STATIC_INLINE _mali_osk_errcode_t mali_mmu_raw_reset(struct mali_mmu_core *mmu)
 {
 	int i;
@@ -315,6 +326,7 @@ _mali_osk_errcode_t mali_mmu_reset(struct mali_mmu_core *mmu)
 		err = _MALI_OSK_ERR_OK;
 	}
 	mali_mmu_disable_stall(mmu);
+	mmu->pagedir = NULL;
 
 	return err;
 }
@@ -341,11 +353,49 @@ void mali_mmu_zap_tlb_without_stall(struct mali_mmu_core *mmu)
 }
 
 
+mali_bool mali_mmu_zap_tlb_if_stale(struct mali_mmu_core *mmu, struct mali_page_directory *pagedir)
+{
+	/* Read before zapping, a change made meanwhile leaves the TLB marked as stale */
+	u32 generation = pagedir->generation;
+
+	if (mmu->pagedir == pagedir && mmu->pagedir_generation == generation)
+	{
+		return MALI_FALSE;
+	}
+
+	mali_mmu_zap_tlb_without_stall(mmu);
+	mmu->pagedir = pagedir;
+	mmu->pagedir_generation = generation;
+	return MALI_TRUE;
+}
+
 void mali_mmu_invalidate_page(struct mali_mmu_core *mmu, u32 mali_address)
 {
 	mali_hw_core_register_write(&mmu->hw_core, MALI_MMU_REGISTER_ZAP_ONE_LINE, MALI_MMU_PDE_ENTRY(mali_address));
 }
 
+mali_bool mali_mmu_invalidate_pages(struct mali_mmu_core *mmu, u32 mali_address, u32 num_pages)
+{
+	mali_bool stall_success = mali_mmu_enable_stall(mmu);
+	const u32 last_pde = MALI_MMU_PDE_ENTRY(mali_address + num_pages * MALI_MMU_PAGE_SIZE - 1);
+	u32 i;
+
+	/* The register takes a page directory index, as the vendor driver writes it, so one line per page table */
+	for (i = MALI_MMU_PDE_ENTRY(mali_address); i <= last_pde; i++)
+	{
+		mali_mmu_invalidate_page(mmu, i * MALI_MMU_VIRTUAL_PAGE_SIZE);
+	}
+
+	if (MALI_FALSE == stall_success)
+	{
+		/* False means that it is in Pagefault state. Not possible to disable_stall then */
+		return MALI_FALSE;
+	}
+
+	mali_mmu_disable_stall(mmu);
+	return MALI_TRUE;
+}
+
 static void mali_mmu_activate_address_space(struct mali_mmu_core *mmu, u32 page_directory)
 {
 	/* The MMU must be in stalled or page fault mode, for this writing to work */
@@ -365,6 +415,9 @@ mali_bool mali_mmu_activate_page_directory(struct mali_mmu_core *mmu, struct mal
 	stall_success = mali_mmu_enable_stall(mmu);
 
 	if ( MALI_FALSE==stall_success ) return MALI_FALSE;
+	/* Switching address space zaps the TLB, the generation is read before that */
+	mmu->pagedir_generation = pagedir->generation;
+	mmu->pagedir = pagedir;
 	mali_mmu_activate_address_space(mmu, pagedir->page_directory);
 	mali_mmu_disable_stall(mmu);
 	return MALI_TRUE;
@@ -385,6 +438,7 @@ void mali_mmu_activate_empty_page_directory(struct mali_mmu_core* mmu)
 
 	mali_mmu_activate_address_space(mmu, mali_empty_page_directory);
 	mali_mmu_disable_stall(mmu);
+	mmu->pagedir = NULL;
 }
 
 void mali_mmu_activate_fault_flush_page_directory(struct mali_mmu_core* mmu)
@@ -397,6 +451,7 @@ void mali_mmu_activate_fault_flush_page_directory(struct mali_mmu_core* mmu)
 	/* This function is expect to fail the stalling, since it might be in PageFault mode when it is called */
 	mali_mmu_activate_address_space(mmu, mali_page_fault_flush_page_directory);
 	if ( MALI_TRUE==stall_success ) mali_mmu_disable_stall(mmu);
+	mmu->pagedir = NULL;
 }
 
 /* Is called when we want the mmu to give an interrupt */
@@ -68,6 +68,8 @@ struct mali_mmu_core
 {
 	struct mali_hw_core hw_core; /**< Common for all HW cores */
 	_mali_osk_irq_t *irq;        /**< IRQ handler */
+	struct mali_page_directory *pagedir; /**< Page directory the TLB was last brought up to date with, NULL if unknown */
+	u32 pagedir_generation;      /**< Generation of \a pagedir when the TLB was last zapped */
 };
 
 _mali_osk_errcode_t mali_mmu_initialize(void);
@@ -82,6 +84,30 @@ mali_bool mali_mmu_zap_tlb(struct mali_mmu_core *mmu);
 void mali_mmu_zap_tlb_without_stall(struct mali_mmu_core *mmu);
 void mali_mmu_invalidate_page(struct mali_mmu_core *mmu, u32 mali_address);
 
+/**
+ * Zap the TLB, without stalling, only if the page tables changed since the MMU last saw \a pagedir
+ * @param mmu The MMU with \a pagedir active
+ * @param pagedir The active page directory
+ * @return MALI_TRUE if the TLB was zapped
+ */
+mali_bool mali_mmu_zap_tlb_if_stale(struct mali_mmu_core *mmu, struct mali_page_directory *pagedir);
+
+/**
+ * Invalidate the TLB entries of a range of pages, stalling the MMU while doing so.
+ * One line is zapped for each page table covering the range.
+ * Only valid if the page tables covering the range are kept.
+ * @param mmu The MMU to invalidate
+ * @param mali_address First page of the range
+ * @param num_pages Number of pages in the range
+ * @return MALI_FALSE if the MMU could not be stalled, because it is in page fault mode
+ */
+mali_bool mali_mmu_invalidate_pages(struct mali_mmu_core *mmu, u32 mali_address, u32 num_pages);
+
+/**
+ * Ranges with more pages than this are zapped as a whole instead of page by page
+ */
+#define MALI_MMU_INVALIDATE_PAGES_MAX 16
+
 mali_bool mali_mmu_activate_page_directory(struct mali_mmu_core* mmu, struct mali_page_directory *pagedir);
 void mali_mmu_activate_empty_page_directory(struct mali_mmu_core* mmu);
 void mali_mmu_activate_fault_flush_page_directory(struct mali_mmu_core* mmu);
@@ -101,6 +127,13 @@ void mali_mmu_disable_stall(struct mali_mmu_core *mmu);
 
 void mali_mmu_page_fault_done(struct mali_mmu_core *mmu);
 
+/**
+ * Let the MMU retry the faulting access after the missing page has been mapped.
+ * The TLB is zapped, the page fault interrupt cleared and unmasked, and the MMU leaves page fault mode.
+ * @param mmu The MMU which reported the page fault
+ */
+void mali_mmu_page_fault_resume(struct mali_mmu_core *mmu);
+
 /*** Register reading/writing functions ***/
 MALI_STATIC_INLINE u32 mali_mmu_get_int_status(struct mali_mmu_core *mmu)
 {
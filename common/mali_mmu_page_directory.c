@@ -102,17 +102,33 @@ void mali_destroy_fault_flush_pages(u32 *page_directory, u32 *page_table, u32 *d
 
 static _mali_osk_errcode_t fill_page(mali_io_address mapping, u32 data)
 {
-	int i;
 	MALI_DEBUG_ASSERT_POINTER( mapping );
 
-	for(i = 0; i < MALI_MMU_PAGE_SIZE/4; i++)
-	{
-		_mali_osk_mem_iowrite32_relaxed( mapping, i * sizeof(u32), data);
-	}
+	_mali_osk_mem_iowrite32_relaxed_run(mapping, 0, data, 0, MALI_MMU_PAGE_SIZE / sizeof(u32));
 	_mali_osk_mem_barrier();
 	MALI_SUCCESS;
 }
 
+/* Number of PTEs from mali_address to the end of its page table, at most num_pages */
+MALI_STATIC_INLINE u32 mali_mmu_ptes_in_table(u32 mali_address, u32 num_pages)
+{
+	u32 left_in_table = MALI_MMU_PAGE_SIZE / sizeof(u32) - MALI_MMU_PTE_ENTRY(mali_address);
+
+	return (num_pages < left_in_table) ? num_pages : left_in_table;
+}
+
+/* Called after the barrier which makes the page table writes visible, so an MMU never records a generation older than its TLB */
+MALI_STATIC_INLINE void mali_mmu_pagedir_changed(struct mali_page_directory *pagedir)
+{
+	pagedir->generation++;
+
+	/* The MMU reads page tables through the L2 cache */
+	if (MALI_TRUE != pagedir->scratch)
+	{
+		mali_l2_cache_mark_dirty();
+	}
+}
+
 _mali_osk_errcode_t mali_mmu_pagedir_map(struct mali_page_directory *pagedir, u32 mali_address, u32 size)
 {
 	const int first_pde = MALI_MMU_PDE_ENTRY(mali_address);
@@ -120,15 +136,17 @@ _mali_osk_errcode_t mali_mmu_pagedir_map(struct mali_page_directory *pagedir, u3
 	_mali_osk_errcode_t err;
 	mali_io_address pde_mapping;
 	u32 pde_phys;
+	mali_bool pd_changed = MALI_FALSE;
 	int i;
 
 	for(i = first_pde; i <= last_pde; i++)
 	{
-		if(0 == (_mali_osk_mem_ioread32(pagedir->page_directory_mapped, i*sizeof(u32)) & MALI_MMU_FLAGS_PRESENT))
+		/* Tracked alongside the PDE, which is slow to read back from write-combined memory */
+		if(NULL == pagedir->page_entries_mapped[i])
 		{
 			/* Page table not present */
 			MALI_DEBUG_ASSERT(0 == pagedir->page_entries_usage_count[i]);
-			MALI_DEBUG_ASSERT(NULL == pagedir->page_entries_mapped[i]);
+			MALI_DEBUG_ASSERT(0 == (_mali_osk_mem_ioread32(pagedir->page_directory_mapped, i*sizeof(u32)) & MALI_MMU_FLAGS_PRESENT));
 
 			err = mali_mmu_get_table_page(&pde_phys, &pde_mapping);
 			if(_MALI_OSK_ERR_OK != err)
@@ -144,6 +162,7 @@ _mali_osk_errcode_t mali_mmu_pagedir_map(struct mali_page_directory *pagedir, u3
 
 			MALI_DEBUG_ASSERT(0 == pagedir->page_entries_usage_count[i]);
 			pagedir->page_entries_usage_count[i] = 1;
+			pd_changed = MALI_TRUE;
 		}
 		else
 		{
@@ -152,19 +171,20 @@ _mali_osk_errcode_t mali_mmu_pagedir_map(struct mali_page_directory *pagedir, u3
 	}
 	_mali_osk_write_mem_barrier();
 
+	if (pd_changed)
+	{
+		mali_mmu_pagedir_changed(pagedir);
+	}
+
 	MALI_SUCCESS;
 }
 
 MALI_STATIC_INLINE void mali_mmu_zero_pte(mali_io_address page_table, u32 mali_address, u32 size)
 {
-	int i;
 	const int first_pte = MALI_MMU_PTE_ENTRY(mali_address);
 	const int last_pte = MALI_MMU_PTE_ENTRY(mali_address + size - 1);
 
-	for (i = first_pte; i <= last_pte; i++)
-	{
-		_mali_osk_mem_iowrite32_relaxed(page_table, i * sizeof(u32), 0);
-	}
+	_mali_osk_mem_iowrite32_relaxed_run(page_table, first_pte * sizeof(u32), 0, 0, last_pte - first_pte + 1);
 }
 
 _mali_osk_errcode_t mali_mmu_pagedir_unmap(struct mali_page_directory *pagedir, u32 mali_address, u32 size)
@@ -234,6 +254,7 @@ _mali_osk_errcode_t mali_mmu_pagedir_unmap(struct mali_page_directory *pagedir,
 		mali_address += size_in_pde;
 	}
 	_mali_osk_write_mem_barrier();
+	mali_mmu_pagedir_changed(pagedir);
 
 	/* L2 pages invalidation */
 	if (MALI_TRUE == pd_changed)
@@ -250,6 +271,11 @@ _mali_osk_errcode_t mali_mmu_pagedir_unmap(struct mali_page_directory *pagedir,
 		}
 	}
 
+	if (MALI_TRUE == pagedir->scratch)
+	{
+		MALI_SUCCESS;
+	}
+
 	if (invalidate_all)
 	{
 		mali_l2_cache_invalidate_all();
@@ -262,7 +288,7 @@ _mali_osk_errcode_t mali_mmu_pagedir_unmap(struct mali_page_directory *pagedir,
 	MALI_SUCCESS;
 }
 
-struct mali_page_directory *mali_mmu_pagedir_alloc(void)
+static struct mali_page_directory *mali_mmu_pagedir_create(mali_bool scratch)
 {
 	struct mali_page_directory *pagedir;
 
@@ -278,12 +304,23 @@ struct mali_page_directory *mali_mmu_pagedir_alloc(void)
 		return NULL;
 	}
 
+	pagedir->scratch = scratch;
+
 	/* Zero page directory */
 	fill_page(pagedir->page_directory_mapped, 0);
+	if (MALI_TRUE != scratch)
+	{
+		mali_l2_cache_mark_dirty();
+	}
 
 	return pagedir;
 }
 
+struct mali_page_directory *mali_mmu_pagedir_alloc(void)
+{
+	return mali_mmu_pagedir_create(MALI_FALSE);
+}
+
 void mali_mmu_pagedir_free(struct mali_page_directory *pagedir)
 {
 	const int num_page_table_entries = sizeof(pagedir->page_entries_mapped) / sizeof(pagedir->page_entries_mapped[0]);
@@ -292,7 +329,7 @@ void mali_mmu_pagedir_free(struct mali_page_directory *pagedir)
 	/* Free referenced page tables and zero PDEs. */
 	for (i = 0; i < num_page_table_entries; i++)
 	{
-		if (pagedir->page_directory_mapped && (_mali_osk_mem_ioread32(pagedir->page_directory_mapped, sizeof(u32)*i) & MALI_MMU_FLAGS_PRESENT))
+		if (NULL != pagedir->page_entries_mapped[i])
 		{
 			mali_mmu_release_table_page( _mali_osk_mem_ioread32(pagedir->page_directory_mapped, i*sizeof(u32)) & ~MALI_MMU_FLAGS_MASK);
 			_mali_osk_mem_iowrite32_relaxed(pagedir->page_directory_mapped, i * sizeof(u32), 0);
@@ -307,9 +344,8 @@ void mali_mmu_pagedir_free(struct mali_page_directory *pagedir)
 }
 
 
-void mali_mmu_pagedir_update(struct mali_page_directory *pagedir, u32 mali_address, u32 phys_address, u32 size, mali_memory_cache_settings cache_settings)
+static u32 mali_mmu_permission_bits(mali_memory_cache_settings cache_settings)
 {
-	u32 end_address = mali_address + size;
 	u32 permission_bits;
 
 	switch ( cache_settings )
@@ -327,15 +363,98 @@ void mali_mmu_pagedir_update(struct mali_page_directory *pagedir, u32 mali_addre
 		permission_bits = MALI_MMU_FLAGS_WRITE_PERMISSION | MALI_MMU_FLAGS_READ_PERMISSION | MALI_MMU_FLAGS_PRESENT;
 	}
 
-	/* Map physical pages into MMU page tables */
-	for ( ; mali_address < end_address; mali_address += MALI_MMU_PAGE_SIZE, phys_address += MALI_MMU_PAGE_SIZE)
+	return permission_bits;
+}
+
+void mali_mmu_pagedir_update(struct mali_page_directory *pagedir, u32 mali_address, u32 phys_address, u32 size, mali_memory_cache_settings cache_settings)
+{
+	u32 num_pages = (size + MALI_MMU_PAGE_SIZE - 1) / MALI_MMU_PAGE_SIZE;
+	u32 permission_bits = mali_mmu_permission_bits(cache_settings);
+
+	/* Map physical pages into MMU page tables, the contiguous PTEs of a page table in one run */
+	while (0 < num_pages)
+	{
+		u32 count = mali_mmu_ptes_in_table(mali_address, num_pages);
+
+		MALI_DEBUG_ASSERT_POINTER(pagedir->page_entries_mapped[MALI_MMU_PDE_ENTRY(mali_address)]);
+		_mali_osk_mem_iowrite32_relaxed_run(pagedir->page_entries_mapped[MALI_MMU_PDE_ENTRY(mali_address)],
+		                MALI_MMU_PTE_ENTRY(mali_address) * sizeof(u32),
+		                phys_address | permission_bits, MALI_MMU_PAGE_SIZE, count);
+
+		mali_address += count * MALI_MMU_PAGE_SIZE;
+		phys_address += count * MALI_MMU_PAGE_SIZE;
+		num_pages -= count;
+	}
+	_mali_osk_write_mem_barrier();
+	mali_mmu_pagedir_changed(pagedir);
+}
+
+void mali_mmu_pagedir_update_pages(struct mali_page_directory *pagedir, u32 mali_address, const u32 *phys_addrs, u32 num_pages, mali_memory_cache_settings cache_settings)
+{
+	u32 permission_bits = mali_mmu_permission_bits(cache_settings);
+
+	/* Map physical pages into MMU page tables, only one barrier is needed for all of them */
+	while (0 < num_pages)
 	{
+		u32 count = mali_mmu_ptes_in_table(mali_address, num_pages);
+
 		MALI_DEBUG_ASSERT_POINTER(pagedir->page_entries_mapped[MALI_MMU_PDE_ENTRY(mali_address)]);
-		_mali_osk_mem_iowrite32_relaxed(pagedir->page_entries_mapped[MALI_MMU_PDE_ENTRY(mali_address)],
+		_mali_osk_mem_iowrite32_relaxed_array(pagedir->page_entries_mapped[MALI_MMU_PDE_ENTRY(mali_address)],
 		                MALI_MMU_PTE_ENTRY(mali_address) * sizeof(u32),
-			        phys_address | permission_bits);
+		                phys_addrs, permission_bits, count);
+
+		mali_address += count * MALI_MMU_PAGE_SIZE;
+		phys_addrs += count;
+		num_pages -= count;
 	}
 	_mali_osk_write_mem_barrier();
+	mali_mmu_pagedir_changed(pagedir);
+}
+
+void mali_mmu_pagedir_clear(struct mali_page_directory *pagedir, u32 mali_address, u32 size)
+{
+	const int first_pde = MALI_MMU_PDE_ENTRY(mali_address);
+	const int last_pde = MALI_MMU_PDE_ENTRY(mali_address + size - 1);
+	u32 left = size;
+	u32 pages_to_invalidate[2];
+	u32 num_pages_inv = 0;
+	int i;
+
+	for (i = first_pde; i <= last_pde; i++)
+	{
+		u32 offset = (mali_address & (MALI_MMU_VIRTUAL_PAGE_SIZE - 1));
+		u32 size_in_pde = (left < MALI_MMU_VIRTUAL_PAGE_SIZE - offset) ? left : MALI_MMU_VIRTUAL_PAGE_SIZE - offset;
+
+		MALI_DEBUG_ASSERT_POINTER(pagedir->page_entries_mapped[i]);
+
+		mali_mmu_zero_pte(pagedir->page_entries_mapped[i], mali_address, size_in_pde);
+
+		if (num_pages_inv < 2)
+		{
+			pages_to_invalidate[num_pages_inv] = mali_page_directory_get_phys_address(pagedir, i);
+		}
+		num_pages_inv++;
+
+		left -= size_in_pde;
+		mali_address += size_in_pde;
+	}
+	_mali_osk_write_mem_barrier();
+	mali_mmu_pagedir_changed(pagedir);
+
+	if (MALI_TRUE == pagedir->scratch)
+	{
+		return;
+	}
+
+	/* Large ranges touch many page tables, then it is cheaper to invalidate everything */
+	if (num_pages_inv > 2)
+	{
+		mali_l2_cache_invalidate_all();
+	}
+	else
+	{
+		mali_l2_cache_invalidate_all_pages(pages_to_invalidate, num_pages_inv);
+	}
 }
 
 u32 mali_page_directory_get_phys_address(struct mali_page_directory *pagedir, u32 index)
@@ -343,6 +462,84 @@ u32 mali_page_directory_get_phys_address(struct mali_page_directory *pagedir, u3
 	return (_mali_osk_mem_ioread32(pagedir->page_directory_mapped, index*sizeof(u32)) & ~MALI_MMU_FLAGS_MASK);
 }
 
+#if defined(DEBUG)
+/* Time between two monotonic timestamps in microseconds, at least 1 */
+MALI_STATIC_INLINE u32 mali_mmu_benchmark_us(u64 start, u64 end)
+{
+	u32 us = ((u32)(end - start)) / 1000;
+	return (0 == us) ? 1 : us;
+}
+
+u32 mali_mmu_pagedir_benchmark(char *buf, u32 size)
+{
+	/* Any address works, the page directory is never used by the MMU. Made up physical pages are mapped. */
+	const u32 mali_address = 0x10000000;
+	const u32 phys_address = 0x80000000;
+	u32 n = 0;
+	u32 mib;
+
+	n += _mali_osk_snprintf(buf + n, size - n, "    Size        map     update  update_pages      clear      unmap\n");
+
+	for (mib = 1; mib <= 256; mib *= 4)
+	{
+		struct mali_page_directory *pagedir;
+		u32 range_size = mib * 1024 * 1024;
+		u32 num_pages = range_size / MALI_MMU_PAGE_SIZE;
+		u32 *phys_addrs;
+		u64 t[6];
+		u32 i;
+
+		/* Keeps the L2 caches and their statistics out of it */
+		pagedir = mali_mmu_pagedir_create(MALI_TRUE);
+		phys_addrs = _mali_osk_valloc(num_pages * sizeof(u32));
+		if (NULL == pagedir || NULL == phys_addrs)
+		{
+			if (NULL != pagedir) mali_mmu_pagedir_free(pagedir);
+			if (NULL != phys_addrs) _mali_osk_vfree(phys_addrs);
+			n += _mali_osk_snprintf(buf + n, size - n, "%4u MiB: out of memory\n", mib);
+			break;
+		}
+
+		/* Scattered pages, as they come from the OS allocator */
+		for (i = 0; i < num_pages; i++)
+		{
+			phys_addrs[i] = phys_address + ((i * 7) % num_pages) * MALI_MMU_PAGE_SIZE;
+		}
+
+		t[0] = _mali_osk_time_get_monotonic_ns();
+		if (_MALI_OSK_ERR_OK != mali_mmu_pagedir_map(pagedir, mali_address, range_size))
+		{
+			mali_mmu_pagedir_free(pagedir);
+			_mali_osk_vfree(phys_addrs);
+			n += _mali_osk_snprintf(buf + n, size - n, "%4u MiB: out of page tables\n", mib);
+			break;
+		}
+		t[1] = _mali_osk_time_get_monotonic_ns();
+		mali_mmu_pagedir_update(pagedir, mali_address, phys_address, range_size, MALI_CACHE_STANDARD);
+		t[2] = _mali_osk_time_get_monotonic_ns();
+		mali_mmu_pagedir_update_pages(pagedir, mali_address, phys_addrs, num_pages, MALI_CACHE_STANDARD);
+		t[3] = _mali_osk_time_get_monotonic_ns();
+		mali_mmu_pagedir_clear(pagedir, mali_address, range_size);
+		t[4] = _mali_osk_time_get_monotonic_ns();
+		mali_mmu_pagedir_unmap(pagedir, mali_address, range_size);
+		t[5] = _mali_osk_time_get_monotonic_ns();
+
+		mali_mmu_pagedir_free(pagedir);
+		_mali_osk_vfree(phys_addrs);
+
+		/* Times for the page table (un)mapping, MiB/s for writing the PTEs */
+		n += _mali_osk_snprintf(buf + n, size - n, "%4u MiB: %7u us %6u MiB/s %7u MiB/s %6u MiB/s %7u us\n", mib,
+		                        mali_mmu_benchmark_us(t[0], t[1]),
+		                        (mib * 1000000) / mali_mmu_benchmark_us(t[1], t[2]),
+		                        (mib * 1000000) / mali_mmu_benchmark_us(t[2], t[3]),
+		                        (mib * 1000000) / mali_mmu_benchmark_us(t[3], t[4]),
+		                        mali_mmu_benchmark_us(t[4], t[5]));
+	}
+
+	return n;
+}
+#endif /* DEBUG */
+
 /* For instrumented */
 struct dump_info
 {
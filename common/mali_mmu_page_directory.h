@@ -78,6 +78,8 @@ struct mali_page_directory
 
 	mali_io_address page_entries_mapped[1024]; /**< Pointers to the page tables which exists in the page directory mapped into the kernel's address space */
 	u32   page_entries_usage_count[1024]; /**< Tracks usage count of the page table pages, so they can be releases on the last reference */
+	u32   generation; /**< Bumped on every change to the page tables, an MMU which saw the same generation has nothing stale in its TLB */
+	mali_bool scratch; /**< Never used by an MMU, changes leave the L2 caches alone */
 };
 
 /* Map Mali virtual address space (i.e. ensure page tables exist for the virtual range)  */
@@ -87,8 +89,19 @@ _mali_osk_errcode_t mali_mmu_pagedir_unmap(struct mali_page_directory *pagedir,
 /* Back virtual address space with actual pages. Assumes input is contiguous and 4k aligned. */
 void mali_mmu_pagedir_update(struct mali_page_directory *pagedir, u32 mali_address, u32 phys_address, u32 size, u32 cache_settings);
 
+/* Back virtual address space with an array of (not necessarily contiguous) 4k pages. */
+void mali_mmu_pagedir_update_pages(struct mali_page_directory *pagedir, u32 mali_address, const u32 *phys_addrs, u32 num_pages, u32 cache_settings);
+
+/* Remove the backing pages from a virtual range, keeping the page tables. The MMU TLB must be zapped before the pages are reused. */
+void mali_mmu_pagedir_clear(struct mali_page_directory *pagedir, u32 mali_address, u32 size);
+
 u32 mali_page_directory_get_phys_address(struct mali_page_directory *pagedir, u32 index);
 
+#if defined(DEBUG)
+/* Measure how fast ranges of 1 MiB to 256 MiB are mapped, filled, cleared and unmapped in a scratch page directory */
+u32 mali_mmu_pagedir_benchmark(char *buf, u32 size);
+#endif
+
 u32 mali_allocate_empty_page(void);
 void mali_free_empty_page(u32 address);
 _mali_osk_errcode_t mali_create_fault_flush_pages(u32 *page_directory, u32 *page_table, u32 *data_page);
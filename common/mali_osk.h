@@ -201,6 +201,8 @@ typedef enum
 	_MALI_OSK_LOCK_ORDER_LAST = 0,
 
 	_MALI_OSK_LOCK_ORDER_SESSION_PENDING_JOBS,
+	_MALI_OSK_LOCK_ORDER_PP_POLL,
+	_MALI_OSK_LOCK_ORDER_WATCHDOG,
 	_MALI_OSK_LOCK_ORDER_PM_EXECUTE,
 	_MALI_OSK_LOCK_ORDER_UTILIZATION,
 	_MALI_OSK_LOCK_ORDER_L2_COUNTER,
@@ -406,7 +408,26 @@ typedef struct _mali_io_address * mali_io_address;
 typedef enum
 {
 	_MALI_OSK_MEM_MAPREGION_FLAG_OS_ALLOCATED_PHYSADDR = 0x1, /**< Physical address is OS Allocated */
+	_MALI_OSK_MEM_MAPREGION_FLAG_DECOMMIT = 0x2,              /**< The mapping stays in use, pages the CPU may have accessed must be unmapped from it */
 } _mali_osk_mem_mapregion_flags_t;
+
+/** @brief Private type for memory shrinker objects */
+typedef struct _mali_osk_shrinker_t_struct _mali_osk_shrinker_t;
+
+/** @brief Memory shrinker callback function
+ *
+ * Called by the OS when it is short of memory. The callback should free up
+ * to  nr_pages pages of memory it is keeping cached. When  nr_pages is
+ * 0, nothing should be freed.
+ *
+ * The callback must not block waiting for locks which may be held while
+ * allocating memory.
+ *
+ * @param nr_pages Number of pages to free
+ * @param data Data passed to _mali_osk_shrinker_register()
+ * @return The number of pages which can still be freed
+ */
+typedef u32 (*_mali_osk_shrinker_callback_t)( u32 nr_pages, void *data );
 /** @} */ /* end group _mali_osk_low_level_memory */
 
 /** @defgroup _mali_osk_notification OSK Notification Queues
@@ -449,6 +470,9 @@ typedef void (*_mali_osk_timer_callback_t)(void * arg );
 
 /** @brief Private type for Timer Callback Objects */
 typedef struct _mali_osk_timer_t_struct _mali_osk_timer_t;
+
+/** @brief Private type for High Resolution Timer Callback Objects */
+typedef struct _mali_osk_hrtimer_t_struct _mali_osk_hrtimer_t;
 /** @} */ /* end group _mali_osk_timer */
 
 
@@ -565,6 +589,26 @@ typedef struct _mali_osk_list_s
              ptr = tmp, tmp = _MALI_OSK_LIST_ENTRY(tmp->member.next, type, member))
 /** @} */ /* end group _mali_osk_list */
 
+/** @addtogroup _mali_osk_rbtree OSK Red-Black Trees
+ * @{ */
+
+/** @brief Red-black trees, provided by mali_osk_specific.h
+ *
+ * _mali_osk_rbtree_t is a tree and _mali_osk_rbtree_node_t a node, embedded in
+ * the structure kept in the tree. The tree is not sorted by the OSK: to insert
+ * a node, descend from _mali_osk_rbtree_root() through _mali_osk_rbtree_left()
+ * and _mali_osk_rbtree_right() to the empty link where the node belongs, then
+ * hand the link and its parent to _mali_osk_rbtree_insert(). Nodes are removed
+ * with _mali_osk_rbtree_erase(), and visited in order with
+ * _mali_osk_rbtree_first(), _mali_osk_rbtree_next() and _mali_osk_rbtree_prev().
+ * Use _MALI_OSK_CONTAINER_OF() to get from a node to its structure.
+ *
+ * Trees must be initialized with _mali_osk_rbtree_init(), and need locking by
+ * the caller.
+ */
+
+/** @} */ /* end group _mali_osk_rbtree */
+
 
 /** @addtogroup _mali_osk_miscellaneous
  * @{ */
@@ -1030,6 +1074,18 @@ void _mali_osk_lock_signal( _mali_osk_lock_t *lock, _mali_osk_lock_mode_t mode )
  * @param lock the lock to terminate.
  */
 void _mali_osk_lock_term( _mali_osk_lock_t *lock );
+
+/** @brief Try to wait for a lock without blocking
+ *
+ * As _mali_osk_lock_wait(), but returns immediately if the lock is not
+ * available.
+ *
+ * @param lock the lock to obtain.
+ * @param mode the mode in which the lock should be obtained.
+ * @return _MALI_OSK_ERR_OK if the lock was obtained, _MALI_OSK_ERR_BUSY
+ * otherwise.
+ */
+_mali_osk_errcode_t _mali_osk_lock_trywait( _mali_osk_lock_t *lock, _mali_osk_lock_mode_t mode);
 /** @} */ /* end group _mali_osk_lock */
 
 
@@ -1206,6 +1262,35 @@ u32 _mali_osk_mem_ioread32( volatile mali_io_address mapping, u32 offset );
  */
 void _mali_osk_mem_iowrite32_relaxed( volatile mali_io_address addr, u32 offset, u32 val );
 
+/** @brief Write a run of 32-bit words to memory allocated through
+ * _mali_osk_mem_allocioregion without memory barriers
+ *
+ * Writes \a count words, the first being \a val and each following one
+ * \a step larger. The words are written with plain stores, so this must not
+ * be used on memory mapped in through _mali_osk_mem_mapioregion().
+ *
+ * @param mapping Mali IO address to write to
+ * @param offset Byte offset of the first word, must be a multiple of 4
+ * @param val the first 32-bit word to write
+ * @param step the difference between consecutive words
+ * @param count the number of words to write
+ */
+void _mali_osk_mem_iowrite32_relaxed_run( volatile mali_io_address addr, u32 offset, u32 val, u32 step, u32 count );
+
+/** @brief Write an array of 32-bit words to memory allocated through
+ * _mali_osk_mem_allocioregion without memory barriers
+ *
+ * Writes vals[i] | bits for each of the \a count words. The same restrictions
+ * as for _mali_osk_mem_iowrite32_relaxed_run() apply.
+ *
+ * @param mapping Mali IO address to write to
+ * @param offset Byte offset of the first word, must be a multiple of 4
+ * @param vals the words to write
+ * @param bits bits to set in each word written
+ * @param count the number of words to write
+ */
+void _mali_osk_mem_iowrite32_relaxed_array( volatile mali_io_address addr, u32 offset, const u32 *vals, u32 bits, u32 count );
+
 /** @brief Write to a location currently mapped in through
  * _mali_osk_mem_mapioregion with write memory barrier
  *
@@ -1238,6 +1323,26 @@ void _mali_osk_cache_flushall( void );
  */
 void _mali_osk_cache_ensure_uncached_range_flushed( void *uncached_mapping, u32 offset, u32 size );
 
+/** @brief Register a memory shrinker
+ *
+ * Lets the OS reclaim memory the driver keeps cached when the system is
+ * short of memory, see 
+ef _mali_osk_shrinker_callback_t.
+ *
+ * @param callback Function called to free memory
+ * @param data Data to pass to  callback
+ * @return The shrinker object on success, NULL on failure.
+ */
+_mali_osk_shrinker_t *_mali_osk_shrinker_register( _mali_osk_shrinker_callback_t callback, void *data );
+
+/** @brief Unregister a memory shrinker
+ *
+ * The callback is not running and will not be called after this returns.
+ *
+ * @param shrinker The shrinker to unregister, as returned by _mali_osk_shrinker_register()
+ */
+void _mali_osk_shrinker_unregister( _mali_osk_shrinker_t *shrinker );
+
 /** @} */ /* end group _mali_osk_low_level_memory */
 
 
@@ -1544,6 +1649,55 @@ void _mali_osk_timer_setcallback( _mali_osk_timer_t *tim, _mali_osk_timer_callba
  * @param tim the timer to deallocate.
  */
 void _mali_osk_timer_term( _mali_osk_timer_t *tim );
+
+/** @brief Initialize a high resolution timer
+ *
+ * Allocates resources for a new high resolution timer, and initializes them.
+ * This does not start the timer. Unlike the tick based timers, the expiry
+ * time of a high resolution timer is given in nanoseconds, and the callback
+ * is always executed in IRQ context.
+ *
+ * @return a pointer to the allocated timer object, or NULL on failure.
+ */
+_mali_osk_hrtimer_t *_mali_osk_hrtimer_init(void);
+
+/** @brief Start or restart a high resolution timer
+ *
+ * It is an error to start a timer without setting the callback via
+ * _mali_osk_hrtimer_setcallback(). If the timer is already started, the
+ * expiry time is updated. It is legal to call this from the timer callback.
+ *
+ * @param tim the timer to start
+ * @param ns_to_expire the time in nanoseconds, relative to now, at which the
+ * timer expires
+ */
+void _mali_osk_hrtimer_start( _mali_osk_hrtimer_t *tim, u64 ns_to_expire );
+
+/** @brief Stop a high resolution timer, and block on its completion.
+ *
+ * Same restrictions as for _mali_osk_timer_del() apply.
+ *
+ * @param tim the timer to stop.
+ */
+void _mali_osk_hrtimer_cancel( _mali_osk_hrtimer_t *tim );
+
+/** @brief Set a high resolution timer's callback parameters.
+ *
+ * This must be called at least once before a timer is started.
+ *
+ * @param tim the timer to set callback on.
+ * @param callback Function to call when timer expires
+ * @param data Function-specific data to supply to the function on expiry.
+ */
+void _mali_osk_hrtimer_setcallback( _mali_osk_hrtimer_t *tim, _mali_osk_timer_callback_t callback, void *data );
+
+/** @brief Terminate a high resolution timer, and deallocate resources.
+ *
+ * The timer must first be stopped by calling _mali_osk_hrtimer_cancel().
+ *
+ * @param tim the timer to deallocate.
+ */
+void _mali_osk_hrtimer_term( _mali_osk_hrtimer_t *tim );
 /** @} */ /* end group _mali_osk_timer */
 
 
@@ -1622,6 +1776,16 @@ void _mali_osk_time_ubusydelay( u32 usecs );
  */
 u64 _mali_osk_time_get_ns( void );
 
+/** @brief Return time in nano seconds from a clock that never jumps.
+ *
+ * Unlike \ref _mali_osk_time_get_ns, the returned time is not affected by
+ * changes to the system time, so it is suitable for measuring durations and
+ * for deadlines used together with \ref _mali_osk_hrtimer_t.
+ *
+ * @return Time in nano seconds
+ */
+u64 _mali_osk_time_get_monotonic_ns( void );
+
 
 /** @} */ /* end group _mali_osk_time */
 
@@ -207,6 +207,33 @@ void _mali_osk_mem_mapregion_term( mali_memory_allocation * descriptor );
  */
 _mali_osk_errcode_t _mali_osk_mem_mapregion_map( mali_memory_allocation * descriptor, u32 offset, u32 *phys_addr, u32 size );
 
+/** @brief Map a number of physical pages into a user process's virtual address range
+ *
+ * This is the bulk version of _mali_osk_mem_mapregion_map(). The pages need not
+ * be physically contiguous, but are mapped at consecutive offsets starting at
+ * \a offset.
+ *
+ * When \a phys_addrs[0] == \ref MALI_MEMORY_ALLOCATION_OS_ALLOCATED_PHYSADDR_MAGIC,
+ * the function will allocate the physical pages itself, and return their
+ * physical addresses through \a phys_addrs. If memory runs out, fewer pages
+ * than requested may be mapped. The number of pages mapped is then returned
+ * through \a num_pages.
+ *
+ * Pages allocated this way are released with _mali_osk_mem_mapregion_unmap(),
+ * exactly as if they had been mapped one by one.
+ *
+ * @param[in,out] descriptor the mali_memory_allocation representing the
+ * user-process's virtual address range to map into.
+ * @param[in] offset the offset into the virtual address range of the first
+ * page. It must be a multiple of \ref _MALI_OSK_CPU_PAGE_SIZE.
+ * @param[in,out] phys_addrs array of \a *num_pages physical page addresses.
+ * @param[in,out] num_pages the number of pages to map, and the number of pages
+ * mapped on return.
+ * @return _MALI_OSK_ERR_OK on sucess, _MALI_OSK_ERR_NOMEM if no page could be
+ * allocated, otherwise a _mali_osk_errcode_t value on failure
+ */
+_mali_osk_errcode_t _mali_osk_mem_mapregion_map_pages( mali_memory_allocation * descriptor, u32 offset, u32 *phys_addrs, u32 *num_pages );
+
 
 /** @brief Unmap physical pages from a user process's virtual address range
  *
@@ -246,10 +273,82 @@ _mali_osk_errcode_t _mali_osk_mem_mapregion_map( mali_memory_allocation * descri
  *
  * @param[in] flags specifies how the memory should be unmapped. For a range
  * of pages that were originally OS allocated, this must have
- * \ref _MALI_OSK_MEM_MAPREGION_FLAG_OS_ALLOCATED_PHYSADDR set.
+ * \ref _MALI_OSK_MEM_MAPREGION_FLAG_OS_ALLOCATED_PHYSADDR set. When the pages
+ * are decommitted from a sparse allocation which stays mapped, it must also
+ * have \ref _MALI_OSK_MEM_MAPREGION_FLAG_DECOMMIT set.
  */
 void _mali_osk_mem_mapregion_unmap( mali_memory_allocation * descriptor, u32 offset, u32 size, _mali_osk_mem_mapregion_flags_t flags );
 
+/** @brief Try to lock a user-process's virtual address range against CPU page faults and unmapping
+ *
+ * Pages may only be decommitted from a range mapped into a user process while
+ * the process can not fault them in. Calls made on behalf of the process do
+ * this in the ioctl wrapper. Code running on behalf of someone else, such as a
+ * shrinker, uses this function instead. It never waits, and fails if the
+ * process is exiting.
+ *
+ * @param[in] descriptor the mali_memory_allocation representing the
+ * user-process's virtual address range.
+ *
+ * @param[out] owner set to the locked address space, to be passed to
+ * _mali_osk_mem_mapregion_unlock(). NULL if the range is not mapped into a
+ * user process, which then needs no locking.
+ *
+ * @return _MALI_OSK_ERR_OK if the range is locked, _MALI_OSK_ERR_BUSY otherwise
+ */
+_mali_osk_errcode_t _mali_osk_mem_mapregion_trylock( mali_memory_allocation * descriptor, void **owner );
+
+/** @brief Unlock an address space locked by _mali_osk_mem_mapregion_trylock()
+ *
+ * This can tear down the address space if the process exited meanwhile, so
+ * it must be called without any Mali locks held.
+ *
+ * @param[in] owner as returned by _mali_osk_mem_mapregion_trylock(), may be NULL
+ */
+void _mali_osk_mem_mapregion_unlock( void *owner );
+
+/** @brief Move the OS allocated pages of one mapped range over to another
+ *
+ * Used to reuse the memory of a freed allocation for a new allocation of the
+ * same size. Both ranges must have been set up by _mali_osk_mem_mapregion_init(),
+ * and all pages of \a from must be OS allocated. The pages are mapped into the
+ * process through \a to afterwards, and are released when \a to is unmapped.
+ * Nothing is moved on failure.
+ *
+ * @param[in,out] to the mali_memory_allocation to move the pages to, which
+ * must not have any pages yet.
+ *
+ * @param[in,out] from the mali_memory_allocation to take the pages from, which
+ * must no longer be mapped into the process.
+ *
+ * @param[out] phys_addrs the CPU physical address of the page at each page
+ * offset is written here.
+ *
+ * @return _MALI_OSK_ERR_OK on success, _MALI_OSK_ERR_UNSUPPORTED if the pages
+ * can not be moved.
+ */
+_mali_osk_errcode_t _mali_osk_mem_mapregion_move( mali_memory_allocation * to, mali_memory_allocation * from, u32 *phys_addrs );
+
+/** @brief Keep the CPU caches coherent with the GPU for part of a mapped range
+ *
+ * Only ranges mapped with MALI_MEMORY_ALLOCATION_FLAG_CPU_CACHED need cache
+ * maintenance, for other ranges only the CPU writes are ordered. Offsets
+ * without OS allocated pages are skipped. Pinned process memory, flagged
+ * MALI_MEMORY_ALLOCATION_FLAG_USER_MEMORY, is always cached for the CPU.
+ *
+ * @param[in] descriptor the mali_memory_allocation set up by _mali_osk_mem_mapregion_init(),
+ * or pinned process memory
+ *
+ * @param[in] offset the offset into the range, a multiple of the CPU page size
+ *
+ * @param[in] size the number of bytes to sync, a multiple of the CPU page size
+ *
+ * @param[in] to_device MALI_TRUE to write CPU writes back to memory before the
+ * GPU reads it, MALI_FALSE to discard the cached data before the CPU reads
+ * what the GPU wrote.
+ */
+void _mali_osk_mem_mapregion_sync( mali_memory_allocation * descriptor, u32 offset, u32 size, mali_bool to_device );
+
 /** @brief Copy as much data as possible from src to dest, do not crash if src or dest isn't available.
  *
  * @param dest Destination buffer (limited to user space mapped Mali memory)
@@ -311,7 +311,7 @@ _mali_osk_errcode_t mali_pp_reset(struct mali_pp_core *core)
 	return mali_pp_reset_wait(core);
 }
 
-void mali_pp_job_start(struct mali_pp_core *core, struct mali_pp_job *job, u32 sub_job, mali_bool restart_virtual)
+void mali_pp_job_prepare(struct mali_pp_core *core, struct mali_pp_job *job, u32 sub_job, mali_bool restart_virtual)
 {
 	u32 relative_address;
 	u32 start_index;
@@ -395,10 +395,17 @@ void mali_pp_job_start(struct mali_pp_core *core, struct mali_pp_job *job, u32 s
 		mali_hw_core_register_write_relaxed_conditional(&core->hw_core, MALI200_REG_ADDR_MGMT_PERF_CNT_1_ENABLE, MALI200_REG_VAL_PERF_CNT_ENABLE, mali_perf_cnt_enable_reset_value);
 	}
 
-	MALI_DEBUG_PRINT(3, ("Mali PP: Starting job 0x%08X part %u/%u on PP core %s\n", job, sub_job + 1, mali_pp_job_get_sub_job_count(job), core->hw_core.description));
+	MALI_DEBUG_PRINT(3, ("Mali PP: Prepared job 0x%08X part %u/%u on PP core %s\n", job, sub_job + 1, mali_pp_job_get_sub_job_count(job), core->hw_core.description));
 
 	/* Adding barrier to make sure all rester writes are finished */
 	_mali_osk_write_mem_barrier();
+}
+
+void mali_pp_job_start_rendering(struct mali_pp_core *core)
+{
+	MALI_DEBUG_ASSERT_POINTER(core);
+
+	MALI_DEBUG_PRINT(3, ("Mali PP: Starting rendering on PP core %s\n", core->hw_core.description));
 
 	/* This is the command that starts the core. */
 	mali_hw_core_register_write_relaxed(&core->hw_core, MALI200_REG_ADDR_MGMT_CTRL_MGMT, MALI200_REG_VAL_CTRL_MGMT_START_RENDERING);
@@ -407,6 +414,12 @@ void mali_pp_job_start(struct mali_pp_core *core, struct mali_pp_job *job, u32 s
 	_mali_osk_write_mem_barrier();
 }
 
+void mali_pp_job_start(struct mali_pp_core *core, struct mali_pp_job *job, u32 sub_job, mali_bool restart_virtual)
+{
+	mali_pp_job_prepare(core, job, sub_job, restart_virtual);
+	mali_pp_job_start_rendering(core);
+}
+
 u32 mali_pp_core_get_version(struct mali_pp_core *core)
 {
 	MALI_DEBUG_ASSERT_POINTER(core);
@@ -46,6 +46,12 @@ _mali_osk_errcode_t mali_pp_reset_wait(struct mali_pp_core *core);
 _mali_osk_errcode_t mali_pp_reset(struct mali_pp_core *core);
 _mali_osk_errcode_t mali_pp_hard_reset(struct mali_pp_core *core);
 
+/**
+ * Write all registers needed by a (sub) job, but do not start the core.
+ * Must be followed by mali_pp_job_start_rendering() on the same core.
+ */
+void mali_pp_job_prepare(struct mali_pp_core *core, struct mali_pp_job *job, u32 sub_job, mali_bool restart_virtual);
+void mali_pp_job_start_rendering(struct mali_pp_core *core);
 void mali_pp_job_start(struct mali_pp_core *core, struct mali_pp_job *job, u32 sub_job, mali_bool restart_virtual);
 
 u32 mali_pp_core_get_version(struct mali_pp_core *core);
@@ -118,6 +124,12 @@ MALI_STATIC_INLINE void mali_pp_enable_interrupts(struct mali_pp_core *core)
 	mali_hw_core_register_write(&core->hw_core, MALI200_REG_ADDR_MGMT_INT_MASK, MALI200_REG_VAL_IRQ_MASK_USED);
 }
 
+MALI_STATIC_INLINE void mali_pp_enable_interrupts_for_polling(struct mali_pp_core *core)
+{
+	/* Completion is polled for, only errors will raise an interrupt */
+	mali_hw_core_register_write(&core->hw_core, MALI200_REG_ADDR_MGMT_INT_MASK, MALI200_REG_VAL_IRQ_MASK_USED & ~MALI200_REG_VAL_IRQ_END_OF_FRAME);
+}
+
 MALI_STATIC_INLINE void mali_pp_write_addr_stack(struct mali_pp_core *core, struct mali_pp_job *job)
 {
 	u32 addr = mali_pp_job_get_addr_stack(job, core->core_id);
@@ -22,6 +22,7 @@ struct mali_pp_job *mali_pp_job_create(struct mali_session_data *session, _mali_
 {
 	struct mali_pp_job *job;
 	u32 perf_counter_flag;
+	u32 i;
 
 	job = _mali_osk_calloc(1, sizeof(struct mali_pp_job));
 	if (NULL != job)
@@ -56,10 +57,18 @@ struct mali_pp_job *mali_pp_job_create(struct mali_session_data *session, _mali_
 
 		_mali_osk_list_init(&job->list);
 		job->session = session;
+		job->session_generation = mali_session_job_begin(session);
 		_mali_osk_list_init(&job->session_list);
 		job->id = id;
 
 		job->sub_jobs_num = job->uargs.num_cores ? job->uargs.num_cores : 1;
+
+		/* Start sub jobs in ascending order until the scheduler knows better */
+		for (i = 0; i < job->sub_jobs_num; i++)
+		{
+			job->sub_job_order[i] = i;
+		}
+
 		job->pid = _mali_osk_get_pid();
 		job->tid = _mali_osk_get_tid();
 
@@ -141,6 +150,12 @@ void mali_pp_job_delete(struct mali_pp_job *job)
 	_mali_osk_free(job->dma_bufs);
 #endif /* CONFIG_DMA_SHARED_BUFFER */
 
+	/* A job which failed creation early was never counted */
+	if (NULL != job->session)
+	{
+		mali_session_job_end(job->session, job->session_generation);
+	}
+
 	_mali_osk_free(job);
 }
 
@@ -38,10 +38,14 @@ struct mali_pp_job
 	_mali_osk_list_t session_list;                     /**< Used to link jobs together in the session job list */
 	_mali_uk_pp_start_job_s uargs;                     /**< Arguments from user space */
 	u32 id;                                            /**< Identifier for this job in kernel space (sequential numbering) */
+	u32 session_generation;                            /**< Job generation of the session the job is counted in */
+	u64 timeout;                                       /**< Watchdog timeout (in ns), sampled by the PP scheduler when a sub job is dequeued */
 	u32 perf_counter_value0[_MALI_PP_MAX_SUB_JOBS];    /**< Value of performance counter 0 (to be returned to user space), one for each sub job */
 	u32 perf_counter_value1[_MALI_PP_MAX_SUB_JOBS];    /**< Value of performance counter 1 (to be returned to user space), one for each sub job */
 	u32 sub_jobs_num;                                  /**< Number of subjobs; set to 1 for Mali-450 if DLBU is used, otherwise equals number of PP cores */
-	u32 sub_jobs_started;                              /**< Total number of sub-jobs started (always started in ascending order) */
+	u32 sub_jobs_started;                              /**< Total number of sub-jobs started (started in the order given by sub_job_order) */
+	u32 sub_job_order[_MALI_PP_MAX_SUB_JOBS];          /**< Order in which the sub jobs are started, longest first when runtime history is available */
+	u32 sub_job_runtime[_MALI_PP_MAX_SUB_JOBS];        /**< Measured runtime of each sub job, in units of 1024 ns (0 if unknown) */
 	u32 sub_jobs_completed;                            /**< Number of completed sub-jobs in this superjob */
 	u32 sub_job_errors;                                /**< Bitfield with errors (errors for each single sub-job is or'ed together) */
 	u32 pid;                                           /**< Process ID of submitting process */
@@ -74,6 +78,11 @@ MALI_STATIC_INLINE u32 mali_pp_job_get_id(struct mali_pp_job *job)
 	return (NULL == job) ? 0 : job->id;
 }
 
+MALI_STATIC_INLINE u64 mali_pp_job_get_timeout(struct mali_pp_job *job)
+{
+	return job->timeout;
+}
+
 MALI_STATIC_INLINE u32 mali_pp_job_get_user_id(struct mali_pp_job *job)
 {
 	return job->uargs.user_job_ptr;
@@ -202,10 +211,26 @@ MALI_STATIC_INLINE mali_bool mali_pp_job_is_complete(struct mali_pp_job *job)
 }
 
 MALI_STATIC_INLINE u32 mali_pp_job_get_first_unstarted_sub_job(struct mali_pp_job *job)
+{
+	MALI_DEBUG_ASSERT(job->sub_jobs_started < job->sub_jobs_num);
+	return job->sub_job_order[job->sub_jobs_started];
+}
+
+MALI_STATIC_INLINE u32 mali_pp_job_get_num_started_sub_jobs(struct mali_pp_job *job)
 {
 	return job->sub_jobs_started;
 }
 
+MALI_STATIC_INLINE void mali_pp_job_set_sub_job_runtime(struct mali_pp_job *job, u32 sub_job, u32 runtime)
+{
+	job->sub_job_runtime[sub_job] = runtime;
+}
+
+MALI_STATIC_INLINE u32 mali_pp_job_get_sub_job_runtime(struct mali_pp_job *job, u32 sub_job)
+{
+	return job->sub_job_runtime[sub_job];
+}
+
 MALI_STATIC_INLINE u32 mali_pp_job_get_sub_job_count(struct mali_pp_job *job)
 {
 	return job->sub_jobs_num;
@@ -214,7 +239,8 @@ MALI_STATIC_INLINE u32 mali_pp_job_get_sub_job_count(struct mali_pp_job *job)
 MALI_STATIC_INLINE void mali_pp_job_mark_sub_job_started(struct mali_pp_job *job, u32 sub_job)
 {
 	/* Assert that we are marking the "first unstarted sub job" as started */
-	MALI_DEBUG_ASSERT(job->sub_jobs_started == sub_job);
+	MALI_DEBUG_ASSERT(job->sub_job_order[job->sub_jobs_started] == sub_job);
+	MALI_IGNORE(sub_job);
 
 	job->sub_jobs_started++;
 }
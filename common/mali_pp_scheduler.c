@@ -13,6 +13,7 @@
 #include "mali_kernel_core.h"
 #include "mali_osk.h"
 #include "mali_osk_list.h"
+#include "mali_osk_profiling.h"
 #include "mali_scheduler.h"
 #include "mali_pp.h"
 #include "mali_pp_job.h"
@@ -41,6 +42,11 @@
 /* Maximum of 8 PP cores (a group can only have maximum of 1 PP core) */
 #define MALI_MAX_NUMBER_OF_PP_GROUPS 9
 
+#if MALI_PP_SCHEDULER_LONGEST_SUB_JOB_FIRST
+/* Number of frame builders we keep sub job runtime history for (must be a power of two) */
+#define MALI_PP_SCHEDULER_SUB_JOB_HISTORY_SIZE 16
+#endif
+
 static mali_bool mali_pp_scheduler_is_suspended(void);
 static void mali_pp_scheduler_do_schedule(void *arg);
 #if defined(MALI_PP_SCHEDULER_USE_DEFERRED_JOB_DELETE)
@@ -96,6 +102,24 @@ static _mali_osk_lock_t *pp_scheduler_job_delete_lock = NULL;
 static _MALI_OSK_LIST_HEAD_STATIC_INIT(pp_scheduler_job_deletion_queue);
 #endif
 
+#if MALI_PP_SCHEDULER_LONGEST_SUB_JOB_FIRST
+/*
+ * Runtime history of the sub jobs of multi core jobs, per frame builder.
+ * Used to start the historically longest running sub jobs first, which reduces
+ * the time until the last sub job (and thereby the whole job) completes.
+ * Protected by the PP scheduler lock.
+ */
+struct mali_pp_scheduler_sub_job_history
+{
+	struct mali_session_data *session;             /**< Session owning the frame builder, NULL for unused entries */
+	u32 frame_builder_id;                          /**< Frame builder the runtimes belong to */
+	u32 sub_jobs_num;                              /**< Number of sub jobs the runtimes were measured for */
+	u32 runtime[_MALI_PP_MAX_SUB_JOBS];            /**< Averaged runtime of each sub job, in units of 1024 ns */
+};
+
+static struct mali_pp_scheduler_sub_job_history sub_job_history[MALI_PP_SCHEDULER_SUB_JOB_HISTORY_SIZE];
+#endif
+
 MALI_STATIC_INLINE mali_bool mali_pp_scheduler_has_virtual_group(void)
 {
 	return NULL != virtual_group;
@@ -305,6 +329,50 @@ MALI_STATIC_INLINE void mali_pp_scheduler_assert_locked(void)
 #define MALI_ASSERT_PP_SCHEDULER_LOCKED()
 #endif
 
+/**
+ * Returns the first job in the queue from a session which has not used up its PP quota.
+ * A job waiting for a barrier holds back every job queued after it, the same as without a quota,
+ * so only the jobs ahead of it are considered. Jobs from over quota sessions are only deferred
+ * if another session has a job ahead of the barrier, else the first job is returned.
+ * Since all the jobs from a session are skipped, the order within a session is kept.
+ * Returns NULL if the first job waits for a barrier.
+ */
+MALI_STATIC_INLINE struct mali_pp_job *mali_pp_scheduler_get_job_within_quota(_mali_osk_list_t *queue)
+{
+	struct mali_pp_job *job, *tmp;
+	struct mali_pp_job *first;
+
+	MALI_ASSERT_PP_SCHEDULER_LOCKED();
+	MALI_DEBUG_ASSERT(!_mali_osk_list_empty(queue));
+
+	first = _MALI_OSK_LIST_ENTRY(queue->next, struct mali_pp_job, list);
+	if (mali_pp_job_has_active_barrier(first))
+	{
+		return NULL;
+	}
+
+	if (0 >= mali_session_pp_quota_ms)
+	{
+		/* No quota, the head of the queue runs first */
+		return first;
+	}
+
+	_MALI_OSK_LIST_FOREACHENTRY(job, tmp, queue, struct mali_pp_job, list)
+	{
+		if (mali_pp_job_has_active_barrier(job))
+		{
+			break;
+		}
+
+		if (job->session->is_compositor || !mali_session_gpu_time_over_quota(&job->session->pp_time, mali_session_pp_quota_ms))
+		{
+			return job;
+		}
+	}
+
+	return first;
+}
+
 /**
  * Returns a physical job if a physical job is ready to run (no barrier present)
  */
@@ -332,10 +400,7 @@ MALI_STATIC_INLINE struct mali_pp_job *mali_pp_scheduler_get_physical_job(void)
 			}
 		}
 
-		if (!mali_pp_job_has_active_barrier(job))
-		{
-			return job;
-		}
+		return mali_pp_scheduler_get_job_within_quota(&job_queue);
 	}
 
 	return NULL;
@@ -346,6 +411,9 @@ MALI_STATIC_INLINE void mali_pp_scheduler_dequeue_physical_job(struct mali_pp_jo
 	MALI_ASSERT_PP_SCHEDULER_LOCKED();
 	MALI_DEBUG_ASSERT(job_queue_depth > 0);
 
+	/* The session's PP time is only stable under the scheduler lock */
+	job->timeout = mali_session_get_job_timeout(&mali_pp_job_get_session(job)->pp_time);
+
 	/* Remove job from queue */
 	if (!mali_pp_job_has_unstarted_sub_jobs(job))
 	{
@@ -384,10 +452,7 @@ MALI_STATIC_INLINE struct mali_pp_job *mali_pp_scheduler_get_virtual_job(void)
 			}
 		}
 
-		if (!mali_pp_job_has_active_barrier(job))
-		{
-			return job;
-		}
+		return mali_pp_scheduler_get_job_within_quota(&virtual_job_queue);
 	}
 
 	return NULL;
@@ -398,6 +463,9 @@ MALI_STATIC_INLINE void mali_pp_scheduler_dequeue_virtual_job(struct mali_pp_job
 	MALI_ASSERT_PP_SCHEDULER_LOCKED();
 	MALI_DEBUG_ASSERT(virtual_job_queue_depth > 0);
 
+	/* The session's PP time is only stable under the scheduler lock */
+	job->timeout = mali_session_get_job_timeout(&mali_pp_job_get_session(job)->pp_time);
+
 	/* Remove job from queue */
 	_mali_osk_list_delinit(&job->list);
 	--virtual_job_queue_depth;
@@ -467,6 +535,123 @@ MALI_STATIC_INLINE struct mali_group *mali_pp_scheduler_acquire_physical_group(v
 	return NULL;
 }
 
+#if MALI_PP_SCHEDULER_LONGEST_SUB_JOB_FIRST
+MALI_STATIC_INLINE struct mali_pp_scheduler_sub_job_history *mali_pp_scheduler_get_sub_job_history(struct mali_pp_job *job)
+{
+	u32 index;
+
+	index = (mali_pp_job_get_frame_builder_id(job) ^ ((u32)(unsigned long)mali_pp_job_get_session(job) >> 6));
+
+	return &sub_job_history[index & (MALI_PP_SCHEDULER_SUB_JOB_HISTORY_SIZE - 1)];
+}
+
+/**
+ * Order the sub jobs of a physical job so that the sub jobs which historically
+ * ran the longest for this frame builder are started first.
+ * Must be called before any sub job of \a job is started.
+ */
+static void mali_pp_scheduler_order_sub_jobs(struct mali_pp_job *job)
+{
+	struct mali_pp_scheduler_sub_job_history *history;
+	u32 sub_jobs_num;
+	u32 i;
+
+	MALI_ASSERT_PP_SCHEDULER_LOCKED();
+	MALI_DEBUG_ASSERT(0 == mali_pp_job_get_num_started_sub_jobs(job));
+
+	sub_jobs_num = mali_pp_job_get_sub_job_count(job);
+	if (2 > sub_jobs_num)
+	{
+		return;
+	}
+
+	history = mali_pp_scheduler_get_sub_job_history(job);
+	if (history->session != mali_pp_job_get_session(job) ||
+	    history->frame_builder_id != mali_pp_job_get_frame_builder_id(job) ||
+	    history->sub_jobs_num != sub_jobs_num)
+	{
+		/* No history for this frame builder, keep the ascending order */
+		return;
+	}
+
+	/* Insertion sort, longest first. Sub jobs with equal runtime keep ascending order. */
+	for (i = 1; i < sub_jobs_num; i++)
+	{
+		u32 sub_job = job->sub_job_order[i];
+		s32 j = i - 1;
+
+		while (j >= 0 && history->runtime[job->sub_job_order[j]] < history->runtime[sub_job])
+		{
+			job->sub_job_order[j + 1] = job->sub_job_order[j];
+			j--;
+		}
+
+		job->sub_job_order[j + 1] = sub_job;
+	}
+
+	MALI_DEBUG_PRINT(4, ("Mali PP scheduler: Job %u (0x%08X) starts with sub job %u based on runtime history\n",
+	                     mali_pp_job_get_id(job), job, job->sub_job_order[0]));
+}
+
+/**
+ * Fold the measured sub job runtimes of a successfully completed physical job
+ * into the runtime history of its frame builder.
+ */
+static void mali_pp_scheduler_update_sub_job_history(struct mali_pp_job *job)
+{
+	struct mali_pp_scheduler_sub_job_history *history;
+	u32 sub_jobs_num;
+	u32 i;
+
+	MALI_ASSERT_PP_SCHEDULER_LOCKED();
+
+	sub_jobs_num = mali_pp_job_get_sub_job_count(job);
+	if (mali_pp_job_is_virtual(job) || 2 > sub_jobs_num)
+	{
+		return;
+	}
+
+	history = mali_pp_scheduler_get_sub_job_history(job);
+	if (history->session != mali_pp_job_get_session(job) ||
+	    history->frame_builder_id != mali_pp_job_get_frame_builder_id(job) ||
+	    history->sub_jobs_num != sub_jobs_num)
+	{
+		/* (Re)claim the entry for this frame builder */
+		history->session = mali_pp_job_get_session(job);
+		history->frame_builder_id = mali_pp_job_get_frame_builder_id(job);
+		history->sub_jobs_num = sub_jobs_num;
+
+		for (i = 0; i < sub_jobs_num; i++)
+		{
+			history->runtime[i] = mali_pp_job_get_sub_job_runtime(job, i);
+		}
+
+		return;
+	}
+
+	/* Exponential moving average, new samples weighted 1/4 */
+	for (i = 0; i < sub_jobs_num; i++)
+	{
+		history->runtime[i] = history->runtime[i] - (history->runtime[i] >> 2) + (mali_pp_job_get_sub_job_runtime(job, i) >> 2);
+	}
+}
+
+static void mali_pp_scheduler_forget_sub_job_history(struct mali_session_data *session)
+{
+	u32 i;
+
+	MALI_ASSERT_PP_SCHEDULER_LOCKED();
+
+	for (i = 0; i < MALI_PP_SCHEDULER_SUB_JOB_HISTORY_SIZE; i++)
+	{
+		if (sub_job_history[i].session == session)
+		{
+			sub_job_history[i].session = NULL;
+		}
+	}
+}
+#endif /* MALI_PP_SCHEDULER_LONGEST_SUB_JOB_FIRST */
+
 void mali_pp_scheduler_schedule(void)
 {
 	struct mali_group* physical_groups_to_start[MALI_MAX_NUMBER_OF_PP_GROUPS-1];
@@ -610,6 +795,11 @@ void mali_pp_scheduler_schedule(void)
 	 * may take quite a bit of time (quite many registers needs to be written). This will allow new jobs
 	 * from user space to come in, and post processing of other PP jobs to happen at the same time as we
 	 * start jobs.
+	 *
+	 * The start is done in two phases, so that the sub jobs of a job start as close together as possible:
+	 * first L2, page directory and all registers are staged on every group, then all the cores are
+	 * started back-to-back. Each group is only locked while it is staged and while it is started, the
+	 * group locks may be spinlocks taken with interrupts off, so they are not held across all the cores.
 	 */
 	for (i = 0; i < num_physical_jobs_to_start; i++)
 	{
@@ -625,12 +815,42 @@ void mali_pp_scheduler_schedule(void)
 		/* In case this group was acquired from a virtual core, update it's state to IDLE */
 		group->state = MALI_GROUP_STATE_IDLE;
 
-		mali_group_start_pp_job(group, job, sub_job);
-		MALI_DEBUG_PRINT(4, ("Mali PP scheduler: Physical job %u (0x%08X) part %u/%u started (from schedule)\n",
-		                     mali_pp_job_get_id(job), job, sub_job + 1,
-		                     mali_pp_job_get_sub_job_count(job)));
+		mali_group_prepare_pp_job(group, job, sub_job);
 
 		mali_group_unlock(group);
+	}
+
+	if (0 < num_physical_jobs_to_start)
+	{
+		u64 first_start_time = _mali_osk_time_get_monotonic_ns();
+		u64 start_skew;
+
+		for (i = 0; i < num_physical_jobs_to_start; i++)
+		{
+			struct mali_group *group = physical_groups_to_start[i];
+
+			mali_group_lock(group);
+			mali_group_commit_pp_job(group);
+			mali_group_unlock(group);
+		}
+
+		start_skew = _mali_osk_time_get_monotonic_ns() - first_start_time;
+
+		if (1 < num_physical_jobs_to_start)
+		{
+			/* Report the time from the first to the last core was started */
+			_mali_osk_profiling_add_event(MALI_PROFILING_EVENT_TYPE_SINGLE |
+			                              MALI_PROFILING_EVENT_CHANNEL_SOFTWARE |
+			                              MALI_PROFILING_EVENT_REASON_SINGLE_SW_PP_START_SKEW,
+			                              num_physical_jobs_to_start, (u32)start_skew, 0, 0, 0);
+		}
+	}
+
+	for (i = 0; i < num_physical_jobs_to_start; i++)
+	{
+		MALI_DEBUG_PRINT(4, ("Mali PP scheduler: Physical job %u (0x%08X) part %u/%u started (from schedule)\n",
+		                     mali_pp_job_get_id(physical_jobs_to_start[i]), physical_jobs_to_start[i], physical_subjobs_to_start[i] + 1,
+		                     mali_pp_job_get_sub_job_count(physical_jobs_to_start[i])));
 
 		/* remove the return value from mali_group_start_xx_job, since we can't fail on Mali-300++ */
 	}
@@ -745,6 +965,10 @@ void mali_pp_scheduler_job_done(struct mali_group *group, struct mali_pp_job *jo
 	MALI_ASSERT_GROUP_LOCKED(group);
 	mali_pp_scheduler_lock();
 
+	/* Charge the session for the time the sub job kept the group busy, on each of its cores */
+	mali_session_gpu_time_add(&mali_pp_job_get_session(job)->pp_time, _mali_osk_time_get_monotonic_ns() - group->job_start_time,
+	                          mali_group_get_num_cores(group), success);
+
 	mali_pp_job_mark_sub_job_completed(job, success);
 
 	MALI_DEBUG_ASSERT(mali_pp_job_is_virtual(job) == mali_group_is_virtual(group));
@@ -762,6 +986,13 @@ void mali_pp_scheduler_job_done(struct mali_group *group, struct mali_pp_job *jo
 		MALI_DEBUG_PRINT(4, ("Mali PP scheduler: All parts completed for %s job %u (0x%08X)\n",
 		                     mali_pp_job_is_virtual(job) ? "virtual" : "physical",
 		                     mali_pp_job_get_id(job), job));
+
+#if MALI_PP_SCHEDULER_LONGEST_SUB_JOB_FIRST
+		if (mali_pp_job_was_success(job))
+		{
+			mali_pp_scheduler_update_sub_job_history(job);
+		}
+#endif
 #if defined(CONFIG_SYNC)
 		if (job->sync_point)
 		{
@@ -1064,6 +1295,10 @@ MALI_STATIC_INLINE void mali_pp_scheduler_queue_job(struct mali_pp_job *job, str
 	{
 		job_queue_depth += mali_pp_job_get_sub_job_count(job);
 
+#if MALI_PP_SCHEDULER_LONGEST_SUB_JOB_FIRST
+		mali_pp_scheduler_order_sub_jobs(job);
+#endif
+
 		/* Put compository jobs on front */
 		if(job->session->is_compositor)
 		{
@@ -1420,14 +1655,14 @@ void mali_pp_scheduler_abort_session(struct mali_session_data *session)
 		if (mali_pp_job_is_virtual(job))
 		{
 			MALI_DEBUG_ASSERT(1 == mali_pp_job_get_sub_job_count(job));
-			if (0 == mali_pp_job_get_first_unstarted_sub_job(job))
+			if (0 == mali_pp_job_get_num_started_sub_jobs(job))
 			{
 				--virtual_job_queue_depth;
 			}
 		}
 		else
 		{
-			job_queue_depth -= mali_pp_job_get_sub_job_count(job) - mali_pp_job_get_first_unstarted_sub_job(job);
+			job_queue_depth -= mali_pp_job_get_sub_job_count(job) - mali_pp_job_get_num_started_sub_jobs(job);
 		}
 
 		/* Mark all unstarted jobs as failed */
@@ -1455,6 +1690,11 @@ void mali_pp_scheduler_abort_session(struct mali_session_data *session)
 		}
 	}
 
+#if MALI_PP_SCHEDULER_LONGEST_SUB_JOB_FIRST
+	/* The session pointer may be reused by a new session, so drop its history */
+	mali_pp_scheduler_forget_sub_job_history(session);
+#endif
+
 	_MALI_OSK_LIST_FOREACHENTRY(group, tmp_group, &group_list_working, struct mali_group, pp_scheduler_list)
 	{
 		groups[i++] = group;
@@ -1579,6 +1819,11 @@ void mali_pp_scheduler_reset_all_groups(void)
 }
 
 void mali_pp_scheduler_zap_all_active(struct mali_session_data *session)
+{
+	mali_pp_scheduler_zap_range_all_active(session, 0, 0);
+}
+
+void mali_pp_scheduler_zap_range_all_active(struct mali_session_data *session, u32 mali_address, u32 size)
 {
 	struct mali_group *group, *temp;
 	struct mali_group *groups[MALI_MAX_NUMBER_OF_GROUPS];
@@ -1586,7 +1831,7 @@ void mali_pp_scheduler_zap_all_active(struct mali_session_data *session)
 
 	if (mali_pp_scheduler_has_virtual_group())
 	{
-		mali_group_zap_session(virtual_group, session);
+		mali_group_zap_session_range(virtual_group, session, mali_address, size);
 	}
 
 	mali_pp_scheduler_lock();
@@ -1598,7 +1843,7 @@ void mali_pp_scheduler_zap_all_active(struct mali_session_data *session)
 
 	while (i > 0)
 	{
-		mali_group_zap_session(groups[--i], session);
+		mali_group_zap_session_range(groups[--i], session, mali_address, size);
 	}
 }
 
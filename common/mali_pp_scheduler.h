@@ -62,6 +62,7 @@ void mali_pp_scheduler_reset_all_groups(void);
  * The scheculer will zap the session on all groups it owns.
  */
 void mali_pp_scheduler_zap_all_active(struct mali_session_data *session);
+void mali_pp_scheduler_zap_range_all_active(struct mali_session_data *session, u32 mali_address, u32 size);
 
 int mali_pp_scheduler_get_queue_depth(void);
 u32 mali_pp_scheduler_dump_state(char *buf, u32 size);
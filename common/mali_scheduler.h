@@ -44,4 +44,20 @@ MALI_STATIC_INLINE void mali_scheduler_zap_all_active(struct mali_session_data *
 	mali_pp_scheduler_zap_all_active(session);
 }
 
+/**
+ * @brief Invalidate a range of the TLB on all active groups running \a session
+ *
+ * Cheaper than zapping the whole TLB for small ranges. Only valid when the
+ * page tables covering the range are kept, like after mali_mmu_pagedir_clear().
+ *
+ * @param session Pointer to the session to zap
+ * @param mali_address Start of the range
+ * @param size Size of the range in bytes
+ */
+MALI_STATIC_INLINE void mali_scheduler_zap_range_all_active(struct mali_session_data *session, u32 mali_address, u32 size)
+{
+	mali_gp_scheduler_zap_range_all_active(session, mali_address, size);
+	mali_pp_scheduler_zap_range_all_active(session, mali_address, size);
+}
+
 #endif /* __MALI_SCHEDULER_H__ */
@@ -11,11 +11,21 @@
 #include "mali_osk.h"
 #include "mali_osk_list.h"
 #include "mali_session.h"
+#include "mali_kernel_core.h"
+
+/* A job may run this many times its expected runtime (average plus four deviations) before it is considered hung */
+#define MALI_SESSION_RUNTIME_TIMEOUT_FACTOR 8
 
 _MALI_OSK_LIST_HEAD(mali_sessions);
 
 _mali_osk_lock_t *mali_sessions_lock;
 
+int mali_session_quota_period_ms = 100;
+int mali_session_gp_quota_ms = 0;
+int mali_session_pp_quota_ms = 0;
+
+int mali_adaptive_job_timeout_min_ms = 1000;
+
 _mali_osk_errcode_t mali_session_initialize(void)
 {
 	const _mali_osk_lock_flags_t lock_flags = _MALI_OSK_LOCKFLAG_READERWRITER |
@@ -49,3 +59,166 @@ void mali_session_remove(struct mali_session_data *session)
 	_mali_osk_list_delinit(&session->link);
 	mali_session_unlock();
 }
+
+/*
+ * Jobs are counted per generation, in one of two counters. The generation is
+ * only advanced once the jobs of the generation before the current one are
+ * gone, so the counter of the next generation only holds new jobs.
+ */
+u32 mali_session_job_begin(struct mali_session_data *session)
+{
+	for (;;)
+	{
+		u32 generation = _mali_osk_atomic_read(&session->job_generation);
+
+		/* The returning variant orders the increment before the generation is read again */
+		_mali_osk_atomic_inc_return(&session->num_generation_jobs[generation & 1]);
+
+		/* Counted in the wrong generation if it advanced meanwhile */
+		if (generation == _mali_osk_atomic_read(&session->job_generation))
+		{
+			return generation;
+		}
+
+		_mali_osk_atomic_dec(&session->num_generation_jobs[generation & 1]);
+	}
+}
+
+void mali_session_job_end(struct mali_session_data *session, u32 generation)
+{
+	_mali_osk_atomic_dec(&session->num_generation_jobs[generation & 1]);
+}
+
+mali_bool mali_session_jobs_done(struct mali_session_data *session, u32 generation)
+{
+	u32 latest = _mali_osk_atomic_read(&session->job_generation);
+
+	if (latest == generation)
+	{
+		/* The counter of the generation before is reused for the next one */
+		if (0 != _mali_osk_atomic_read(&session->num_generation_jobs[(generation + 1) & 1]))
+		{
+			return MALI_FALSE;
+		}
+		latest = _mali_osk_atomic_inc_return(&session->job_generation);
+	}
+
+	if (latest - generation == 1)
+	{
+		/* All jobs from before generation are gone, only its own may be left */
+		return (0 == _mali_osk_atomic_read(&session->num_generation_jobs[generation & 1])) ? MALI_TRUE : MALI_FALSE;
+	}
+
+	return MALI_TRUE;
+}
+
+mali_bool mali_session_gpu_time_over_quota(struct mali_session_gpu_time *gpu_time, int quota_ms)
+{
+	u64 now;
+
+	if (0 >= quota_ms || 0 >= mali_session_quota_period_ms)
+	{
+		return MALI_FALSE;
+	}
+
+	now = _mali_osk_time_get_monotonic_ns();
+	if (now - gpu_time->period_start >= (u64)mali_session_quota_period_ms * 1000000ULL)
+	{
+		/* Quota period expired, start a new one */
+		gpu_time->period_start = now;
+		gpu_time->used = 0;
+	}
+
+	return (gpu_time->used >= (u64)quota_ms * 1000000ULL) ? MALI_TRUE : MALI_FALSE;
+}
+
+void mali_session_gpu_time_add(struct mali_session_gpu_time *gpu_time, u64 busy, u32 num_cores, mali_bool success)
+{
+	gpu_time->used += busy * num_cores;
+	gpu_time->total += busy * num_cores;
+
+	if (success)
+	{
+		s32 sample = (busy >> 10) > 0x7FFFFFFF ? 0x7FFFFFFF : (s32)(busy >> 10);
+		s32 error = sample - (s32)gpu_time->runtime_average;
+
+		if (0 == gpu_time->runtime_samples)
+		{
+			gpu_time->runtime_average = sample;
+			gpu_time->runtime_deviation = sample / 2;
+		}
+		else
+		{
+			/* Same smoothing as for round trip times in TCP: gain 1/8 for the average, 1/4 for the deviation */
+			gpu_time->runtime_average = (u32)((s32)gpu_time->runtime_average + error / 8);
+			if (0 > error)
+			{
+				error = -error;
+			}
+			gpu_time->runtime_deviation = (u32)((s32)gpu_time->runtime_deviation + (error - (s32)gpu_time->runtime_deviation) / 4);
+		}
+
+		if (MALI_SESSION_RUNTIME_MIN_SAMPLES > gpu_time->runtime_samples)
+		{
+			gpu_time->runtime_samples++;
+		}
+	}
+	else
+	{
+		/*
+		 * The job may have been killed by a timeout too short for the work it was given,
+		 * so fall back to mali_max_job_runtime until enough runtimes are sampled again.
+		 */
+		gpu_time->runtime_samples = 0;
+	}
+}
+
+u64 mali_session_get_job_timeout(struct mali_session_gpu_time *gpu_time)
+{
+	u64 max_timeout = (u64)mali_max_job_runtime * 1000000ULL;
+	u64 min_timeout = (u64)mali_adaptive_job_timeout_min_ms * 1000000ULL;
+	u64 timeout;
+
+	if (0 >= mali_adaptive_job_timeout_min_ms || MALI_SESSION_RUNTIME_MIN_SAMPLES > gpu_time->runtime_samples)
+	{
+		return max_timeout;
+	}
+
+	timeout = ((u64)gpu_time->runtime_average + 4 * (u64)gpu_time->runtime_deviation) * MALI_SESSION_RUNTIME_TIMEOUT_FACTOR;
+	timeout <<= 10;
+
+	if (timeout < min_timeout)
+	{
+		timeout = min_timeout;
+	}
+
+	if (timeout > max_timeout)
+	{
+		timeout = max_timeout;
+	}
+
+	return timeout;
+}
+
+u32 mali_session_dump_gpu_time(char *buf, u32 size)
+{
+	struct mali_session_data *session, *tmp;
+	int n = 0;
+
+	n += _mali_osk_snprintf(buf + n, size - n, "Quota period: %d ms, GP quota: %d ms, PP quota: %d ms\n",
+	                        mali_session_quota_period_ms, mali_session_gp_quota_ms, mali_session_pp_quota_ms);
+
+	mali_session_lock();
+	MALI_SESSION_FOREACH(session, tmp, link)
+	{
+		n += _mali_osk_snprintf(buf + n, size - n, "Session 0x%08X: GP %llu/%llu ns, PP %llu/%llu ns (period/total)\n",
+		                        session, session->gp_time.used, session->gp_time.total,
+		                        session->pp_time.used, session->pp_time.total);
+		n += _mali_osk_snprintf(buf + n, size - n, "\tJob timeout: GP %llu ns, PP %llu ns\n",
+		                        mali_session_get_job_timeout(&session->gp_time),
+		                        mali_session_get_job_timeout(&session->pp_time));
+	}
+	mali_session_unlock();
+
+	return n;
+}
@@ -16,6 +16,25 @@
 #include "mali_osk.h"
 #include "mali_osk_list.h"
 
+/**
+ * GPU time used by a session on one type of core, used to enforce per session quotas
+ */
+struct mali_session_gpu_time
+{
+	u64 period_start; /**< Time (in ns) at which the current quota period started */
+	u64 used;         /**< Busy time (in ns) used in the current quota period */
+	u64 total;        /**< Busy time (in ns) used since the session was opened */
+	u32 runtime_average;   /**< Smoothed runtime of successful jobs, in units of 1024 ns */
+	u32 runtime_deviation; /**< Smoothed mean deviation of the runtime, in units of 1024 ns */
+	u32 runtime_samples;   /**< Number of runtimes sampled, saturates at MALI_SESSION_RUNTIME_MIN_SAMPLES */
+};
+
+/* Number of job runtimes which must be sampled before the job timeout is derived from them */
+#define MALI_SESSION_RUNTIME_MIN_SAMPLES 16
+
+/* Number of lists the freed memory kept for reuse is hashed into, on size and cache settings */
+#define MALI_SESSION_FREE_CACHE_BUCKETS 16
+
 struct mali_session_data
 {
 	_mali_osk_notification_queue_t * ioctl_queue;
@@ -28,6 +47,17 @@ struct mali_session_data
 	_mali_osk_lock_t *memory_lock; /**< Lock protecting the vm manipulation */
 	mali_descriptor_mapping * descriptor_mapping; /**< Mapping between userspace descriptors and our pointers */
 	_mali_osk_list_t memory_head; /**< Track all the memory allocated in this session, for freeing on abnormal termination */
+	_mali_osk_rbtree_t va_ranges; /**< GPU virtual address ranges in use, keyed by start address, protected by memory_lock */
+	u32 free_batch;                 /**< Non-zero while a batch of allocations is freed, protected by memory_lock */
+	_mali_osk_list_t free_pending;  /**< Allocations freed by the current batch, waiting for the TLB zap, protected by memory_lock */
+	_mali_osk_list_t free_deferred; /**< Allocations gone from the GPU, waiting for their memory to be released, protected by memory_lock */
+	_mali_osk_wq_work_t *free_work; /**< Releases the memory of the free_deferred allocations in the background */
+	_mali_osk_list_t slab_heaps;    /**< Sparse memory small objects are suballocated from, protected by memory_lock */
+	_mali_osk_list_t free_cache[MALI_SESSION_FREE_CACHE_BUCKETS]; /**< Memory of freed allocations kept for reuse, protected by memory_lock */
+	_mali_osk_list_t free_cache_lru; /**< The same memory, most recently freed first, protected by memory_lock */
+	u32 free_cache_size;            /**< Bytes of memory kept for reuse, protected by memory_lock */
+	mali_bool free_cache_shrink;    /**< Set when free_work is to release all memory kept for reuse, protected by memory_lock */
+	_mali_osk_timer_t *free_cache_timer; /**< Runs free_work when memory kept for reuse gets too old, protected by memory_lock */
 
 	struct mali_page_directory *page_directory; /**< MMU page directory for this session */
 
@@ -35,8 +65,21 @@ struct mali_session_data
 
 	_MALI_OSK_LIST_HEAD(job_list); /**< List of all jobs on this session */
 	mali_bool is_compositor;       /**< Gives compositor priority to jobs from this session if TRUE */
+	_mali_osk_atomic_t job_generation;         /**< Generation new jobs are counted in, see mali_session_jobs_done() */
+	_mali_osk_atomic_t num_generation_jobs[2]; /**< Number of existing GP and PP jobs from even and odd generations */
+	_mali_osk_list_t purgeable;    /**< Sparse memory which may be purged, least recently made purgeable first, protected by memory_lock */
+
+	struct mali_session_gpu_time gp_time; /**< GP busy time, protected by the GP scheduler lock */
+	struct mali_session_gpu_time pp_time; /**< PP busy time, protected by the PP scheduler lock */
 };
 
+/* Length of a quota period and the GP and PP time each session may use per period, 0 disables the quota */
+extern int mali_session_quota_period_ms;
+extern int mali_session_gp_quota_ms;
+extern int mali_session_pp_quota_ms;
+/* Lower bound of job timeouts derived from the observed runtimes, 0 disables adaptive timeouts */
+extern int mali_adaptive_job_timeout_min_ms;
+
 _mali_osk_errcode_t mali_session_initialize(void);
 void mali_session_terminate(void);
 
@@ -60,6 +103,62 @@ void mali_session_remove(struct mali_session_data *session);
 #define MALI_SESSION_FOREACH(session, tmp, link) \
 	_MALI_OSK_LIST_FOREACHENTRY(session, tmp, &mali_sessions, struct mali_session_data, link)
 
+/**
+ * Charge a session for the time a job kept a core busy.
+ * @param gpu_time GP or PP time of the session
+ * @param busy Time (in ns) the job ran for
+ * @param num_cores Number of cores the job kept busy, the session is charged for each of them
+ * @param success MALI_TRUE if the job completed successfully, only then is the runtime sampled.
+ *                A failed job, possibly a timed out one, restarts the sampling.
+ */
+void mali_session_gpu_time_add(struct mali_session_gpu_time *gpu_time, u64 busy, u32 num_cores, mali_bool success);
+
+/**
+ * Get the time a job from a session may run before it is considered hung.
+ * Once enough runtimes have been sampled, the timeout is derived from their
+ * average and deviation, otherwise mali_max_job_runtime is used.
+ * @param gpu_time GP or PP time of the session
+ * @return Timeout in ns
+ */
+u64 mali_session_get_job_timeout(struct mali_session_gpu_time *gpu_time);
+
+/**
+ * Check if a session has used up its quota in the current period.
+ * A new period is started if the current one has expired.
+ * @param gpu_time GP or PP time of the session
+ * @param quota_ms Time the session may use per period, 0 means no quota
+ * @return MALI_TRUE if jobs from the session should be deferred
+ */
+mali_bool mali_session_gpu_time_over_quota(struct mali_session_gpu_time *gpu_time, int quota_ms);
+
+u32 mali_session_dump_gpu_time(char *buf, u32 size);
+
+/**
+ * Count a new GP or PP job from a session, until mali_session_job_end().
+ * @return The job generation the job is counted in
+ */
+u32 mali_session_job_begin(struct mali_session_data *session);
+
+/**
+ * Stop counting a job once it is deleted.
+ * @param generation The value mali_session_job_begin() returned for the job
+ */
+void mali_session_job_end(struct mali_session_data *session, u32 generation);
+
+MALI_STATIC_INLINE u32 mali_session_job_generation(struct mali_session_data *session)
+{
+	return _mali_osk_atomic_read(&session->job_generation);
+}
+
+/**
+ * Check if all jobs counted in a generation, or an earlier one, are gone.
+ * Moves on to the next generation once the jobs of the one before are gone.
+ * Must be called with the session memory lock held.
+ * @param generation Generation returned by mali_session_job_generation() at some point
+ * @return MALI_TRUE if no job which existed back then is left
+ */
+mali_bool mali_session_jobs_done(struct mali_session_data *session, u32 generation);
+
 MALI_STATIC_INLINE struct mali_page_directory *mali_session_get_page_directory(struct mali_session_data *session)
 {
 	return session->page_directory;
@@ -370,6 +370,69 @@ _mali_osk_errcode_t _mali_ukk_dump_mmu_page_table( _mali_uk_dump_mmu_page_table_
  */
 _mali_osk_errcode_t _mali_ukk_mem_write_safe( _mali_uk_mem_write_safe_s *args );
 
+/** @brief Reserve a range of GPU virtual address space placed by the kernel.
+ *
+ * The range is backed by passing the returned address to mmap, and stays
+ * reserved after munmap until it is freed with _mali_ukk_mem_free_va().
+ * @param args see _mali_uk_mem_alloc_va_s in mali_utgard_uk_types.h
+ * @return _MALI_OSK_ERR_OK on success, otherwise a suitable _mali_osk_errcode_t on failure.
+ */
+_mali_osk_errcode_t _mali_ukk_mem_alloc_va( _mali_uk_mem_alloc_va_s *args );
+
+/** @brief Release a range of GPU virtual address space reserved by _mali_ukk_mem_alloc_va().
+ * @param args see _mali_uk_mem_free_va_s in mali_utgard_uk_types.h
+ * @return _MALI_OSK_ERR_OK on success, _MALI_OSK_ERR_INVALID_ARGS if the range is unknown or still mapped.
+ */
+_mali_osk_errcode_t _mali_ukk_mem_free_va( _mali_uk_mem_free_va_s *args );
+
+/** @brief Back part of a mapped sparse range with pages.
+ *
+ * Pages already committed are left as they are. If memory runs out, the
+ * pages committed up to that point stay committed.
+ * @param args see _mali_uk_mem_commit_s in mali_utgard_uk_types.h
+ * @return _MALI_OSK_ERR_OK on success, otherwise a suitable _mali_osk_errcode_t on failure.
+ */
+_mali_osk_errcode_t _mali_ukk_mem_commit( _mali_uk_mem_commit_s *args );
+
+/** @brief Return the pages backing part of a mapped sparse range, the range stays reserved.
+ * @param args see _mali_uk_mem_commit_s in mali_utgard_uk_types.h
+ * @return _MALI_OSK_ERR_OK on success, otherwise a suitable _mali_osk_errcode_t on failure.
+ */
+_mali_osk_errcode_t _mali_ukk_mem_decommit( _mali_uk_mem_commit_s *args );
+
+/** @brief Let the kernel discard the pages of a mapped sparse range under memory pressure, or stop it from doing so.
+ *
+ * When the memory is made unpurgeable again, args->purged tells if its pages
+ * were decommitted in the meantime. They must then be committed again.
+ * @param args see _mali_uk_mem_set_purgeable_s in mali_utgard_uk_types.h
+ * @return _MALI_OSK_ERR_OK on success, otherwise a suitable _mali_osk_errcode_t on failure.
+ */
+_mali_osk_errcode_t _mali_ukk_mem_set_purgeable( _mali_uk_mem_set_purgeable_s *args );
+
+/** @brief Allocate a small object from a slab heap in mapped sparse memory.
+ *
+ * The kernel commits pages for the heap's slabs as they are needed.
+ * @param args see _mali_uk_mem_suballoc_s in mali_utgard_uk_types.h
+ * @return _MALI_OSK_ERR_OK on success, otherwise a suitable _mali_osk_errcode_t on failure.
+ */
+_mali_osk_errcode_t _mali_ukk_mem_suballoc( _mali_uk_mem_suballoc_s *args );
+
+/** @brief Free an object allocated with _mali_ukk_mem_suballoc().
+ *
+ * Must be called with the CPU mappings of the session locked, since the pages
+ * of a slab which becomes empty may be decommitted.
+ * @param args see _mali_uk_mem_subfree_s in mali_utgard_uk_types.h
+ * @return _MALI_OSK_ERR_OK on success, otherwise a suitable _mali_osk_errcode_t on failure.
+ */
+_mali_osk_errcode_t _mali_ukk_mem_subfree( _mali_uk_mem_subfree_s *args );
+
+/** @brief Make CPU and GPU agree on the contents of part of a CPU cached allocation.
+ *
+ * @param args see _mali_uk_mem_sync_s in mali_utgard_uk_types.h
+ * @return _MALI_OSK_ERR_OK on success, otherwise a suitable _mali_osk_errcode_t on failure.
+ */
+_mali_osk_errcode_t _mali_ukk_mem_sync( _mali_uk_mem_sync_s *args );
+
 /** @brief Map a physically contiguous range of memory into Mali
  * @param args see _mali_uk_map_external_mem_s in mali_utgard_uk_types.h
  * @return _MALI_OSK_ERR_OK on success, otherwise a suitable _mali_osk_errcode_t on failure.
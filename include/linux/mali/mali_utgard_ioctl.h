@@ -63,6 +63,17 @@ extern "C"
 #define MALI_IOC_MEM_QUERY_MMU_PAGE_TABLE_DUMP_SIZE _IOR (MALI_IOC_MEMORY_BASE, _MALI_UK_QUERY_MMU_PAGE_TABLE_DUMP_SIZE, _mali_uk_query_mmu_page_table_dump_size_s *)
 #define MALI_IOC_MEM_DUMP_MMU_PAGE_TABLE    _IOWR(MALI_IOC_MEMORY_BASE, _MALI_UK_DUMP_MMU_PAGE_TABLE, _mali_uk_dump_mmu_page_table_s *)
 #define MALI_IOC_MEM_WRITE_SAFE             _IOWR(MALI_IOC_MEMORY_BASE, _MALI_UK_MEM_WRITE_SAFE, _mali_uk_mem_write_safe_s *)
+#define MALI_IOC_MEM_ALLOC_VA               _IOWR(MALI_IOC_MEMORY_BASE, _MALI_UK_MEM_ALLOC_VA, _mali_uk_mem_alloc_va_s *)
+#define MALI_IOC_MEM_FREE_VA                _IOW (MALI_IOC_MEMORY_BASE, _MALI_UK_MEM_FREE_VA, _mali_uk_mem_free_va_s *)
+#define MALI_IOC_MEM_COMMIT                 _IOW (MALI_IOC_MEMORY_BASE, _MALI_UK_MEM_COMMIT, _mali_uk_mem_commit_s *)
+#define MALI_IOC_MEM_DECOMMIT               _IOW (MALI_IOC_MEMORY_BASE, _MALI_UK_MEM_DECOMMIT, _mali_uk_mem_commit_s *)
+#define MALI_IOC_MEM_SET_PURGEABLE          _IOWR(MALI_IOC_MEMORY_BASE, _MALI_UK_MEM_SET_PURGEABLE, _mali_uk_mem_set_purgeable_s *)
+#define MALI_IOC_MEM_FREE_BATCH             _IOW (MALI_IOC_MEMORY_BASE, _MALI_UK_MEM_FREE_BATCH, _mali_uk_mem_free_batch_s *)
+#define MALI_IOC_MEM_SUBALLOC               _IOWR(MALI_IOC_MEMORY_BASE, _MALI_UK_MEM_SUBALLOC, _mali_uk_mem_suballoc_s *)
+#define MALI_IOC_MEM_SUBFREE                _IOW (MALI_IOC_MEMORY_BASE, _MALI_UK_MEM_SUBFREE, _mali_uk_mem_subfree_s *)
+#define MALI_IOC_MEM_ATTACH_USERPTR         _IOWR(MALI_IOC_MEMORY_BASE, _MALI_UK_ATTACH_USERPTR, _mali_uk_attach_userptr_s *)
+#define MALI_IOC_MEM_RELEASE_USERPTR        _IOW (MALI_IOC_MEMORY_BASE, _MALI_UK_RELEASE_USERPTR, _mali_uk_release_userptr_s *)
+#define MALI_IOC_MEM_SYNC                   _IOW (MALI_IOC_MEMORY_BASE, _MALI_UK_MEM_SYNC, _mali_uk_mem_sync_s *)
 
 #define MALI_IOC_PP_START_JOB               _IOWR(MALI_IOC_PP_BASE, _MALI_UK_PP_START_JOB, _mali_uk_pp_start_job_s *)
 #define MALI_IOC_PP_NUMBER_OF_CORES_GET	    _IOR (MALI_IOC_PP_BASE, _MALI_UK_GET_PP_NUMBER_OF_CORES, _mali_uk_get_pp_number_of_cores_s *)
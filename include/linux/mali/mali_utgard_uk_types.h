@@ -92,6 +92,17 @@ typedef enum
     _MALI_UK_UNMAP_EXT_MEM,                  /**< _mali_uku_unmap_external_mem() */
     _MALI_UK_VA_TO_MALI_PA,                  /**< _mali_uku_va_to_mali_pa() */
     _MALI_UK_MEM_WRITE_SAFE,                 /**< _mali_uku_mem_write_safe() */
+    _MALI_UK_MEM_ALLOC_VA,                   /**< _mali_ukk_mem_alloc_va() */
+    _MALI_UK_MEM_FREE_VA,                    /**< _mali_ukk_mem_free_va() */
+    _MALI_UK_MEM_COMMIT,                     /**< _mali_ukk_mem_commit() */
+    _MALI_UK_MEM_DECOMMIT,                   /**< _mali_ukk_mem_decommit() */
+    _MALI_UK_MEM_SET_PURGEABLE,              /**< _mali_ukk_mem_set_purgeable() */
+    _MALI_UK_MEM_FREE_BATCH,                 /**< _mali_ukk_mem_free_batch() */
+    _MALI_UK_MEM_SUBALLOC,                   /**< _mali_ukk_mem_suballoc() */
+    _MALI_UK_MEM_SUBFREE,                    /**< _mali_ukk_mem_subfree() */
+    _MALI_UK_ATTACH_USERPTR,                 /**< _mali_ukk_attach_userptr() */
+    _MALI_UK_RELEASE_USERPTR,                /**< _mali_ukk_release_userptr() */
+    _MALI_UK_MEM_SYNC,                       /**< _mali_ukk_mem_sync() */
 
     /** Common functions for each core */
 
@@ -808,7 +819,7 @@ typedef struct
     void *ctx;                      /**< [in,out] user-kernel context (trashed on output) */
 } _mali_uk_term_mem_s;
 
-/** Flag for _mali_uk_map_external_mem_s, _mali_uk_attach_ump_mem_s and _mali_uk_attach_dma_buf_s */
+/** Flag for _mali_uk_map_external_mem_s, _mali_uk_attach_ump_mem_s, _mali_uk_attach_dma_buf_s and _mali_uk_attach_userptr_s */
 #define _MALI_MAP_EXTERNAL_MAP_GUARD_PAGE (1<<0)
 
 typedef struct
@@ -853,6 +864,29 @@ typedef struct
 	u32 cookie;                     /**< [in] identifier for mapped memory object in kernel space  */
 } _mali_uk_release_dma_buf_s;
 
+/**
+ * @brief Arguments for _mali_uk[uk]_attach_userptr()
+ *
+ * Maps memory of the calling process into Mali without copying it. The pages
+ * are pinned until the memory is released with _mali_uk[uk]_release_userptr(),
+ * or the session ends.
+ */
+typedef struct
+{
+	void *ctx;                      /**< [in,out] user-kernel context (trashed on output) */
+	u32 user_address;               /**< [in] CPU virtual address of the memory, must be page aligned */
+	u32 size;                       /**< [in] size, must be a multiple of the page size */
+	u32 mali_address;               /**< [in] mali address to map the memory to */
+	u32 flags;                      /**< [in] flags, see \ref _MALI_MAP_EXTERNAL_MAP_GUARD_PAGE */
+	u32 cookie;                     /**< [out] identifier for mapped memory object in kernel space  */
+} _mali_uk_attach_userptr_s;
+
+typedef struct
+{
+	void *ctx;                      /**< [in,out] user-kernel context (trashed on output) */
+	u32 cookie;                     /**< [in] identifier for mapped memory object in kernel space  */
+} _mali_uk_release_userptr_s;
+
 /** @note This is identical to _mali_uk_map_external_mem_s above, however phys_addr is replaced by secure_id */
 typedef struct
 {
@@ -911,6 +945,138 @@ typedef struct
 	u32 size;         /**< [in,out] Number of bytes to write/copy on input, number of bytes actually written/copied on output */
 } _mali_uk_mem_write_safe_s;
 
+/** Flag for _mali_uk_mem_alloc_va_s, memory mapped at the range is only backed by pages committed with _mali_uk[uk]_mem_commit() */
+#define _MALI_MEM_ALLOC_VA_SPARSE (1<<0)
+/** Flag for _mali_uk_mem_alloc_va_s, sparse memory mapped at the range also gets pages committed when the GPU faults on it */
+#define _MALI_MEM_ALLOC_VA_GROW_ON_FAULT (1<<1)
+/** Flag for _mali_uk_mem_alloc_va_s, memory mapped at the range is cached for the CPU, see _mali_uk_mem_sync_s. It then comes from OS memory only, or is write-combined if the driver has none */
+#define _MALI_MEM_ALLOC_VA_CPU_CACHED (1<<2)
+/** Flag for _mali_uk_mem_alloc_va_s, memory mapped at the range is uncached for the CPU instead of write-combined */
+#define _MALI_MEM_ALLOC_VA_CPU_UNCACHED (1<<3)
+
+/**
+ * @brief Arguments for _mali_uk[uk]_mem_alloc_va()
+ *
+ * Reserves a range of GPU virtual address space chosen by the kernel. The
+ * returned address is then passed as the offset to mmap to back the range.
+ */
+typedef struct
+{
+	void *ctx;        /**< [in,out] user-kernel context (trashed on output) */
+	u32 size;         /**< [in]     Size of the range to reserve, in bytes, must be a multiple of the page size */
+	u32 flags;        /**< [in]     flags, see \ref _MALI_MEM_ALLOC_VA_SPARSE, \ref _MALI_MEM_ALLOC_VA_GROW_ON_FAULT,
+	                                \ref _MALI_MEM_ALLOC_VA_CPU_CACHED and \ref _MALI_MEM_ALLOC_VA_CPU_UNCACHED */
+	u32 mali_address; /**< [out]    GPU virtual address of the reserved range */
+} _mali_uk_mem_alloc_va_s;
+
+/**
+ * @brief Arguments for _mali_uk[uk]_mem_free_va()
+ */
+typedef struct
+{
+	void *ctx;        /**< [in,out] user-kernel context (trashed on output) */
+	u32 mali_address; /**< [in]     GPU virtual address returned by _mali_uk[uk]_mem_alloc_va() */
+} _mali_uk_mem_free_va_s;
+
+/**
+ * @brief Arguments for _mali_uk[uk]_mem_commit() and _mali_uk[uk]_mem_decommit()
+ *
+ * Commits pages to, or decommits pages from, part of a sparse range. The
+ * range must be reserved with \ref _MALI_MEM_ALLOC_VA_SPARSE and mapped.
+ */
+typedef struct
+{
+	void *ctx;        /**< [in,out] user-kernel context (trashed on output) */
+	u32 mali_address; /**< [in]     GPU virtual address of the sparse range */
+	u32 offset;       /**< [in]     Offset into the range, in bytes, must be a multiple of the page size */
+	u32 size;         /**< [in]     Number of bytes to commit or decommit, must be a multiple of the page size */
+} _mali_uk_mem_commit_s;
+
+/**
+ * @brief Arguments for _mali_uk[uk]_mem_set_purgeable()
+ *
+ * While sparse memory is purgeable, the kernel may decommit all of its pages
+ * when the system runs low on memory. This is only done while the session
+ * has no GP or PP jobs queued or running. The range must be reserved with
+ * \ref _MALI_MEM_ALLOC_VA_SPARSE and mapped.
+ */
+typedef struct
+{
+	void *ctx;        /**< [in,out] user-kernel context (trashed on output) */
+	u32 mali_address; /**< [in]     GPU virtual address of the sparse range */
+	u32 purgeable;    /**< [in]     1 to make the memory purgeable, 0 to keep its pages again */
+	u32 purged;       /**< [out]    1 if the pages were decommitted while the memory was purgeable */
+} _mali_uk_mem_set_purgeable_s;
+
+/**
+ * @brief Arguments for _mali_ukk_mem_free_batch()
+ *
+ * Frees a number of allocations mapped with mmap() on the Mali device, as if
+ * each had been unmapped with munmap(). The GPU TLBs are only zapped once for
+ * the whole batch, and the memory is released in the background. Freeing
+ * stops at the first address which is not the start of such a mapping.
+ */
+typedef struct
+{
+	void *ctx;          /**< [in,out] user-kernel context (trashed on output) */
+	u32 num_mappings;   /**< [in]     Number of entries in mappings */
+	void **mappings;    /**< [in]     CPU addresses returned by mmap() for the allocations to free */
+} _mali_uk_mem_free_batch_s;
+
+/** Largest object _mali_uk[uk]_mem_suballoc() can allocate, in bytes */
+#define _MALI_MEM_SUBALLOC_MAX_SIZE (16*1024)
+
+/**
+ * @brief Arguments for _mali_uk[uk]_mem_suballoc()
+ *
+ * Allocates a small object from a slab heap. The heap is a range reserved
+ * with \ref _MALI_MEM_ALLOC_VA_SPARSE and mapped, without committed pages.
+ * It becomes a heap on the first allocation, after which the kernel commits
+ * and decommits its pages. Objects of the same power of two size class are
+ * packed into shared pages and aligned to their size. Their contents are
+ * undefined when allocated.
+ */
+typedef struct
+{
+	void *ctx;          /**< [in,out] user-kernel context (trashed on output) */
+	u32 heap_address;   /**< [in]     GPU virtual address of the heap */
+	u32 size;           /**< [in]     Size of the object in bytes, at most \ref _MALI_MEM_SUBALLOC_MAX_SIZE */
+	u32 mali_address;   /**< [out]    GPU virtual address of the object */
+} _mali_uk_mem_suballoc_s;
+
+/**
+ * @brief Arguments for _mali_uk[uk]_mem_subfree()
+ */
+typedef struct
+{
+	void *ctx;          /**< [in,out] user-kernel context (trashed on output) */
+	u32 heap_address;   /**< [in]     GPU virtual address of the heap */
+	u32 mali_address;   /**< [in]     GPU virtual address of the object, as returned by _mali_uk[uk]_mem_suballoc() */
+} _mali_uk_mem_subfree_s;
+
+/** Direction for _mali_uk_mem_sync_s, write CPU writes back to memory before the GPU reads it */
+#define _MALI_MEM_SYNC_TO_DEVICE 0
+/** Direction for _mali_uk_mem_sync_s, discard stale CPU cache lines before the CPU reads what the GPU wrote */
+#define _MALI_MEM_SYNC_TO_CPU    1
+
+/**
+ * @brief Arguments for _mali_uk[uk]_mem_sync()
+ *
+ * Performs CPU cache maintenance on part of an allocation mapped with mmap()
+ * at a range reserved with \ref _MALI_MEM_ALLOC_VA_CPU_CACHED, or on process
+ * memory attached with _mali_uk_attach_userptr_s. Memory mapped
+ * write-combined or uncached needs no maintenance, syncing it only orders
+ * the CPU writes.
+ */
+typedef struct
+{
+	void *ctx;          /**< [in,out] user-kernel context (trashed on output) */
+	u32 mali_address;   /**< [in]     GPU virtual address of the allocation */
+	u32 offset;         /**< [in]     Offset into the allocation, in bytes */
+	u32 size;           /**< [in]     Number of bytes to sync, the range is widened to whole pages */
+	u32 direction;      /**< [in]     \ref _MALI_MEM_SYNC_TO_DEVICE or \ref _MALI_MEM_SYNC_TO_CPU */
+} _mali_uk_mem_sync_s;
+
 typedef struct
 {
     void *ctx;                      /**< [in,out] user-kernel context (trashed on output) */
@@ -17,6 +17,8 @@
 #include <linux/wait.h>
 #include <linux/sched.h>
 #include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/workqueue.h>
 
 #include "mali_ukk.h"
 #include "mali_osk.h"
@@ -26,6 +28,7 @@
 
 #include "mali_kernel_memory_engine.h"
 #include "mali_memory.h"
+#include "mali_l2_cache.h"
 #include "mali_dma_buf.h"
 
 
@@ -37,9 +40,145 @@ struct mali_dma_buf_attachment {
 	int map_ref;
 	struct mutex map_lock;
 	mali_bool is_mapped;
+	mali_bool is_released; /* Unmapped as soon as the last reference is gone */
 	wait_queue_head_t wait_queue;
+	struct list_head idle_link; /* On mali_dma_buf_idle while mapped without references */
+	u32 num_pages;
 };
 
+/*
+ * Attachments no job references any more stay mapped, so buffers used for
+ * every frame are not mapped again and their PTEs rewritten for each job.
+ * They are unmapped oldest first once there are too many of them, under
+ * memory pressure, or when the attachment is released.
+ */
+int mali_dma_buf_max_idle_mapped = 32;
+
+static LIST_HEAD(mali_dma_buf_idle); /* Most recently used first */
+static DEFINE_MUTEX(mali_dma_buf_idle_lock); /* Taken after the map_lock of an attachment */
+static u32 mali_dma_buf_num_idle = 0;
+static u32 mali_dma_buf_idle_pages = 0;
+
+static atomic_t mali_dma_buf_map_hits;
+static atomic_t mali_dma_buf_map_misses;
+static atomic_t mali_dma_buf_evictions;
+
+static _mali_osk_shrinker_t *mali_dma_buf_shrinker = NULL;
+
+static void mali_dma_buf_shrink_work_handler(struct work_struct *work);
+static DECLARE_WORK(mali_dma_buf_shrink_work, mali_dma_buf_shrink_work_handler);
+
+/* Must be called with the map_lock held and no references left */
+static void mali_dma_buf_unmap_attachment(struct mali_dma_buf_attachment *mem)
+{
+	MALI_DEBUG_ASSERT(0 == mem->map_ref);
+	MALI_DEBUG_ASSERT(mem->is_mapped);
+
+	dma_buf_unmap_attachment(mem->attachment, mem->sgt, DMA_BIDIRECTIONAL);
+	mem->sgt = NULL;
+
+	mem->is_mapped = MALI_FALSE;
+
+	/* Wake up any thread waiting for buffer to become unmapped */
+	wake_up_all(&mem->wait_queue);
+}
+
+/* Must be called with the map_lock and mali_dma_buf_idle_lock held */
+static void mali_dma_buf_idle_remove(struct mali_dma_buf_attachment *mem)
+{
+	if (!list_empty(&mem->idle_link))
+	{
+		list_del_init(&mem->idle_link);
+		mali_dma_buf_num_idle--;
+		mali_dma_buf_idle_pages -= mem->num_pages;
+	}
+}
+
+/*
+ * Unmap idle attachments, oldest first, until at most max_idle are left and
+ * at least nr_pages pages were unmapped. Returns the number of pages still
+ * mapped by idle attachments.
+ */
+static u32 mali_dma_buf_idle_trim(u32 max_idle, u32 nr_pages)
+{
+	struct mali_dma_buf_attachment *mem, *temp;
+	u32 unmapped = 0;
+	u32 idle_pages;
+
+	mutex_lock(&mali_dma_buf_idle_lock);
+
+	list_for_each_entry_safe_reverse(mem, temp, &mali_dma_buf_idle, idle_link)
+	{
+		if (mali_dma_buf_num_idle <= max_idle && unmapped >= nr_pages)
+		{
+			break;
+		}
+
+		/* The map_lock is taken first elsewhere, skip attachments being mapped again */
+		if (!mutex_trylock(&mem->map_lock))
+		{
+			continue;
+		}
+
+		mali_dma_buf_idle_remove(mem);
+		unmapped += mem->num_pages;
+		mali_dma_buf_unmap_attachment(mem);
+		atomic_inc(&mali_dma_buf_evictions);
+
+		mutex_unlock(&mem->map_lock);
+	}
+
+	idle_pages = mali_dma_buf_idle_pages;
+
+	mutex_unlock(&mali_dma_buf_idle_lock);
+
+	return idle_pages;
+}
+
+static void mali_dma_buf_shrink_work_handler(struct work_struct *work)
+{
+	mali_dma_buf_idle_trim(0, 0);
+}
+
+static u32 mali_dma_buf_shrink(u32 nr_pages, void *data)
+{
+	if (0 != nr_pages && 0 != mali_dma_buf_num_idle)
+	{
+		/* Exporters may allocate memory with their locks held, never unmap from reclaim */
+		schedule_work(&mali_dma_buf_shrink_work);
+	}
+
+	return mali_dma_buf_idle_pages;
+}
+
+void mali_dma_buf_init(void)
+{
+	mali_dma_buf_shrinker = _mali_osk_shrinker_register(mali_dma_buf_shrink, NULL);
+	MALI_DEBUG_PRINT_IF(1, NULL == mali_dma_buf_shrinker, ("Failed to register dma-buf mapping shrinker\n"));
+}
+
+void mali_dma_buf_term(void)
+{
+	if (NULL != mali_dma_buf_shrinker)
+	{
+		_mali_osk_shrinker_unregister(mali_dma_buf_shrinker);
+		mali_dma_buf_shrinker = NULL;
+	}
+
+	cancel_work_sync(&mali_dma_buf_shrink_work);
+
+	/* All attachments are gone with their sessions */
+	MALI_DEBUG_ASSERT(list_empty(&mali_dma_buf_idle));
+}
+
+u32 mali_dma_buf_dump_stats(char *buf, u32 size)
+{
+	return _mali_osk_snprintf(buf, size, "Mapping hits: %u, misses: %u, evictions: %u\nIdle mapped: %u attachments, %u KiB\n",
+	                          atomic_read(&mali_dma_buf_map_hits), atomic_read(&mali_dma_buf_map_misses),
+	                          atomic_read(&mali_dma_buf_evictions), mali_dma_buf_num_idle,
+	                          mali_dma_buf_idle_pages * (PAGE_SIZE / 1024));
+}
+
 void mali_dma_buf_release(void *ctx, void *handle)
 {
 	struct mali_dma_buf_attachment *mem;
@@ -52,6 +191,18 @@ void mali_dma_buf_release(void *ctx, void *handle)
 	MALI_DEBUG_ASSERT_POINTER(mem->attachment);
 	MALI_DEBUG_ASSERT_POINTER(mem->buf);
 
+	/* Unmap the attachment if idle, jobs still using it unmap it when they are done */
+	mutex_lock(&mem->map_lock);
+	mem->is_released = MALI_TRUE;
+	mutex_lock(&mali_dma_buf_idle_lock);
+	mali_dma_buf_idle_remove(mem);
+	mutex_unlock(&mali_dma_buf_idle_lock);
+	if (0 == mem->map_ref && mem->is_mapped)
+	{
+		mali_dma_buf_unmap_attachment(mem);
+	}
+	mutex_unlock(&mem->map_lock);
+
 #if defined(CONFIG_MALI_DMA_BUF_MAP_ON_ATTACH)
 	/* We mapped implicitly on attach, so we need to unmap on release */
 	mali_dma_buf_unmap(mem);
@@ -61,6 +212,10 @@ void mali_dma_buf_release(void *ctx, void *handle)
 	wait_event(mem->wait_queue, !mem->is_mapped);
 	MALI_DEBUG_ASSERT(!mem->is_mapped);
 
+	/* The thread which unmapped it may not have dropped the lock yet */
+	mutex_lock(&mem->map_lock);
+	mutex_unlock(&mem->map_lock);
+
 	dma_buf_detach(mem->buf, mem->attachment);
 	dma_buf_put(mem->buf);
 
@@ -80,17 +235,30 @@ int mali_dma_buf_map(struct mali_dma_buf_attachment *mem, struct mali_session_da
 	MALI_DEBUG_ASSERT_POINTER(session);
 	MALI_DEBUG_ASSERT(mem->session == session);
 
+	/* Written by the exporter or another device since the last job, as far as the L2 cache knows */
+	mali_l2_cache_mark_dirty();
+
 	mutex_lock(&mem->map_lock);
 
 	mem->map_ref++;
 
 	MALI_DEBUG_PRINT(5, ("Mali DMA-buf: map attachment %p, new map_ref = %d\n", mem, mem->map_ref));
 
-	if (1 == mem->map_ref)
+	if (1 == mem->map_ref && mem->is_mapped)
 	{
-		/* First reference taken, so we need to map the dma buf */
-		MALI_DEBUG_ASSERT(!mem->is_mapped);
+		/* Still mapped since an earlier job, so are the PTEs */
+		mutex_lock(&mali_dma_buf_idle_lock);
+		mali_dma_buf_idle_remove(mem);
+		mutex_unlock(&mali_dma_buf_idle_lock);
+
+		atomic_inc(&mali_dma_buf_map_hits);
+		*offset += mem->num_pages * PAGE_SIZE;
 
+		mutex_unlock(&mem->map_lock);
+	}
+	else if (1 == mem->map_ref)
+	{
+		/* First reference taken, so we need to map the dma buf */
 		pagedir = mali_session_get_page_directory(session);
 		MALI_DEBUG_ASSERT_POINTER(pagedir);
 
@@ -98,9 +266,15 @@ int mali_dma_buf_map(struct mali_dma_buf_attachment *mem, struct mali_session_da
 		if (IS_ERR_OR_NULL(mem->sgt))
 		{
 			MALI_DEBUG_PRINT_ERROR(("Failed to map dma-buf attachment\n"));
+			mem->sgt = NULL;
+			mem->map_ref--;
+			mutex_unlock(&mem->map_lock);
 			return -EFAULT;
 		}
 
+		atomic_inc(&mali_dma_buf_map_misses);
+		mem->num_pages = 0;
+
 		for_each_sg(mem->sgt->sgl, sg, mem->sgt->nents, i)
 		{
 			u32 size = sg_dma_len(sg);
@@ -113,6 +287,7 @@ int mali_dma_buf_map(struct mali_dma_buf_attachment *mem, struct mali_session_da
 
 			virt += size;
 			*offset += size;
+			mem->num_pages += size / PAGE_SIZE;
 		}
 
 		if (flags & MALI_MEMORY_ALLOCATION_FLAG_MAP_GUARD_PAGE)
@@ -151,17 +326,26 @@ void mali_dma_buf_unmap(struct mali_dma_buf_attachment *mem)
 
 	MALI_DEBUG_PRINT(5, ("Mali DMA-buf: unmap attachment %p, new map_ref = %d\n", mem, mem->map_ref));
 
-	if (0 == mem->map_ref)
+	if (0 == mem->map_ref && (mem->is_released || 0 >= mali_dma_buf_max_idle_mapped))
 	{
-		dma_buf_unmap_attachment(mem->attachment, mem->sgt, DMA_BIDIRECTIONAL);
-
-		mem->is_mapped = MALI_FALSE;
+		mali_dma_buf_unmap_attachment(mem);
+	}
+	else if (0 == mem->map_ref)
+	{
+		/* Kept mapped for the next job */
+		mutex_lock(&mali_dma_buf_idle_lock);
+		list_add(&mem->idle_link, &mali_dma_buf_idle);
+		mali_dma_buf_num_idle++;
+		mali_dma_buf_idle_pages += mem->num_pages;
+		mutex_unlock(&mali_dma_buf_idle_lock);
 	}
 
 	mutex_unlock(&mem->map_lock);
 
-	/* Wake up any thread waiting for buffer to become unmapped */
-	wake_up_all(&mem->wait_queue);
+	if (mali_dma_buf_num_idle > (u32)mali_dma_buf_max_idle_mapped)
+	{
+		mali_dma_buf_idle_trim((u32)mali_dma_buf_max_idle_mapped, 0);
+	}
 }
 
 #if !defined(CONFIG_MALI_DMA_BUF_MAP_ON_ATTACH)
@@ -330,6 +514,7 @@ int mali_attach_dma_buf(struct mali_session_data *session, _mali_uk_attach_dma_b
 	mem->map_ref = 0;
 	mutex_init(&mem->map_lock);
 	init_waitqueue_head(&mem->wait_queue);
+	INIT_LIST_HEAD(&mem->idle_link);
 
 	mem->attachment = dma_buf_attach(mem->buf, &mali_platform_device->dev);
 	if (NULL == mem->attachment)
@@ -394,6 +579,9 @@ int mali_attach_dma_buf(struct mali_session_data *session, _mali_uk_attach_dma_b
 	}
 	_mali_osk_lock_signal(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
 
+	/* The exporter may have filled the buffer through any CPU mapping or device */
+	mali_l2_cache_mark_dirty();
+
 	/* Return stuff to user space */
 	if (0 != put_user(md, &user_arg->cookie))
 	{
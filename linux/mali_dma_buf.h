@@ -28,6 +28,10 @@ int mali_dma_buf_map(struct mali_dma_buf_attachment *mem, struct mali_session_da
 void mali_dma_buf_unmap(struct mali_dma_buf_attachment *mem);
 void mali_dma_buf_release(void *ctx, void *handle);
 
+void mali_dma_buf_init(void);
+void mali_dma_buf_term(void);
+u32 mali_dma_buf_dump_stats(char *buf, u32 size);
+
 #if !defined(CONFIG_MALI_DMA_BUF_MAP_ON_ATTACH)
 int mali_dma_buf_map_job(struct mali_pp_job *job);
 void mali_dma_buf_unmap_job(struct mali_pp_job *job);
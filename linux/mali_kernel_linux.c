@@ -34,6 +34,7 @@
 #include "mali_pm.h"
 #include "mali_kernel_license.h"
 #include "mali_dma_buf.h"
+#include "mali_userptr.h"
 #if defined(CONFIG_MALI400_INTERNAL_PROFILING)
 #include "mali_profiling_internal.h"
 #endif
@@ -60,6 +61,10 @@ extern int mali_l2_max_reads;
 module_param(mali_l2_max_reads, int, S_IRUSR | S_IRGRP | S_IROTH);
 MODULE_PARM_DESC(mali_l2_max_reads, "Maximum reads for Mali L2 cache");
 
+extern int mali_l2_clear_page_max;
+module_param(mali_l2_clear_page_max, int, S_IRUSR | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_l2_clear_page_max, "Invalidations of more pages than this clear the whole Mali L2 cache (-1 = from the cache size)");
+
 extern unsigned int mali_dedicated_mem_start;
 module_param(mali_dedicated_mem_start, uint, S_IRUSR | S_IRGRP | S_IROTH);
 MODULE_PARM_DESC(mali_dedicated_mem_start, "Physical start address of dedicated Mali GPU memory.");
@@ -86,6 +91,60 @@ extern int mali_max_pp_cores_group_2;
 module_param(mali_max_pp_cores_group_2, int, S_IRUSR | S_IRGRP | S_IROTH);
 MODULE_PARM_DESC(mali_max_pp_cores_group_2, "Limit the number of PP cores to use from second PP group (Mali-450 only).");
 
+extern int mali_adaptive_job_timeout_min_ms;
+module_param(mali_adaptive_job_timeout_min_ms, int, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_adaptive_job_timeout_min_ms, "Shortest job timeout in msecs when timeouts are derived from the observed job runtimes of a session (0 = always use mali_max_job_runtime).");
+
+extern int mali_pp_poll_threshold;
+module_param(mali_pp_poll_threshold, int, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_pp_poll_threshold, "Number of PP job completions within 10 ms above which job completion is polled for instead of interrupt driven (0 = always use interrupts).");
+
+extern int mali_pp_poll_interval_us;
+module_param(mali_pp_poll_interval_us, int, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_pp_poll_interval_us, "Time in usecs between two polls of the PP cores for job completion.");
+
+extern int mali_session_quota_period_ms;
+module_param(mali_session_quota_period_ms, int, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_session_quota_period_ms, "Length in msecs of the period GPU time quotas are given for.");
+
+extern int mali_session_gp_quota_ms;
+module_param(mali_session_gp_quota_ms, int, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_session_gp_quota_ms, "GP time in msecs each session may use per period before its jobs are deferred (0 = no quota).");
+
+extern int mali_session_pp_quota_ms;
+module_param(mali_session_pp_quota_ms, int, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_session_pp_quota_ms, "PP time in msecs each session may use per period before its jobs are deferred, summed over all cores (0 = no quota).");
+
+extern int mali_cpu_map_on_demand;
+module_param(mali_cpu_map_on_demand, int, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_cpu_map_on_demand, "Map OS memory pages into the CPU address space of the process on first CPU access instead of at allocation time.");
+
+extern int mali_page_pool_high_watermark;
+module_param(mali_page_pool_high_watermark, int, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_page_pool_high_watermark, "Number of free pages the page pool may hold before it is trimmed.");
+
+extern int mali_page_pool_low_watermark;
+module_param(mali_page_pool_low_watermark, int, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_page_pool_low_watermark, "Number of free pages left in the page pool when it is trimmed.");
+
+extern int mali_page_pool_zeroed_target;
+module_param(mali_page_pool_zeroed_target, int, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_page_pool_zeroed_target, "Number of zeroed pages kept ready for allocations by the background zeroing thread.");
+
+extern int mali_free_cache_max_size;
+module_param(mali_free_cache_max_size, int, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_free_cache_max_size, "Bytes of freed memory each session keeps for reuse by allocations of the same size (0 = release freed memory right away).");
+
+extern int mali_free_cache_max_age_ms;
+module_param(mali_free_cache_max_age_ms, int, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_free_cache_max_age_ms, "Time in msecs freed memory is kept for reuse.");
+
+#if defined(CONFIG_DMA_SHARED_BUFFER)
+extern int mali_dma_buf_max_idle_mapped;
+module_param(mali_dma_buf_max_idle_mapped, int, S_IRUSR | S_IWUSR | S_IWGRP | S_IRGRP | S_IROTH);
+MODULE_PARM_DESC(mali_dma_buf_max_idle_mapped, "Number of dma-buf attachments kept mapped after their last job (0 = unmap after each job).");
+#endif
+
 /* Export symbols from common code: mali_user_settings.c */
 #include "mali_user_settings_db.h"
 EXPORT_SYMBOL(mali_set_user_setting);
@@ -205,12 +264,18 @@ int mali_module_init(void)
 
 	/* Initialize module wide settings */
 	mali_osk_low_level_mem_init();
+#if defined(CONFIG_DMA_SHARED_BUFFER)
+	mali_dma_buf_init();
+#endif
 
 #if defined(MALI_FAKE_PLATFORM_DEVICE)
 	MALI_DEBUG_PRINT(2, ("mali_module_init() registering device\n"));
 	err = mali_platform_device_register();
 	if (0 != err)
 	{
+#if defined(CONFIG_DMA_SHARED_BUFFER)
+		mali_dma_buf_term();
+#endif
 		return err;
 	}
 #endif
@@ -224,6 +289,9 @@ int mali_module_init(void)
 		MALI_DEBUG_PRINT(2, ("mali_module_init() Failed to register driver (%d)\n", err));
 #if defined(MALI_FAKE_PLATFORM_DEVICE)
 		mali_platform_device_unregister();
+#endif
+#if defined(CONFIG_DMA_SHARED_BUFFER)
+		mali_dma_buf_term();
 #endif
 		mali_platform_device = NULL;
 		return err;
@@ -260,6 +328,9 @@ void mali_module_exit(void)
 	mali_platform_device_unregister();
 #endif
 
+#if defined(CONFIG_DMA_SHARED_BUFFER)
+	mali_dma_buf_term();
+#endif
 	mali_osk_low_level_mem_term();
 
 	MALI_PRINT(("Mali device driver unloaded\n"));
@@ -604,6 +675,42 @@ static int mali_ioctl(struct inode *inode, struct file *filp, unsigned int cmd,
 			err = mem_write_safe_wrapper(session_data, (_mali_uk_mem_write_safe_s __user *)arg);
 			break;
 
+		case MALI_IOC_MEM_ALLOC_VA:
+			err = mem_alloc_va_wrapper(session_data, (_mali_uk_mem_alloc_va_s __user *)arg);
+			break;
+
+		case MALI_IOC_MEM_FREE_VA:
+			err = mem_free_va_wrapper(session_data, (_mali_uk_mem_free_va_s __user *)arg);
+			break;
+
+		case MALI_IOC_MEM_COMMIT:
+			err = mem_commit_wrapper(session_data, (_mali_uk_mem_commit_s __user *)arg, MALI_TRUE);
+			break;
+
+		case MALI_IOC_MEM_DECOMMIT:
+			err = mem_commit_wrapper(session_data, (_mali_uk_mem_commit_s __user *)arg, MALI_FALSE);
+			break;
+
+		case MALI_IOC_MEM_SET_PURGEABLE:
+			err = mem_set_purgeable_wrapper(session_data, (_mali_uk_mem_set_purgeable_s __user *)arg);
+			break;
+
+		case MALI_IOC_MEM_FREE_BATCH:
+			err = mem_free_batch_wrapper(session_data, (_mali_uk_mem_free_batch_s __user *)arg);
+			break;
+
+		case MALI_IOC_MEM_SUBALLOC:
+			err = mem_suballoc_wrapper(session_data, (_mali_uk_mem_suballoc_s __user *)arg);
+			break;
+
+		case MALI_IOC_MEM_SUBFREE:
+			err = mem_subfree_wrapper(session_data, (_mali_uk_mem_subfree_s __user *)arg);
+			break;
+
+		case MALI_IOC_MEM_SYNC:
+			err = mem_sync_wrapper(session_data, (_mali_uk_mem_sync_s __user *)arg);
+			break;
+
 		case MALI_IOC_MEM_MAP_EXT:
 			err = mem_map_ext_wrapper(session_data, (_mali_uk_map_external_mem_s __user *)arg);
 			break;
@@ -661,6 +768,14 @@ static int mali_ioctl(struct inode *inode, struct file *filp, unsigned int cmd,
 			break;
 #endif
 
+		case MALI_IOC_MEM_ATTACH_USERPTR:
+			err = mali_attach_userptr(session_data, (_mali_uk_attach_userptr_s __user *)arg);
+			break;
+
+		case MALI_IOC_MEM_RELEASE_USERPTR:
+			err = mali_release_userptr(session_data, (_mali_uk_release_userptr_s __user *)arg);
+			break;
+
 		case MALI_IOC_PP_START_JOB:
 			err = pp_start_job_wrapper(session_data, (_mali_uk_pp_start_job_s __user *)arg);
 			break;
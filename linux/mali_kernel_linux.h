@@ -29,6 +29,7 @@ extern struct workqueue_struct * mali_wq;
 
 void mali_osk_low_level_mem_init(void);
 void mali_osk_low_level_mem_term(void);
+u32 mali_osk_low_level_mem_dump_stats(char *buf, u32 size);
 
 #ifdef __cplusplus
 }
@@ -49,6 +49,13 @@
 #include "mali_gp_job.h"
 #include "mali_pp_job.h"
 #include "mali_pp_scheduler.h"
+#include "mali_session.h"
+#include "mali_kernel_linux.h"
+#include "mali_kernel_memory_engine.h"
+#include "mali_memory.h"
+#if defined(CONFIG_DMA_SHARED_BUFFER)
+#include "mali_dma_buf.h"
+#endif
 
 #define POWER_BUFFER_SIZE 3
 
@@ -862,6 +869,274 @@ static const struct file_operations mali_seq_internal_state_fops = {
 };
 #endif /* MALI_STATE_TRACKING */
 
+static int mali_seq_session_gpu_time_show(struct seq_file *seq_file, void *v)
+{
+	u32 len;
+	u32 size;
+	char *buf;
+
+	size = seq_get_buf(seq_file, &buf);
+
+	if(!size)
+	{
+			return -ENOMEM;
+	}
+
+	len = mali_session_dump_gpu_time(buf, size);
+
+	seq_commit(seq_file, len);
+
+	return 0;
+}
+
+static int mali_seq_session_gpu_time_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mali_seq_session_gpu_time_show, NULL);
+}
+
+static const struct file_operations mali_seq_session_gpu_time_fops = {
+	.owner = THIS_MODULE,
+	.open = mali_seq_session_gpu_time_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int mali_seq_session_va_show(struct seq_file *seq_file, void *v)
+{
+	u32 len;
+	u32 size;
+	char *buf;
+
+	size = seq_get_buf(seq_file, &buf);
+
+	if(!size)
+	{
+			return -ENOMEM;
+	}
+
+	len = mali_memory_dump_va_stats(buf, size);
+
+	seq_commit(seq_file, len);
+
+	return 0;
+}
+
+static int mali_seq_session_va_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mali_seq_session_va_show, NULL);
+}
+
+static const struct file_operations mali_seq_session_va_fops = {
+	.owner = THIS_MODULE,
+	.open = mali_seq_session_va_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int mali_seq_slab_stats_show(struct seq_file *seq_file, void *v)
+{
+	u32 len;
+	u32 size;
+	char *buf;
+
+	size = seq_get_buf(seq_file, &buf);
+
+	if(!size)
+	{
+			return -ENOMEM;
+	}
+
+	len = mali_memory_dump_slab_stats(buf, size);
+
+	seq_commit(seq_file, len);
+
+	return 0;
+}
+
+static int mali_seq_slab_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mali_seq_slab_stats_show, NULL);
+}
+
+static const struct file_operations mali_seq_slab_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = mali_seq_slab_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+#if defined(CONFIG_DMA_SHARED_BUFFER)
+static int mali_seq_dma_buf_stats_show(struct seq_file *seq_file, void *v)
+{
+	u32 len;
+	u32 size;
+	char *buf;
+
+	size = seq_get_buf(seq_file, &buf);
+
+	if(!size)
+	{
+			return -ENOMEM;
+	}
+
+	len = mali_dma_buf_dump_stats(buf, size);
+
+	seq_commit(seq_file, len);
+
+	return 0;
+}
+
+static int mali_seq_dma_buf_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mali_seq_dma_buf_stats_show, NULL);
+}
+
+static const struct file_operations mali_seq_dma_buf_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = mali_seq_dma_buf_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
+static int mali_seq_l2_cache_stats_show(struct seq_file *seq_file, void *v)
+{
+	u32 len;
+	u32 size;
+	char *buf;
+
+	size = seq_get_buf(seq_file, &buf);
+
+	if(!size)
+	{
+			return -ENOMEM;
+	}
+
+	len = mali_l2_cache_dump_stats(buf, size);
+
+	seq_commit(seq_file, len);
+
+	return 0;
+}
+
+static int mali_seq_l2_cache_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mali_seq_l2_cache_stats_show, NULL);
+}
+
+static const struct file_operations mali_seq_l2_cache_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = mali_seq_l2_cache_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+#if defined(DEBUG)
+static int mali_seq_mmu_benchmark_show(struct seq_file *seq_file, void *v)
+{
+	u32 len;
+	u32 size;
+	char *buf;
+
+	size = seq_get_buf(seq_file, &buf);
+
+	if(!size)
+	{
+			return -ENOMEM;
+	}
+
+	len = mali_mmu_pagedir_benchmark(buf, size);
+
+	seq_commit(seq_file, len);
+
+	return 0;
+}
+
+static int mali_seq_mmu_benchmark_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mali_seq_mmu_benchmark_show, NULL);
+}
+
+static const struct file_operations mali_seq_mmu_benchmark_fops = {
+	.owner = THIS_MODULE,
+	.open = mali_seq_mmu_benchmark_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
+static int mali_seq_pp_poll_stats_show(struct seq_file *seq_file, void *v)
+{
+	u32 len;
+	u32 size;
+	char *buf;
+
+	size = seq_get_buf(seq_file, &buf);
+
+	if(!size)
+	{
+			return -ENOMEM;
+	}
+
+	len = mali_group_dump_pp_poll_stats(buf, size);
+
+	seq_commit(seq_file, len);
+
+	return 0;
+}
+
+static int mali_seq_pp_poll_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mali_seq_pp_poll_stats_show, NULL);
+}
+
+static const struct file_operations mali_seq_pp_poll_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = mali_seq_pp_poll_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int mali_seq_memory_pages_show(struct seq_file *seq_file, void *v)
+{
+	u32 len;
+	u32 size;
+	char *buf;
+
+	size = seq_get_buf(seq_file, &buf);
+
+	if(!size)
+	{
+			return -ENOMEM;
+	}
+
+	len = mali_osk_low_level_mem_dump_stats(buf, size);
+
+	seq_commit(seq_file, len);
+
+	return 0;
+}
+
+static int mali_seq_memory_pages_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mali_seq_memory_pages_show, NULL);
+}
+
+static const struct file_operations mali_seq_memory_pages_fops = {
+	.owner = THIS_MODULE,
+	.open = mali_seq_memory_pages_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 #if defined(CONFIG_MALI400_INTERNAL_PROFILING)
 static ssize_t profiling_record_read(struct file *filp, char __user *ubuf, size_t cnt, loff_t *ppos)
 {
@@ -1571,6 +1846,7 @@ int mali_sysfs_register(const char *mali_dev_name)
 
 				debugfs_create_file("num_cores_total", 0400, mali_pp_dir, NULL, &pp_num_cores_total_fops);
 				debugfs_create_file("num_cores_enabled", 0600, mali_pp_dir, NULL, &pp_num_cores_enabled_fops);
+				debugfs_create_file("poll_stats", 0400, mali_pp_dir, NULL, &mali_seq_pp_poll_stats_fops);
 
 				mali_pp_all_dir = debugfs_create_dir("all", mali_pp_dir);
 				if (mali_pp_all_dir != NULL)
@@ -1641,6 +1917,7 @@ int mali_sysfs_register(const char *mali_dev_name)
 			}
 
 			debugfs_create_file("memory_usage", 0400, mali_debugfs_dir, NULL, &memory_usage_fops);
+			debugfs_create_file("memory_pages", 0400, mali_debugfs_dir, NULL, &mali_seq_memory_pages_fops);
 
 			debugfs_create_file("utilization_gp_pp", 0400, mali_debugfs_dir, NULL, &utilization_gp_pp_fops);
 			debugfs_create_file("utilization_gp", 0400, mali_debugfs_dir, NULL, &utilization_gp_fops);
@@ -1669,6 +1946,17 @@ int mali_sysfs_register(const char *mali_dev_name)
 			debugfs_create_file("state_dump", 0400, mali_debugfs_dir, NULL, &mali_seq_internal_state_fops);
 #endif
 
+			debugfs_create_file("session_gpu_time", 0400, mali_debugfs_dir, NULL, &mali_seq_session_gpu_time_fops);
+			debugfs_create_file("session_va", 0400, mali_debugfs_dir, NULL, &mali_seq_session_va_fops);
+			debugfs_create_file("slab_stats", 0400, mali_debugfs_dir, NULL, &mali_seq_slab_stats_fops);
+#if defined(DEBUG)
+			debugfs_create_file("mmu_benchmark", 0400, mali_debugfs_dir, NULL, &mali_seq_mmu_benchmark_fops);
+#endif
+			debugfs_create_file("l2_cache_stats", 0400, mali_debugfs_dir, NULL, &mali_seq_l2_cache_stats_fops);
+#if defined(CONFIG_DMA_SHARED_BUFFER)
+			debugfs_create_file("dma_buf_stats", 0400, mali_debugfs_dir, NULL, &mali_seq_dma_buf_stats_fops);
+#endif
+
 			if (mali_sysfs_user_settings_register())
 			{
 				/* Failed to create the debugfs entries for the user settings DB. */
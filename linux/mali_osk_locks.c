@@ -231,6 +231,76 @@ _mali_osk_errcode_t _mali_osk_lock_wait( _mali_osk_lock_t *lock, _mali_osk_lock_
     return err;
 }
 
+_mali_osk_errcode_t _mali_osk_lock_trywait( _mali_osk_lock_t *lock, _mali_osk_lock_mode_t mode)
+{
+	int obtained = 0;
+
+	/* Parameter validation */
+	MALI_DEBUG_ASSERT_POINTER( lock );
+
+	MALI_DEBUG_ASSERT( _MALI_OSK_LOCKMODE_RW == mode
+					 || _MALI_OSK_LOCKMODE_RO == mode );
+
+	MALI_DEBUG_ASSERT( _MALI_OSK_LOCKMODE_RW == mode
+					 || (_MALI_OSK_LOCKMODE_RO == mode && (_MALI_OSK_LOCKFLAG_READERWRITER & lock->orig_flags)) );
+
+	switch ( lock->type )
+	{
+	case _MALI_OSK_INTERNAL_LOCKTYPE_SPIN:
+		obtained = spin_trylock(&lock->obj.spinlock);
+		break;
+	case _MALI_OSK_INTERNAL_LOCKTYPE_SPIN_IRQ:
+		{
+			unsigned long tmp_flags;
+			obtained = spin_trylock_irqsave(&lock->obj.spinlock, tmp_flags);
+			if (obtained)
+			{
+				lock->flags = tmp_flags;
+			}
+		}
+		break;
+
+	case _MALI_OSK_INTERNAL_LOCKTYPE_MUTEX:
+		/* FALLTHROUGH */
+	case _MALI_OSK_INTERNAL_LOCKTYPE_MUTEX_NONINT:
+		obtained = mutex_trylock(&lock->obj.mutex);
+		break;
+
+	case _MALI_OSK_INTERNAL_LOCKTYPE_MUTEX_NONINT_RW:
+		if (mode == _MALI_OSK_LOCKMODE_RO)
+		{
+			obtained = down_read_trylock(&lock->obj.rw_sema);
+		}
+		else
+		{
+			obtained = down_write_trylock(&lock->obj.rw_sema);
+		}
+		break;
+
+	default:
+		/* Reaching here indicates a programming error, so you will not get here
+		 * on non-DEBUG builds */
+		MALI_DEBUG_PRINT_ERROR( ("Invalid internal lock type: %.8X", lock->type ) );
+		break;
+	}
+
+	if (!obtained)
+	{
+		return _MALI_OSK_ERR_BUSY;
+	}
+
+#ifdef DEBUG
+	/* This thread is now the owner of this lock */
+	if (mode == _MALI_OSK_LOCKMODE_RW)
+	{
+		lock->owner = _mali_osk_get_tid();
+	}
+	lock->mode = mode;
+#endif
+
+	return _MALI_OSK_ERR_OK;
+}
+
 void _mali_osk_lock_signal( _mali_osk_lock_t *lock, _mali_osk_lock_mode_t mode )
 {
 	/* Parameter validation */
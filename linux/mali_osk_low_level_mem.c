@@ -28,11 +28,17 @@
 #include <linux/sched.h>
 #include <linux/mm_types.h>
 #include <linux/rwsem.h>
+#include <linux/vmalloc.h>
+#include <linux/percpu.h>
+#include <linux/list.h>
+#include <linux/kthread.h>
+#include <linux/highmem.h>
 
 #include "mali_osk.h"
 #include "mali_ukk.h" /* required to hook in _mali_ukk_mem_mmap handling */
 #include "mali_kernel_common.h"
 #include "mali_kernel_linux.h"
+#include "mali_userptr.h"
 
 static void mali_kernel_memory_vma_open(struct vm_area_struct * vma);
 static void mali_kernel_memory_vma_close(struct vm_area_struct * vma);
@@ -61,6 +67,7 @@ struct AllocationList
 	struct AllocationList *next;
 	u32 offset;
 	u32 physaddr;
+	u32 order; /**< The item is a run of 2^order physically contiguous pages */
 };
 
 typedef struct AllocationList AllocationList;
@@ -70,9 +77,11 @@ typedef struct AllocationList AllocationList;
  */
 struct MappingInfo
 {
-	struct vm_area_struct *vma;
+	struct vm_area_struct *vma; /**< NULL once the vma is closed, the memory may be released after that */
+	mali_vma_usage_tracker *vma_usage_tracker;
 	struct AllocationList *list;
 	struct AllocationList *tail;
+	u32 *pages; /**< Physical address of the OS allocated page at each page offset, or INVALID_PAGE. NULL unless the CPU mapping is made on demand */
 };
 
 typedef struct MappingInfo MappingInfo;
@@ -80,20 +89,97 @@ typedef struct MappingInfo MappingInfo;
 
 static u32 _kernel_page_allocate(void);
 static void _kernel_page_release(u32 physical_address);
+static u32 _kernel_pages_allocate(u32 order);
+static void _kernel_pages_release(u32 physical_address, u32 order);
+static void _page_list_release(struct list_head *pages);
+static u32 _page_pool_get(void);
+static void _page_pool_put(u32 physical_address);
+static u32 _page_list_move(struct list_head *src, struct list_head *dst, u32 count);
+static int _page_prezero_thread_func(void *data);
 static AllocationList * _allocation_list_item_get(void);
+static u32 _allocation_list_items_get(u32 count, AllocationList **head, u32 max_order);
 static void _allocation_list_item_release(AllocationList * item);
 
 
 /* Variable declarations */
-static DEFINE_SPINLOCK(allocation_list_spinlock);
-static AllocationList * pre_allocated_memory = (AllocationList*) NULL ;
-static int pre_allocated_memory_size_current  = 0;
+int mali_cpu_map_on_demand = 1; /* Insert OS allocated pages into the CPU mapping on first CPU access */
+
+/*
+ * Large allocations are made of runs of physically contiguous pages where
+ * possible, from 64 KiB up to 1 MiB. This gives fewer list items and better
+ * DRAM locality for the GPU. Runs are returned to the kernel as a whole,
+ * only single pages are kept in the page pool.
+ */
+#ifndef MALI_OS_MEMORY_MIN_RUN_ORDER
+#define MALI_OS_MEMORY_MIN_RUN_ORDER 4
+#endif
+#ifndef MALI_OS_MEMORY_MAX_RUN_ORDER
+#define MALI_OS_MEMORY_MAX_RUN_ORDER 8
+#endif
+
+static atomic_t mali_os_memory_runs[MALI_OS_MEMORY_MAX_RUN_ORDER + 1];         /* Runs allocated from the kernel, per order */
+static atomic_t mali_os_memory_run_failures[MALI_OS_MEMORY_MAX_RUN_ORDER + 1]; /* Failed attempts to allocate runs, per order */
+static atomic_t mali_os_memory_pool_pages;                                     /* Single pages taken from the page pool */
+
+/*
+ * Free single pages are kept in a pool for reuse. Each CPU has a small
+ * magazine of pages which is refilled from, and flushed to, a global depot
+ * in batches, so allocating processes on different CPUs rarely touch the
+ * depot lock. Free pages are linked through their struct page, no memory is
+ * allocated to pool them.
+ *
+ * When the depot grows beyond the high watermark it is trimmed to the low
+ * watermark, the shrinker may empty it completely.
+ */
+#ifndef MALI_PAGE_MAGAZINE_SIZE
+#define MALI_PAGE_MAGAZINE_SIZE 64
+#endif
+#define MALI_PAGE_MAGAZINE_BATCH (MALI_PAGE_MAGAZINE_SIZE / 2)
+
 #ifdef MALI_OS_MEMORY_KERNEL_BUFFER_SIZE_IN_MB
-	static int pre_allocated_memory_size_max      = MALI_OS_MEMORY_KERNEL_BUFFER_SIZE_IN_MB * 1024 * 1024;
+#define MALI_PAGE_POOL_HIGH_WATERMARK (MALI_OS_MEMORY_KERNEL_BUFFER_SIZE_IN_MB * (1024 * 1024 / PAGE_SIZE))
 #else
-	static int pre_allocated_memory_size_max      = 16 * 1024 * 1024; /* 6 MiB */
+#define MALI_PAGE_POOL_HIGH_WATERMARK (16 * (1024 * 1024 / PAGE_SIZE)) /* 16 MiB */
+#endif
+
+int mali_page_pool_high_watermark = MALI_PAGE_POOL_HIGH_WATERMARK;    /* Depot size in pages above which it is trimmed */
+int mali_page_pool_low_watermark = MALI_PAGE_POOL_HIGH_WATERMARK / 2; /* Depot size in pages it is trimmed to */
+
+struct mali_page_magazine
+{
+	struct list_head pages;  /**< Freed pages, linked through page->lru */
+	u32 count;               /**< Number of freed pages in the magazine */
+	struct list_head zeroed; /**< Zeroed pages, ready to be handed to the GPU */
+	u32 zeroed_count;        /**< Number of zeroed pages in the magazine */
+};
+
+static DEFINE_PER_CPU(struct mali_page_magazine, mali_page_magazines);
+
+static DEFINE_SPINLOCK(page_pool_depot_lock);
+static LIST_HEAD(page_pool_depot);
+static u32 page_pool_depot_count = 0;
+
+/*
+ * Pages handed to the GPU must be zeroed. Rather than doing that when the
+ * memory is allocated, a background thread zeroes freed pages from the depot
+ * into a reservoir of ready pages, up to a target size.
+ */
+#ifndef MALI_PAGE_POOL_ZEROED_TARGET
+#define MALI_PAGE_POOL_ZEROED_TARGET (4 * (1024 * 1024 / PAGE_SIZE)) /* 4 MiB */
 #endif
 
+int mali_page_pool_zeroed_target = MALI_PAGE_POOL_ZEROED_TARGET; /* Number of zeroed pages to keep ready */
+
+static LIST_HEAD(page_pool_zeroed); /* Also protected by page_pool_depot_lock */
+static u32 page_pool_zeroed_count = 0;
+static struct task_struct *page_prezero_thread = NULL;
+static mali_bool page_prezero_backoff = MALI_FALSE; /* Set by the shrinker, no refilling until an allocation finds the reservoir empty */
+
+static atomic_t mali_page_pool_refills;       /* Magazine refills from the depot or reservoir */
+static atomic_t mali_page_pool_flushes;       /* Magazine flushes to the depot */
+static atomic_t mali_page_pool_prezeroed;     /* Pages zeroed in the background */
+static atomic_t mali_page_pool_zeroed_inline; /* Pages zeroed when allocated */
+
 static struct vm_operations_struct mali_kernel_vm_ops =
 {
 	.open = mali_kernel_memory_vma_open,
@@ -116,7 +202,8 @@ static int mali_mem_shrink(struct shrinker *shrinker, struct shrink_control *sc)
 #endif
 {
 	unsigned long flags;
-	AllocationList *item;
+	LIST_HEAD(free_pages);
+	u32 n;
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,0,0)
 	int nr = nr_to_scan;
 #else
@@ -125,35 +212,35 @@ static int mali_mem_shrink(struct shrinker *shrinker, struct shrink_control *sc)
 
 	if (0 == nr)
 	{
-		return pre_allocated_memory_size_current / PAGE_SIZE;
+		return page_pool_depot_count + page_pool_zeroed_count;
 	}
 
-	if (0 == pre_allocated_memory_size_current)
+	if (0 == page_pool_depot_count + page_pool_zeroed_count)
 	{
 		/* No pages availble */
 		return 0;
 	}
 
-	if (0 == spin_trylock_irqsave(&allocation_list_spinlock, flags))
+	if (0 == spin_trylock_irqsave(&page_pool_depot_lock, flags))
 	{
 		/* Not able to lock. */
 		return -1;
 	}
 
-	while (pre_allocated_memory && nr > 0)
-	{
-		item = pre_allocated_memory;
-		pre_allocated_memory = item->next;
+	/* Freed pages first, the zeroed ones have had work put into them */
+	n = _page_list_move(&page_pool_depot, &free_pages, nr);
+	page_pool_depot_count -= n;
+	nr -= n;
+	n = _page_list_move(&page_pool_zeroed, &free_pages, nr);
+	page_pool_zeroed_count -= n;
+	/* Don't let the prezero thread undo the shrink right away */
+	page_prezero_backoff = MALI_TRUE;
+	spin_unlock_irqrestore(&page_pool_depot_lock,flags);
 
-		_kernel_page_release(item->physaddr);
-		_mali_osk_free(item);
-
-		pre_allocated_memory_size_current -= PAGE_SIZE;
-		--nr;
-	}
-	spin_unlock_irqrestore(&allocation_list_spinlock,flags);
+	/* Give the pages back to the kernel without holding the lock */
+	_page_list_release(&free_pages);
 
-	return pre_allocated_memory_size_current / PAGE_SIZE;
+	return page_pool_depot_count + page_pool_zeroed_count;
 }
 
 struct shrinker mali_mem_shrinker = {
@@ -161,26 +248,193 @@ struct shrinker mali_mem_shrinker = {
 	.seeks = DEFAULT_SEEKS,
 };
 
+struct _mali_osk_shrinker_t_struct
+{
+	struct shrinker shrinker;
+	_mali_osk_shrinker_callback_t callback;
+	void *data;
+};
+
+/* Kernels before 2.6.35 don't tell the callback which shrinker is called, these shrinkers are not registered there */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35)
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,0,0)
+static int _mali_osk_shrinker_shrink(struct shrinker *shrinker, int nr_to_scan, gfp_t gfp_mask)
+#else
+static int _mali_osk_shrinker_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+#endif
+{
+	_mali_osk_shrinker_t *osk_shrinker = container_of(shrinker, _mali_osk_shrinker_t, shrinker);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,0,0)
+	int nr = nr_to_scan;
+#else
+	int nr = sc->nr_to_scan;
+#endif
+
+	return osk_shrinker->callback((nr > 0) ? nr : 0, osk_shrinker->data);
+}
+#endif
+
+_mali_osk_shrinker_t *_mali_osk_shrinker_register( _mali_osk_shrinker_callback_t callback, void *data )
+{
+	_mali_osk_shrinker_t *osk_shrinker;
+
+	MALI_DEBUG_ASSERT_POINTER(callback);
+
+	osk_shrinker = kzalloc(sizeof(_mali_osk_shrinker_t), GFP_KERNEL);
+	if (NULL == osk_shrinker)
+	{
+		return NULL;
+	}
+
+	osk_shrinker->callback = callback;
+	osk_shrinker->data = data;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35)
+	osk_shrinker->shrinker.shrink = _mali_osk_shrinker_shrink;
+	osk_shrinker->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&osk_shrinker->shrinker);
+#endif
+
+	return osk_shrinker;
+}
+
+void _mali_osk_shrinker_unregister( _mali_osk_shrinker_t *osk_shrinker )
+{
+	MALI_DEBUG_ASSERT_POINTER(osk_shrinker);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35)
+	unregister_shrinker(&osk_shrinker->shrinker);
+#endif
+	kfree(osk_shrinker);
+}
+
 void mali_osk_low_level_mem_init(void)
 {
-	pre_allocated_memory = (AllocationList*) NULL ;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+	{
+		struct mali_page_magazine *magazine = &per_cpu(mali_page_magazines, cpu);
+		INIT_LIST_HEAD(&magazine->pages);
+		magazine->count = 0;
+		INIT_LIST_HEAD(&magazine->zeroed);
+		magazine->zeroed_count = 0;
+	}
 
 	register_shrinker(&mali_mem_shrinker);
+
+	page_prezero_thread = kthread_run(_page_prezero_thread_func, NULL, "mali_prezero");
+	if (IS_ERR(page_prezero_thread))
+	{
+		/* Not fatal, pages are then zeroed when allocated */
+		MALI_PRINT_ERROR(("Unable to start page zeroing thread\n"));
+		page_prezero_thread = NULL;
+	}
+}
+
+static void _page_list_release(struct list_head *pages)
+{
+	struct page *page;
+	struct page *tmp;
+
+	list_for_each_entry_safe(page, tmp, pages, lru)
+	{
+		list_del(&page->lru);
+		_kernel_page_release(page_to_phys(page));
+	}
 }
 
 void mali_osk_low_level_mem_term(void)
 {
+	int cpu;
+
+	if (NULL != page_prezero_thread)
+	{
+		kthread_stop(page_prezero_thread);
+		page_prezero_thread = NULL;
+	}
+
 	unregister_shrinker(&mali_mem_shrinker);
 
-	while ( NULL != pre_allocated_memory )
+	for_each_possible_cpu(cpu)
 	{
-		AllocationList *item;
-		item = pre_allocated_memory;
-		pre_allocated_memory = item->next;
-		_kernel_page_release(item->physaddr);
-		_mali_osk_free( item );
+		struct mali_page_magazine *magazine = &per_cpu(mali_page_magazines, cpu);
+		_page_list_release(&magazine->pages);
+		magazine->count = 0;
+		_page_list_release(&magazine->zeroed);
+		magazine->zeroed_count = 0;
+	}
+
+	_page_list_release(&page_pool_depot);
+	page_pool_depot_count = 0;
+	_page_list_release(&page_pool_zeroed);
+	page_pool_zeroed_count = 0;
+}
+
+u32 mali_osk_low_level_mem_dump_stats(char *buf, u32 size)
+{
+	u32 n = 0;
+	u32 order;
+
+	n += _mali_osk_snprintf(buf + n, size - n, "order  pages  runs        failures\n");
+	for (order = 0; order <= MALI_OS_MEMORY_MAX_RUN_ORDER && n < size; order++)
+	{
+		if (0 != order && order < MALI_OS_MEMORY_MIN_RUN_ORDER)
+		{
+			continue;
+		}
+
+		n += _mali_osk_snprintf(buf + n, size - n, "%-6u %-6u %-11u %u\n",
+		                        order, 1 << order,
+		                        atomic_read(&mali_os_memory_runs[order]),
+		                        atomic_read(&mali_os_memory_run_failures[order]));
+	}
+
+	if (n < size)
+	{
+		n += _mali_osk_snprintf(buf + n, size - n, "pool pages: %u\n", atomic_read(&mali_os_memory_pool_pages));
+	}
+	if (n < size)
+	{
+		n += _mali_osk_snprintf(buf + n, size - n, "pool depot: %u pages, %u refills, %u flushes\n",
+		                        page_pool_depot_count,
+		                        atomic_read(&mali_page_pool_refills),
+		                        atomic_read(&mali_page_pool_flushes));
+	}
+	if (n < size)
+	{
+		n += _mali_osk_snprintf(buf + n, size - n, "pool zeroed: %u pages, %u zeroed in background, %u zeroed inline\n",
+		                        page_pool_zeroed_count,
+		                        atomic_read(&mali_page_pool_prezeroed),
+		                        atomic_read(&mali_page_pool_zeroed_inline));
 	}
-	pre_allocated_memory_size_current  = 0;
+
+	return (n < size) ? n : size;
+}
+
+static u32 _kernel_pages_allocate(u32 order)
+{
+	struct page *new_page;
+	u32 linux_phys_addr;
+
+	/* Runs are opportunistic, don't retry or compact hard for them */
+	new_page = alloc_pages(GFP_HIGHUSER | __GFP_ZERO | __GFP_NORETRY | __GFP_NOWARN | __GFP_COLD, order);
+
+	if ( NULL == new_page )
+	{
+		return INVALID_PAGE;
+	}
+
+	/* Ensure pages are flushed from CPU caches. */
+	linux_phys_addr = dma_map_page(NULL, new_page, 0, PAGE_SIZE << order, DMA_BIDIRECTIONAL);
+
+	return linux_phys_addr;
+}
+
+static void _kernel_pages_release(u32 physical_address, u32 order)
+{
+	dma_unmap_page(NULL, physical_address, PAGE_SIZE << order, DMA_BIDIRECTIONAL);
+	__free_pages(pfn_to_page(physical_address >> PAGE_SHIFT), order);
 }
 
 static u32 _kernel_page_allocate(void)
@@ -209,60 +463,430 @@ static void _kernel_page_release(u32 physical_address)
 	dma_unmap_page(NULL, physical_address, PAGE_SIZE, DMA_BIDIRECTIONAL);
 	#endif
 
-	unmap_page = pfn_to_page( physical_address >> PAGE_SHIFT );
-	MALI_DEBUG_ASSERT_POINTER( unmap_page );
-	__free_page( unmap_page );
+	unmap_page = pfn_to_page( physical_address >> PAGE_SHIFT );
+	MALI_DEBUG_ASSERT_POINTER( unmap_page );
+	__free_page( unmap_page );
+}
+
+/* Zero a freed page and clean it from the CPU caches for the GPU */
+static void _page_zero(struct page *page)
+{
+	clear_highpage(page);
+	dma_sync_single_for_device(NULL, page_to_phys(page), PAGE_SIZE, DMA_BIDIRECTIONAL);
+}
+
+static void _page_prezero_kick(void)
+{
+	if (NULL != page_prezero_thread && MALI_FALSE == page_prezero_backoff && page_pool_zeroed_count < mali_page_pool_zeroed_target)
+	{
+		wake_up_process(page_prezero_thread);
+	}
+}
+
+/* Move up to count pages from the head of list src to dst */
+static u32 _page_list_move(struct list_head *src, struct list_head *dst, u32 count)
+{
+	u32 n = 0;
+
+	while (n < count && !list_empty(src))
+	{
+		list_move(src->next, dst);
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * Get a zeroed page. Pages zeroed in the background are used first, then
+ * freed pages which are zeroed here. Magazines are refilled from the
+ * reservoir or the depot when empty.
+ */
+static u32 _page_pool_get(void)
+{
+	struct mali_page_magazine *magazine;
+	struct page *page = NULL;
+	mali_bool needs_zeroing = MALI_FALSE;
+	unsigned long flags;
+	u32 n;
+
+	local_irq_save(flags);
+	magazine = this_cpu_ptr(&mali_page_magazines);
+
+	if (0 == magazine->zeroed_count && 0 != page_pool_zeroed_count)
+	{
+		spin_lock(&page_pool_depot_lock);
+		n = _page_list_move(&page_pool_zeroed, &magazine->zeroed, MALI_PAGE_MAGAZINE_BATCH);
+		page_pool_zeroed_count -= n;
+		magazine->zeroed_count += n;
+		spin_unlock(&page_pool_depot_lock);
+		atomic_inc(&mali_page_pool_refills);
+	}
+
+	if (0 != magazine->zeroed_count)
+	{
+		page = list_first_entry(&magazine->zeroed, struct page, lru);
+		list_del(&page->lru);
+		magazine->zeroed_count--;
+	}
+	else
+	{
+		/* The reservoir is empty, allocations want it refilled again even after a shrink */
+		page_prezero_backoff = MALI_FALSE;
+
+		if (0 == magazine->count && 0 != page_pool_depot_count)
+		{
+			spin_lock(&page_pool_depot_lock);
+			n = _page_list_move(&page_pool_depot, &magazine->pages, MALI_PAGE_MAGAZINE_BATCH);
+			page_pool_depot_count -= n;
+			magazine->count += n;
+			spin_unlock(&page_pool_depot_lock);
+			atomic_inc(&mali_page_pool_refills);
+		}
+
+		if (0 != magazine->count)
+		{
+			page = list_first_entry(&magazine->pages, struct page, lru);
+			list_del(&page->lru);
+			magazine->count--;
+			needs_zeroing = MALI_TRUE;
+		}
+	}
+	local_irq_restore(flags);
+
+	if (MALI_TRUE == needs_zeroing)
+	{
+		/* The reservoir ran dry, zero in the allocating context */
+		_page_zero(page);
+		atomic_inc(&mali_page_pool_zeroed_inline);
+	}
+
+	_page_prezero_kick();
+
+	return (NULL != page) ? page_to_phys(page) : INVALID_PAGE;
+}
+
+/* Put a freed page into this CPU's magazine, flushing a batch to the depot when full */
+static void _page_pool_put(u32 physical_address)
+{
+	struct mali_page_magazine *magazine;
+	struct page *page = pfn_to_page(physical_address >> PAGE_SHIFT);
+	mali_bool flushed = MALI_FALSE;
+	LIST_HEAD(free_pages);
+	unsigned long flags;
+
+	local_irq_save(flags);
+	magazine = this_cpu_ptr(&mali_page_magazines);
+
+	list_add(&page->lru, &magazine->pages);
+	magazine->count++;
+
+	if (MALI_PAGE_MAGAZINE_SIZE < magazine->count)
+	{
+		u32 i;
+
+		spin_lock(&page_pool_depot_lock);
+		for (i = 0; i < MALI_PAGE_MAGAZINE_BATCH; i++)
+		{
+			/* The least recently freed pages go to the depot */
+			list_move(magazine->pages.prev, &page_pool_depot);
+		}
+		magazine->count -= MALI_PAGE_MAGAZINE_BATCH;
+		page_pool_depot_count += MALI_PAGE_MAGAZINE_BATCH;
+
+		if (page_pool_depot_count > mali_page_pool_high_watermark)
+		{
+			/* Trim to the low watermark, the coldest pages first */
+			while (page_pool_depot_count > mali_page_pool_low_watermark && !list_empty(&page_pool_depot))
+			{
+				list_move(page_pool_depot.prev, &free_pages);
+				page_pool_depot_count--;
+			}
+		}
+		spin_unlock(&page_pool_depot_lock);
+		atomic_inc(&mali_page_pool_flushes);
+		flushed = MALI_TRUE;
+	}
+	local_irq_restore(flags);
+
+	/* Give the trimmed pages back to the kernel without holding the lock */
+	_page_list_release(&free_pages);
+
+	if (MALI_TRUE == flushed)
+	{
+		_page_prezero_kick();
+	}
+}
+
+/*
+ * Zero a batch of freed pages from the depot into the reservoir. When there
+ * are no freed pages the reservoir is topped up with new pages instead.
+ * Returns the number of pages added to the reservoir.
+ */
+static u32 _page_prezero_batch(void)
+{
+	LIST_HEAD(pages);
+	struct page *page;
+	unsigned long flags;
+	u32 n;
+
+	spin_lock_irqsave(&page_pool_depot_lock, flags);
+	n = _page_list_move(&page_pool_depot, &pages, MALI_PAGE_MAGAZINE_BATCH);
+	page_pool_depot_count -= n;
+	spin_unlock_irqrestore(&page_pool_depot_lock, flags);
+
+	list_for_each_entry(page, &pages, lru)
+	{
+		_page_zero(page);
+	}
+
+	for ( ; n < MALI_PAGE_MAGAZINE_BATCH; n++)
+	{
+		/* New pages come zeroed and cleaned, don't try hard to get them */
+		u32 phys = _kernel_pages_allocate(0);
+		if (INVALID_PAGE == phys)
+		{
+			break;
+		}
+		list_add_tail(&pfn_to_page(phys >> PAGE_SHIFT)->lru, &pages);
+	}
+
+	if (0 != n)
+	{
+		spin_lock_irqsave(&page_pool_depot_lock, flags);
+		list_splice_tail(&pages, &page_pool_zeroed);
+		page_pool_zeroed_count += n;
+		spin_unlock_irqrestore(&page_pool_depot_lock, flags);
+		atomic_add(n, &mali_page_pool_prezeroed);
+	}
+
+	return n;
+}
+
+/*
+ * Keeps the reservoir of zeroed pages topped up. Runs as an idle priority
+ * thread so it only uses CPU time nothing else wants, and sleeps when the
+ * reservoir is full, no pages could be had or the shrinker has taken pages
+ * back since the reservoir last ran dry.
+ */
+static int _page_prezero_thread_func(void *data)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	mali_bool stalled = MALI_FALSE;
+
+	sched_setscheduler(current, SCHED_IDLE, &param);
+
+	for (;;)
+	{
+		set_current_state(TASK_INTERRUPTIBLE);
+
+		if (kthread_should_stop())
+		{
+			break;
+		}
+
+		if (MALI_TRUE == stalled || MALI_TRUE == page_prezero_backoff || page_pool_zeroed_count >= mali_page_pool_zeroed_target)
+		{
+			schedule();
+			stalled = MALI_FALSE;
+			continue;
+		}
+
+		__set_current_state(TASK_RUNNING);
+
+		if (0 == _page_prezero_batch())
+		{
+			stalled = MALI_TRUE;
+		}
+
+		cond_resched();
+	}
+
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+static AllocationList * _allocation_list_item_get(void)
+{
+	AllocationList *item;
+
+	item = _mali_osk_malloc( sizeof(AllocationList) );
+	if ( NULL == item)
+	{
+		return NULL;
+	}
+
+	item->physaddr = _page_pool_get();
+	if ( INVALID_PAGE != item->physaddr )
+	{
+		atomic_inc(&mali_os_memory_pool_pages);
+	}
+	else
+	{
+		item->physaddr = _kernel_page_allocate();
+		if ( INVALID_PAGE == item->physaddr )
+		{
+			/* Non-fatal error condition, out of memory. Upper levels will handle this. */
+			_mali_osk_free( item );
+			return NULL;
+		}
+		atomic_inc(&mali_os_memory_runs[0]);
+	}
+
+	item->order = 0;
+	return item;
+}
+
+/* Allocate a run of 2^order physically contiguous pages, don't try hard since smaller runs will do */
+static AllocationList * _allocation_list_run_get(u32 order)
+{
+	AllocationList *item;
+
+	item = _mali_osk_malloc( sizeof(AllocationList) );
+	if ( NULL == item)
+	{
+		return NULL;
+	}
+
+	item->physaddr = _kernel_pages_allocate(order);
+	if ( INVALID_PAGE == item->physaddr )
+	{
+		_mali_osk_free( item );
+		atomic_inc(&mali_os_memory_run_failures[order]);
+		return NULL;
+	}
+
+	item->order = order;
+	atomic_inc(&mali_os_memory_runs[order]);
+
+	return item;
+}
+
+/* Get items for up to count pages in runs of at most 2^max_order pages, returns the number of pages got */
+static u32 _allocation_list_items_get(u32 count, AllocationList **head, u32 max_order)
+{
+	AllocationList *first = NULL;
+	AllocationList *last = NULL;
+	AllocationList *item;
+	u32 n = 0;
+
+	/* Serve as much as possible with runs of contiguous pages, largest first */
+	while ( max_order >= MALI_OS_MEMORY_MIN_RUN_ORDER && count - n >= (1 << MALI_OS_MEMORY_MIN_RUN_ORDER) )
+	{
+		u32 order = max_order;
+
+		while ( (1 << order) > count - n )
+		{
+			order--;
+		}
+
+		item = NULL;
+		for ( ; order >= MALI_OS_MEMORY_MIN_RUN_ORDER; order--)
+		{
+			item = _allocation_list_run_get(order);
+			if ( NULL != item )
+			{
+				break;
+			}
+		}
+
+		if ( NULL == item )
+		{
+			/* Memory is too fragmented, fall back to single pages */
+			break;
+		}
+
+		/* Larger runs failed, do not try them again for this request */
+		max_order = order;
+
+		item->next = NULL;
+		if ( NULL == first )
+		{
+			first = item;
+		}
+		else
+		{
+			last->next = item;
+		}
+		last = item;
+		n += 1 << order;
+	}
+
+	/* Then single pages, from the page pool first */
+	for ( ; n < count; n++ )
+	{
+		item = _allocation_list_item_get();
+		if ( NULL == item)
+		{
+			break;
+		}
+
+		item->next = NULL;
+		if ( NULL == first )
+		{
+			first = item;
+		}
+		else
+		{
+			last->next = item;
+		}
+		last = item;
+	}
+
+	*head = first;
+
+	return n;
+}
+
+static void _allocation_list_item_release(AllocationList * item)
+{
+	if ( 0 != item->order )
+	{
+		/* Runs go straight back to the kernel, to keep contiguous memory available */
+		_kernel_pages_release(item->physaddr, item->order);
+	}
+	else
+	{
+		_page_pool_put(item->physaddr);
+	}
+
+	_mali_osk_free( item );
 }
 
-static AllocationList * _allocation_list_item_get(void)
+static u32 *_mapping_pages_alloc(u32 num_pages)
 {
-	AllocationList *item = NULL;
-	unsigned long flags;
+	u32 size = num_pages * sizeof(u32);
+	u32 *pages;
 
-	spin_lock_irqsave(&allocation_list_spinlock,flags);
-	if ( pre_allocated_memory )
+	/* Large allocations need a page array larger than kmalloc is good at */
+	if (size <= PAGE_SIZE)
 	{
-		item = pre_allocated_memory;
-		pre_allocated_memory = pre_allocated_memory->next;
-		pre_allocated_memory_size_current -= PAGE_SIZE;
-
-		spin_unlock_irqrestore(&allocation_list_spinlock,flags);
-		return item;
+		pages = kmalloc(size, GFP_KERNEL);
 	}
-	spin_unlock_irqrestore(&allocation_list_spinlock,flags);
-
-	item = _mali_osk_malloc( sizeof(AllocationList) );
-	if ( NULL == item)
+	else
 	{
-		return NULL;
+		pages = vmalloc(size);
 	}
 
-	item->physaddr = _kernel_page_allocate();
-	if ( INVALID_PAGE == item->physaddr )
+	if (NULL != pages)
 	{
-		/* Non-fatal error condition, out of memory. Upper levels will handle this. */
-		_mali_osk_free( item );
-		return NULL;
+		memset(pages, 0xFF, size); /* INVALID_PAGE */
 	}
-	return item;
+
+	return pages;
 }
 
-static void _allocation_list_item_release(AllocationList * item)
+static void _mapping_pages_free(u32 *pages)
 {
-	unsigned long flags;
-	spin_lock_irqsave(&allocation_list_spinlock,flags);
-	if ( pre_allocated_memory_size_current < pre_allocated_memory_size_max)
+	if (is_vmalloc_addr(pages))
 	{
-		item->next = pre_allocated_memory;
-		pre_allocated_memory = item;
-		pre_allocated_memory_size_current += PAGE_SIZE;
-		spin_unlock_irqrestore(&allocation_list_spinlock,flags);
-		return;
+		vfree(pages);
+	}
+	else
+	{
+		kfree(pages);
 	}
-	spin_unlock_irqrestore(&allocation_list_spinlock,flags);
-
-	_kernel_page_release(item->physaddr);
-	_mali_osk_free( item );
 }
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,26)
@@ -271,12 +895,60 @@ static int mali_kernel_memory_cpu_page_fault_handler(struct vm_area_struct *vma,
 static unsigned long mali_kernel_memory_cpu_page_fault_handler(struct vm_area_struct * vma, unsigned long address)
 #endif
 {
+	mali_vma_usage_tracker * vma_usage_tracker;
+	mali_memory_allocation * descriptor;
+	MappingInfo *mappingInfo;
+	u32 offset;
+	u32 physaddr = INVALID_PAGE;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,26)
 	void __user * address;
 	address = vmf->virtual_address;
 #endif
+
+	vma_usage_tracker = (mali_vma_usage_tracker*)vma->vm_private_data;
+	descriptor = (mali_memory_allocation *)vma_usage_tracker->cookie;
+	mappingInfo = (MappingInfo *)descriptor->process_addr_mapping_info;
+
+	/* The vma might have been split, so use the start of the whole allocation */
+	offset = ((u32)address & PAGE_MASK) - (u32)descriptor->mapping;
+
+	/*
+	 * OS allocated pages are inserted into the CPU mapping on first access when
+	 * the mapping is made on demand. Pages are only released with the mmap
+	 * semaphore held for writing, so an entry can not go away under us. Pages
+	 * committed on a GPU page fault are added with only the session memory lock
+	 * held, which is taken after the mmap semaphore, so read the entry under it.
+	 */
+	if (NULL != mappingInfo->pages && offset < descriptor->size)
+	{
+		_mali_osk_lock_wait(descriptor->lock, _MALI_OSK_LOCKMODE_RW);
+		physaddr = mappingInfo->pages[offset >> PAGE_SHIFT];
+		_mali_osk_lock_signal(descriptor->lock, _MALI_OSK_LOCKMODE_RW);
+	}
+
+	if (INVALID_PAGE != physaddr)
+	{
+		unsigned long pfn = physaddr >> PAGE_SHIFT;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,26)
+		int err;
+
+		MALI_DEBUG_PRINT(7, ("Mapping page on demand at offset 0x%08X\n", offset));
+
+		err = vm_insert_pfn(vma, (unsigned long)address & PAGE_MASK, pfn);
+		if (0 == err || -EBUSY == err)
+		{
+			/* -EBUSY means that another thread inserted the page first */
+			return VM_FAULT_NOPAGE;
+		}
+
+		return (-ENOMEM == err) ? VM_FAULT_OOM : VM_FAULT_SIGBUS;
+#else
+		return pfn;
+#endif
+	}
+
 	/*
-	 * We always fail the call since all memory is pre-faulted when assigned to the process.
+	 * The remaining pages are mapped when assigned to the process, so fail the call.
 	 * Only the Mali cores can use page faults to extend buffers.
 	*/
 
@@ -332,6 +1004,9 @@ static void mali_kernel_memory_vma_close(struct vm_area_struct * vma)
 	args.mapping = descriptor->mapping;
 	args.size = descriptor->size;
 
+	/* The memory may be released after the vma is freed, make sure nothing looks at it by then */
+	((MappingInfo *)descriptor->process_addr_mapping_info)->vma = NULL;
+
 	_mali_ukk_mem_munmap( &args );
 
 	/* vma_usage_tracker is free()d by _mali_osk_mem_mapregion_term().
@@ -413,6 +1088,29 @@ void inline _mali_osk_mem_iowrite32_relaxed( volatile mali_io_address addr, u32
 	__raw_writel(cpu_to_le32(val),((u8*)addr) + offset);
 }
 
+void _mali_osk_mem_iowrite32_relaxed_run( volatile mali_io_address addr, u32 offset, u32 val, u32 step, u32 count )
+{
+	u32 *dst = (u32 *)(((u8*)addr) + offset);
+	u32 i;
+
+	/* Normal memory, plain stores let the compiler unroll and vectorize the loop */
+	for (i = 0; i < count; i++)
+	{
+		dst[i] = cpu_to_le32(val + i * step);
+	}
+}
+
+void _mali_osk_mem_iowrite32_relaxed_array( volatile mali_io_address addr, u32 offset, const u32 *vals, u32 bits, u32 count )
+{
+	u32 *dst = (u32 *)(((u8*)addr) + offset);
+	u32 i;
+
+	for (i = 0; i < count; i++)
+	{
+		dst[i] = cpu_to_le32(vals[i] | bits);
+	}
+}
+
 u32 inline _mali_osk_mem_ioread32( volatile mali_io_address addr, u32 offset )
 {
 	return ioread32(((u8*)addr) + offset);
@@ -461,7 +1159,25 @@ _mali_osk_errcode_t _mali_osk_mem_mapregion_init( mali_memory_allocation * descr
 		return _MALI_OSK_ERR_FAULT;
 	}
 
+	/*
+	 * Sparse memory can get pages committed from the GPU page fault handler,
+	 * which can not take the mmap semaphore to remap_pfn_range() them.
+	 * Such pages are always published through the page array instead.
+	 */
+	if (mali_cpu_map_on_demand || (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_SPARSE))
+	{
+		mappingInfo->pages = _mapping_pages_alloc(PAGE_ALIGN(descriptor->size) >> PAGE_SHIFT);
+		if (NULL == mappingInfo->pages)
+		{
+			MALI_DEBUG_PRINT(2, ("Failed to allocate memory to track the pages to map on demand\n"));
+			_mali_osk_free( vma_usage_tracker );
+			_mali_osk_free( mappingInfo );
+			return _MALI_OSK_ERR_FAULT;
+		}
+	}
+
 	mappingInfo->vma = vma;
+	mappingInfo->vma_usage_tracker = vma_usage_tracker;
 	descriptor->process_addr_mapping_info = mappingInfo;
 
 	/* Do the va range allocation - in this case, it was done earlier, so we copy in that information */
@@ -477,13 +1193,29 @@ _mali_osk_errcode_t _mali_osk_mem_mapregion_init( mali_memory_allocation * descr
 	vma->vm_flags |= VM_DONTCOPY;
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,7,0)
 	vma->vm_flags |= VM_RESERVED;
+	if (NULL != mappingInfo->pages)
+	{
+		/* Set by remap_pfn_range() otherwise, but required by vm_insert_pfn() */
+		vma->vm_flags |= VM_PFNMAP;
+	}
 #else
 	vma->vm_flags |= VM_DONTDUMP;
 	vma->vm_flags |= VM_DONTEXPAND;
 	vma->vm_flags |= VM_PFNMAP;
 #endif
 
-	vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	if (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_CPU_CACHED)
+	{
+		/* Kept coherent with the GPU by _mali_osk_mem_mapregion_sync() */
+	}
+	else if (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_CPU_UNCACHED)
+	{
+		vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+	}
+	else
+	{
+		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	}
 	vma->vm_ops = &mali_kernel_vm_ops; /* Operations used on any memory system */
 
 	vma_usage_tracker->references = 1; /* set initial reference count to be 1 as vma_open won't be called for the first mmap call */
@@ -496,7 +1228,6 @@ _mali_osk_errcode_t _mali_osk_mem_mapregion_init( mali_memory_allocation * descr
 
 void _mali_osk_mem_mapregion_term( mali_memory_allocation * descriptor )
 {
-	struct vm_area_struct* vma;
 	mali_vma_usage_tracker * vma_usage_tracker;
 	MappingInfo *mappingInfo;
 
@@ -509,20 +1240,23 @@ void _mali_osk_mem_mapregion_term( mali_memory_allocation * descriptor )
 	MALI_DEBUG_ASSERT_POINTER( mappingInfo );
 
 	/* Linux does the right thing as part of munmap to remove the mapping
-	 * All that remains is that we remove the vma_usage_tracker setup in init() */
-	vma = mappingInfo->vma;
-
-	MALI_DEBUG_ASSERT_POINTER( vma );
+	 * All that remains is that we remove the vma_usage_tracker setup in init().
+	 * The vma itself may be gone already, when the memory is released in the background. */
 
 	/* ASSERT that there are no allocations on the list. Unmap should've been
 	 * called on all OS allocations. */
 	MALI_DEBUG_ASSERT( NULL == mappingInfo->list );
 
-	vma_usage_tracker = vma->vm_private_data;
+	vma_usage_tracker = mappingInfo->vma_usage_tracker;
 
 	/* We only get called if mem_mapregion_init succeeded */
 	_mali_osk_free(vma_usage_tracker);
 
+	if (NULL != mappingInfo->pages)
+	{
+		_mapping_pages_free(mappingInfo->pages);
+	}
+
 	_mali_osk_free( mappingInfo );
 	return;
 }
@@ -576,7 +1310,16 @@ _mali_osk_errcode_t _mali_osk_mem_mapregion_map( mali_memory_allocation * descri
 
 		linux_phys_frame_num = alloc_item->physaddr >> PAGE_SHIFT;
 
-		ret = ( remap_pfn_range( vma, ((u32)descriptor->mapping) + offset, linux_phys_frame_num, size, vma->vm_page_prot) ) ? _MALI_OSK_ERR_FAULT : _MALI_OSK_ERR_OK;
+		if (NULL != mappingInfo->pages)
+		{
+			/* Mapped into the process on first access */
+			mappingInfo->pages[offset >> PAGE_SHIFT] = alloc_item->physaddr;
+			ret = _MALI_OSK_ERR_OK;
+		}
+		else
+		{
+			ret = ( remap_pfn_range( vma, ((u32)descriptor->mapping) + offset, linux_phys_frame_num, size, vma->vm_page_prot) ) ? _MALI_OSK_ERR_FAULT : _MALI_OSK_ERR_OK;
+		}
 
 		if ( ret != _MALI_OSK_ERR_OK)
 		{
@@ -614,6 +1357,129 @@ _mali_osk_errcode_t _mali_osk_mem_mapregion_map( mali_memory_allocation * descri
 
 }
 
+_mali_osk_errcode_t _mali_osk_mem_mapregion_map_pages( mali_memory_allocation * descriptor, u32 offset, u32 *phys_addrs, u32 *num_pages )
+{
+	struct vm_area_struct *vma;
+	MappingInfo *mappingInfo;
+	AllocationList *head;
+	AllocationList *tail;
+	AllocationList *item;
+	u32 num_allocated;
+	u32 i;
+
+	if (NULL == descriptor) return _MALI_OSK_ERR_FAULT;
+
+	MALI_DEBUG_ASSERT_POINTER( phys_addrs );
+	MALI_DEBUG_ASSERT_POINTER( num_pages );
+
+	MALI_DEBUG_ASSERT( 0 != (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_MAP_INTO_USERSPACE) );
+
+	MALI_DEBUG_ASSERT( 0 == (offset & ~_MALI_OSK_CPU_PAGE_MASK));
+
+	if (NULL == descriptor->mapping) return _MALI_OSK_ERR_INVALID_ARGS;
+
+	if (*num_pages > ((descriptor->size - offset) >> PAGE_SHIFT))
+	{
+		MALI_DEBUG_PRINT(1,("_mali_osk_mem_mapregion_map_pages: virtual memory area not large enough to map %d pages into area 0x%x at offset 0x%x\n",
+		                    *num_pages, descriptor->mapping, offset));
+		return _MALI_OSK_ERR_FAULT;
+	}
+
+	mappingInfo = (MappingInfo *)descriptor->process_addr_mapping_info;
+
+	MALI_DEBUG_ASSERT_POINTER( mappingInfo );
+
+	vma = mappingInfo->vma;
+
+	if (NULL == vma ) return _MALI_OSK_ERR_FAULT;
+
+	if ( MALI_MEMORY_ALLOCATION_OS_ALLOCATED_PHYSADDR_MAGIC != phys_addrs[0] )
+	{
+		/* Use the supplied physical addresses */
+		for (i = 0; i < *num_pages; i++)
+		{
+			MALI_DEBUG_ASSERT( 0 == (phys_addrs[i] & ~_MALI_OSK_CPU_PAGE_MASK) );
+
+			if ( remap_pfn_range( vma, ((u32)descriptor->mapping) + offset + i * PAGE_SIZE, phys_addrs[i] >> PAGE_SHIFT, PAGE_SIZE, vma->vm_page_prot) )
+			{
+				MALI_PRINT_ERROR(("%s %d could not remap_pfn_range()\n", __FUNCTION__, __LINE__));
+				return _MALI_OSK_ERR_FAULT;
+			}
+		}
+
+		return _MALI_OSK_ERR_OK;
+	}
+
+	/* Runs are never split, so pages which may be decommitted one by one are allocated singly */
+	num_allocated = _allocation_list_items_get(*num_pages, &head,
+	                (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_SPARSE) ? 0 : MALI_OS_MEMORY_MAX_RUN_ORDER);
+	if (0 == num_allocated)
+	{
+		MALI_DEBUG_PRINT(1, ("Failed to allocate list items\n"));
+		return _MALI_OSK_ERR_NOMEM;
+	}
+
+	MALI_DEBUG_PRINT(7, ("Process map: mapping %d pages to process address 0x%08lX\n", num_allocated, (long unsigned int)(descriptor->mapping + offset)));
+
+	/* Map the CPU side of all pages in one pass, a run at a time */
+	tail = NULL;
+	for (i = 0, item = head; NULL != item; item = item->next)
+	{
+		u32 j;
+
+		item->offset = offset + i * PAGE_SIZE;
+
+		if (NULL != mappingInfo->pages)
+		{
+			/* Mapped into the process on first access */
+			for (j = 0; j < (1 << item->order); j++)
+			{
+				mappingInfo->pages[(item->offset >> PAGE_SHIFT) + j] = item->physaddr + j * PAGE_SIZE;
+			}
+		}
+		else if ( remap_pfn_range( vma, ((u32)descriptor->mapping) + item->offset, item->physaddr >> PAGE_SHIFT, PAGE_SIZE << item->order, vma->vm_page_prot) )
+		{
+			MALI_PRINT_ERROR(("%s %d could not remap_pfn_range()\n", __FUNCTION__, __LINE__));
+			break;
+		}
+
+		for (j = 0; j < (1 << item->order); j++)
+		{
+			phys_addrs[i++] = item->physaddr + j * PAGE_SIZE;
+		}
+		tail = item;
+	}
+
+	/* Release the pages that could not be mapped */
+	while ( NULL != item )
+	{
+		AllocationList *next = item->next;
+		_allocation_list_item_release(item);
+		item = next;
+	}
+
+	if (NULL == tail)
+	{
+		return _MALI_OSK_ERR_FAULT;
+	}
+
+	/* Put the mapped items into the list of allocations */
+	tail->next = NULL;
+	if (NULL == mappingInfo->list)
+	{
+		mappingInfo->list = head;
+	}
+	else
+	{
+		mappingInfo->tail->next = head;
+	}
+	mappingInfo->tail = tail;
+
+	*num_pages = i;
+
+	return _MALI_OSK_ERR_OK;
+}
+
 void _mali_osk_mem_mapregion_unmap( mali_memory_allocation * descriptor, u32 offset, u32 size, _mali_osk_mem_mapregion_flags_t flags )
 {
 	MappingInfo *mappingInfo;
@@ -638,6 +1504,12 @@ void _mali_osk_mem_mapregion_unmap( mali_memory_allocation * descriptor, u32 off
 
 	MALI_DEBUG_ASSERT_POINTER( mappingInfo );
 
+	if ( 0 != (flags & _MALI_OSK_MEM_MAPREGION_FLAG_DECOMMIT) && NULL != mappingInfo->vma )
+	{
+		/* The vma stays, remove any CPU access to the pages before they are freed */
+		zap_vma_ptes(mappingInfo->vma, ((u32)descriptor->mapping) + offset, size);
+	}
+
 	if ( 0 != (flags & _MALI_OSK_MEM_MAPREGION_FLAG_OS_ALLOCATED_PHYSADDR) )
 	{
 		/* This physical RAM was allocated in _mali_osk_mem_mapregion_map and
@@ -647,11 +1519,13 @@ void _mali_osk_mem_mapregion_unmap( mali_memory_allocation * descriptor, u32 off
 		{
 			/* First find the allocation in the list of allocations */
 			AllocationList *alloc = mappingInfo->list;
-			AllocationList **prev = &(mappingInfo->list);
+			AllocationList *prev_alloc = NULL;
+			u32 run_size;
+			u32 j;
 
 			while (NULL != alloc && alloc->offset != offset)
 			{
-				prev = &(alloc->next);
+				prev_alloc = alloc;
 				alloc = alloc->next;
 			}
 			if (alloc == NULL) {
@@ -661,12 +1535,42 @@ void _mali_osk_mem_mapregion_unmap( mali_memory_allocation * descriptor, u32 off
 				continue;
 			}
 
-			*prev = alloc->next;
+			/* Runs are never split, they are unmapped as a whole */
+			run_size = _MALI_OSK_CPU_PAGE_SIZE << alloc->order;
+			MALI_DEBUG_ASSERT(run_size <= size);
+
+			if (NULL == prev_alloc)
+			{
+				mappingInfo->list = alloc->next;
+			}
+			else
+			{
+				prev_alloc->next = alloc->next;
+			}
+			if (mappingInfo->tail == alloc)
+			{
+				mappingInfo->tail = prev_alloc;
+			}
+
+			if (NULL != mappingInfo->pages)
+			{
+				for (j = 0; j < (1 << alloc->order); j++)
+				{
+					mappingInfo->pages[(offset >> PAGE_SHIFT) + j] = INVALID_PAGE;
+				}
+			}
+			if (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_CPU_CACHED)
+			{
+				/* Dirty lines left by the process must not be written back over the next user's data,
+				 * and stale lines must not be read by whoever gets the pages next: clean and invalidate */
+				dma_sync_single_for_device(NULL, alloc->physaddr, run_size, DMA_BIDIRECTIONAL);
+				dma_sync_single_for_cpu(NULL, alloc->physaddr, run_size, DMA_BIDIRECTIONAL);
+			}
 			_allocation_list_item_release(alloc);
 
 			/* Move onto the next allocation */
-			size -= _MALI_OSK_CPU_PAGE_SIZE;
-			offset += _MALI_OSK_CPU_PAGE_SIZE;
+			size -= (run_size < size) ? run_size : size;
+			offset += run_size;
 		}
 	}
 
@@ -675,6 +1579,164 @@ void _mali_osk_mem_mapregion_unmap( mali_memory_allocation * descriptor, u32 off
 	return;
 }
 
+_mali_osk_errcode_t _mali_osk_mem_mapregion_trylock( mali_memory_allocation * descriptor, void **owner )
+{
+	MappingInfo *mappingInfo;
+	struct mm_struct *mm;
+
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+	MALI_DEBUG_ASSERT_POINTER(owner);
+
+	*owner = NULL;
+
+	mappingInfo = (MappingInfo *)descriptor->process_addr_mapping_info;
+	if (NULL == mappingInfo)
+	{
+		return _MALI_OSK_ERR_OK;
+	}
+
+	/* The mapping is going away */
+	if (NULL == mappingInfo->vma)
+	{
+		return _MALI_OSK_ERR_BUSY;
+	}
+
+	mm = mappingInfo->vma->vm_mm;
+
+	/* The page tables of an exiting process are freed before its vmas are closed */
+	if (!atomic_inc_not_zero(&mm->mm_users))
+	{
+		return _MALI_OSK_ERR_BUSY;
+	}
+
+	/* Held for writing, since the CPU page fault handler runs with it held for reading */
+	if (!down_write_trylock(&mm->mmap_sem))
+	{
+		mmput(mm);
+		return _MALI_OSK_ERR_BUSY;
+	}
+
+	*owner = mm;
+
+	return _MALI_OSK_ERR_OK;
+}
+
+void _mali_osk_mem_mapregion_unlock( void *owner )
+{
+	struct mm_struct *mm = (struct mm_struct *)owner;
+
+	if (NULL == mm)
+	{
+		return;
+	}
+
+	up_write(&mm->mmap_sem);
+	mmput(mm);
+}
+
+_mali_osk_errcode_t _mali_osk_mem_mapregion_move( mali_memory_allocation * to, mali_memory_allocation * from, u32 *phys_addrs )
+{
+	MappingInfo *to_info;
+	MappingInfo *from_info;
+	u32 *pages;
+	u32 num_pages;
+	u32 i;
+
+	MALI_DEBUG_ASSERT_POINTER(to);
+	MALI_DEBUG_ASSERT_POINTER(from);
+	MALI_DEBUG_ASSERT_POINTER(phys_addrs);
+
+	to_info = (MappingInfo *)to->process_addr_mapping_info;
+	from_info = (MappingInfo *)from->process_addr_mapping_info;
+
+	MALI_DEBUG_ASSERT_POINTER(to_info);
+	MALI_DEBUG_ASSERT_POINTER(from_info);
+	MALI_DEBUG_ASSERT(NULL == from_info->vma);
+
+	/* Pages mapped with remap_pfn_range() would have to be remapped one by one */
+	if (to->size != from->size || NULL == to_info->pages || NULL == from_info->pages || NULL != to_info->list)
+	{
+		return _MALI_OSK_ERR_UNSUPPORTED;
+	}
+
+	num_pages = PAGE_ALIGN(to->size) >> PAGE_SHIFT;
+	for (i = 0; i < num_pages; i++)
+	{
+		if (INVALID_PAGE == from_info->pages[i])
+		{
+			return _MALI_OSK_ERR_UNSUPPORTED;
+		}
+	}
+
+	/* The page arrays are the same size, swap them instead of copying */
+	pages = to_info->pages;
+	to_info->pages = from_info->pages;
+	from_info->pages = pages;
+
+	to_info->list = from_info->list;
+	to_info->tail = from_info->tail;
+	from_info->list = NULL;
+	from_info->tail = NULL;
+
+	for (i = 0; i < num_pages; i++)
+	{
+		phys_addrs[i] = to_info->pages[i];
+	}
+
+	return _MALI_OSK_ERR_OK;
+}
+
+void _mali_osk_mem_mapregion_sync( mali_memory_allocation * descriptor, u32 offset, u32 size, mali_bool to_device )
+{
+	MappingInfo *mappingInfo;
+	AllocationList *item;
+
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+	MALI_DEBUG_ASSERT( 0 != (descriptor->flags & (MALI_MEMORY_ALLOCATION_FLAG_MAP_INTO_USERSPACE | MALI_MEMORY_ALLOCATION_FLAG_USER_MEMORY)) );
+	MALI_DEBUG_ASSERT( 0 == (offset & ~_MALI_OSK_CPU_PAGE_MASK) );
+	MALI_DEBUG_ASSERT( 0 == (size & ~_MALI_OSK_CPU_PAGE_MASK) );
+
+	if (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_USER_MEMORY)
+	{
+		mali_userptr_sync(descriptor, offset, size, to_device);
+		return;
+	}
+
+	if (0 == (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_CPU_CACHED))
+	{
+		/* Write-combined and uncached writes only have to be drained */
+		_mali_osk_write_mem_barrier();
+		return;
+	}
+
+	mappingInfo = (MappingInfo *)descriptor->process_addr_mapping_info;
+	MALI_DEBUG_ASSERT_POINTER(mappingInfo);
+
+	for (item = mappingInfo->list; NULL != item; item = item->next)
+	{
+		u32 run_size = _MALI_OSK_CPU_PAGE_SIZE << item->order;
+		u32 start;
+		u32 end;
+
+		/* Part of the run inside [offset, offset + size) */
+		start = (item->offset > offset) ? item->offset : offset;
+		end = (item->offset + run_size < offset + size) ? item->offset + run_size : offset + size;
+		if (start >= end)
+		{
+			continue;
+		}
+
+		if (MALI_TRUE == to_device)
+		{
+			dma_sync_single_for_device(NULL, item->physaddr + (start - item->offset), end - start, DMA_TO_DEVICE);
+		}
+		else
+		{
+			dma_sync_single_for_cpu(NULL, item->physaddr + (start - item->offset), end - start, DMA_FROM_DEVICE);
+		}
+	}
+}
+
 u32 _mali_osk_mem_write_safe(void *dest, const void *src, u32 size)
 {
 #define MALI_MEM_SAFE_COPY_BLOCK_SIZE 4096
@@ -18,6 +18,7 @@
 #define __MALI_OSK_SPECIFIC_H__
 
 #include <asm/uaccess.h>
+#include <linux/rbtree.h>
 
 #include "mali_sync.h"
 
@@ -34,4 +35,53 @@ MALI_STATIC_INLINE u32 _mali_osk_copy_from_user(void *to, void *from, u32 n)
 	return (u32)copy_from_user(to, from, (unsigned long)n);
 }
 
+typedef struct rb_root _mali_osk_rbtree_t;
+typedef struct rb_node _mali_osk_rbtree_node_t;
+
+MALI_STATIC_INLINE void _mali_osk_rbtree_init(_mali_osk_rbtree_t *tree)
+{
+	tree->rb_node = NULL;
+}
+
+MALI_STATIC_INLINE _mali_osk_rbtree_node_t **_mali_osk_rbtree_root(_mali_osk_rbtree_t *tree)
+{
+	return &tree->rb_node;
+}
+
+MALI_STATIC_INLINE _mali_osk_rbtree_node_t **_mali_osk_rbtree_left(_mali_osk_rbtree_node_t *node)
+{
+	return &node->rb_left;
+}
+
+MALI_STATIC_INLINE _mali_osk_rbtree_node_t **_mali_osk_rbtree_right(_mali_osk_rbtree_node_t *node)
+{
+	return &node->rb_right;
+}
+
+MALI_STATIC_INLINE void _mali_osk_rbtree_insert(_mali_osk_rbtree_t *tree, _mali_osk_rbtree_node_t *node, _mali_osk_rbtree_node_t *parent, _mali_osk_rbtree_node_t **link)
+{
+	rb_link_node(node, parent, link);
+	rb_insert_color(node, tree);
+}
+
+MALI_STATIC_INLINE void _mali_osk_rbtree_erase(_mali_osk_rbtree_t *tree, _mali_osk_rbtree_node_t *node)
+{
+	rb_erase(node, tree);
+}
+
+MALI_STATIC_INLINE _mali_osk_rbtree_node_t *_mali_osk_rbtree_first(_mali_osk_rbtree_t *tree)
+{
+	return rb_first(tree);
+}
+
+MALI_STATIC_INLINE _mali_osk_rbtree_node_t *_mali_osk_rbtree_next(_mali_osk_rbtree_node_t *node)
+{
+	return rb_next(node);
+}
+
+MALI_STATIC_INLINE _mali_osk_rbtree_node_t *_mali_osk_rbtree_prev(_mali_osk_rbtree_node_t *node)
+{
+	return rb_prev(node);
+}
+
 #endif /* __MALI_OSK_SPECIFIC_H__ */
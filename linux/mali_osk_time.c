@@ -16,6 +16,7 @@
 #include "mali_osk.h"
 #include <linux/jiffies.h>
 #include <linux/time.h>
+#include <linux/ktime.h>
 #include <asm/delay.h>
 
 int	_mali_osk_time_after( u32 ticka, u32 tickb )
@@ -49,3 +50,8 @@ u64 _mali_osk_time_get_ns( void )
 	getnstimeofday(&tsval);
 	return (u64)timespec_to_ns(&tsval);
 }
+
+u64 _mali_osk_time_get_monotonic_ns( void )
+{
+	return (u64)ktime_to_ns(ktime_get());
+}
@@ -14,6 +14,7 @@
  */
 
 #include <linux/timer.h>
+#include <linux/hrtimer.h>
 #include <linux/slab.h>
 #include "mali_osk.h"
 #include "mali_kernel_common.h"
@@ -23,6 +24,13 @@ struct _mali_osk_timer_t_struct
     struct timer_list timer;
 };
 
+struct _mali_osk_hrtimer_t_struct
+{
+	struct hrtimer timer;
+	_mali_osk_timer_callback_t callback;
+	void *data;
+};
+
 typedef void (*timer_timeout_function_t)(unsigned long);
 
 _mali_osk_timer_t *_mali_osk_timer_init(void)
@@ -75,3 +83,52 @@ void _mali_osk_timer_term( _mali_osk_timer_t *tim )
     MALI_DEBUG_ASSERT_POINTER(tim);
     kfree(tim);
 }
+
+static enum hrtimer_restart _mali_osk_hrtimer_callback(struct hrtimer *timer)
+{
+	_mali_osk_hrtimer_t *tim = container_of(timer, _mali_osk_hrtimer_t, timer);
+
+	tim->callback(tim->data);
+
+	/* The callback restarts the timer itself if it needs to */
+	return HRTIMER_NORESTART;
+}
+
+_mali_osk_hrtimer_t *_mali_osk_hrtimer_init(void)
+{
+	_mali_osk_hrtimer_t *t = (_mali_osk_hrtimer_t*)kmalloc(sizeof(_mali_osk_hrtimer_t), GFP_KERNEL);
+	if (NULL != t)
+	{
+		hrtimer_init(&t->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		t->timer.function = _mali_osk_hrtimer_callback;
+		t->callback = NULL;
+		t->data = NULL;
+	}
+	return t;
+}
+
+void _mali_osk_hrtimer_start( _mali_osk_hrtimer_t *tim, u64 ns_to_expire )
+{
+	MALI_DEBUG_ASSERT_POINTER(tim);
+	MALI_DEBUG_ASSERT_POINTER(tim->callback);
+	hrtimer_start(&tim->timer, ns_to_ktime(ns_to_expire), HRTIMER_MODE_REL);
+}
+
+void _mali_osk_hrtimer_cancel( _mali_osk_hrtimer_t *tim )
+{
+	MALI_DEBUG_ASSERT_POINTER(tim);
+	hrtimer_cancel(&tim->timer);
+}
+
+void _mali_osk_hrtimer_setcallback( _mali_osk_hrtimer_t *tim, _mali_osk_timer_callback_t callback, void *data )
+{
+	MALI_DEBUG_ASSERT_POINTER(tim);
+	tim->callback = callback;
+	tim->data = data;
+}
+
+void _mali_osk_hrtimer_term( _mali_osk_hrtimer_t *tim )
+{
+	MALI_DEBUG_ASSERT_POINTER(tim);
+	kfree(tim);
+}
@@ -9,11 +9,14 @@
  */
 #include <linux/fs.h>       /* file system operations */
 #include <asm/uaccess.h>    /* user space access */
+#include <linux/sched.h>    /* current->mm */
+#include <linux/mm.h>       /* find_vma(), do_munmap() */
 
 #include "mali_ukk.h"
 #include "mali_osk.h"
 #include "mali_kernel_common.h"
 #include "mali_session.h"
+#include "mali_memory.h"
 #include "mali_ukk_wrappers.h"
 
 int mem_init_wrapper(struct mali_session_data *session_data, _mali_uk_init_mem_s __user *uargs)
@@ -108,6 +111,274 @@ int mem_write_safe_wrapper(struct mali_session_data *session_data, _mali_uk_mem_
 	return 0;
 }
 
+int mem_alloc_va_wrapper(struct mali_session_data *session_data, _mali_uk_mem_alloc_va_s __user * uargs)
+{
+	_mali_uk_mem_alloc_va_s kargs;
+	_mali_osk_errcode_t err;
+
+	MALI_CHECK_NON_NULL(uargs, -EINVAL);
+	MALI_CHECK_NON_NULL(session_data, -EINVAL);
+
+	if (0 != copy_from_user(&kargs, uargs, sizeof(_mali_uk_mem_alloc_va_s)))
+	{
+		return -EFAULT;
+	}
+
+	kargs.ctx = session_data;
+
+	err = _mali_ukk_mem_alloc_va(&kargs);
+	if (_MALI_OSK_ERR_OK != err)
+	{
+		return map_errcode(err);
+	}
+
+	if (0 != put_user(kargs.mali_address, &uargs->mali_address))
+	{
+		_mali_uk_mem_free_va_s free_args;
+
+		free_args.ctx = session_data;
+		free_args.mali_address = kargs.mali_address;
+		_mali_ukk_mem_free_va(&free_args);
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
+int mem_free_va_wrapper(struct mali_session_data *session_data, _mali_uk_mem_free_va_s __user * uargs)
+{
+	_mali_uk_mem_free_va_s kargs;
+	_mali_osk_errcode_t err;
+
+	MALI_CHECK_NON_NULL(uargs, -EINVAL);
+	MALI_CHECK_NON_NULL(session_data, -EINVAL);
+
+	if (0 != copy_from_user(&kargs, uargs, sizeof(_mali_uk_mem_free_va_s)))
+	{
+		return -EFAULT;
+	}
+
+	kargs.ctx = session_data;
+
+	err = _mali_ukk_mem_free_va(&kargs);
+	if (_MALI_OSK_ERR_OK != err)
+	{
+		return map_errcode(err);
+	}
+
+	return 0;
+}
+
+int mem_commit_wrapper(struct mali_session_data *session_data, _mali_uk_mem_commit_s __user * uargs, mali_bool commit)
+{
+	_mali_uk_mem_commit_s kargs;
+	_mali_osk_errcode_t err;
+
+	MALI_CHECK_NON_NULL(uargs, -EINVAL);
+	MALI_CHECK_NON_NULL(session_data, -EINVAL);
+
+	if (0 != copy_from_user(&kargs, uargs, sizeof(_mali_uk_mem_commit_s)))
+	{
+		return -EFAULT;
+	}
+
+	kargs.ctx = session_data;
+
+	/* The CPU page fault handler relies on the pages of a mapping only going away with mmap_sem held for writing */
+	down_write(&current->mm->mmap_sem);
+	if (MALI_TRUE == commit)
+	{
+		err = _mali_ukk_mem_commit(&kargs);
+	}
+	else
+	{
+		err = _mali_ukk_mem_decommit(&kargs);
+	}
+	up_write(&current->mm->mmap_sem);
+
+	if (_MALI_OSK_ERR_OK != err)
+	{
+		return map_errcode(err);
+	}
+
+	return 0;
+}
+
+int mem_set_purgeable_wrapper(struct mali_session_data *session_data, _mali_uk_mem_set_purgeable_s __user * uargs)
+{
+	_mali_uk_mem_set_purgeable_s kargs;
+	_mali_osk_errcode_t err;
+
+	MALI_CHECK_NON_NULL(uargs, -EINVAL);
+	MALI_CHECK_NON_NULL(session_data, -EINVAL);
+
+	if (0 != copy_from_user(&kargs, uargs, sizeof(_mali_uk_mem_set_purgeable_s)))
+	{
+		return -EFAULT;
+	}
+
+	kargs.ctx = session_data;
+
+	err = _mali_ukk_mem_set_purgeable(&kargs);
+	if (_MALI_OSK_ERR_OK != err)
+	{
+		return map_errcode(err);
+	}
+
+	if (0 != put_user(kargs.purged, &uargs->purged))
+	{
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
+/* Number of mappings copied from user space at a time by mem_free_batch_wrapper() */
+#define MALI_MEM_FREE_BATCH_CHUNK 32
+
+int mem_free_batch_wrapper(struct mali_session_data *session_data, _mali_uk_mem_free_batch_s __user * uargs)
+{
+	_mali_uk_mem_free_batch_s kargs;
+	unsigned long mappings[MALI_MEM_FREE_BATCH_CHUNK];
+	u32 i, j;
+	int ret = 0;
+
+	MALI_CHECK_NON_NULL(uargs, -EINVAL);
+	MALI_CHECK_NON_NULL(session_data, -EINVAL);
+
+	if (0 != copy_from_user(&kargs, uargs, sizeof(_mali_uk_mem_free_batch_s)))
+	{
+		return -EFAULT;
+	}
+
+	mali_memory_free_batch_begin(session_data);
+
+	for (i = 0; i < kargs.num_mappings && 0 == ret; i += MALI_MEM_FREE_BATCH_CHUNK)
+	{
+		u32 count = min_t(u32, kargs.num_mappings - i, MALI_MEM_FREE_BATCH_CHUNK);
+
+		/* Copied before taking mmap_sem, faulting in user memory needs it */
+		if (0 != copy_from_user(mappings, &kargs.mappings[i], count * sizeof(void *)))
+		{
+			ret = -EFAULT;
+			break;
+		}
+
+		down_write(&current->mm->mmap_sem);
+		for (j = 0; j < count; j++)
+		{
+			struct vm_area_struct *vma = find_vma(current->mm, mappings[j]);
+
+			/* Only whole mappings of memory from this session */
+			if (NULL == vma || vma->vm_start != mappings[j] || NULL == vma->vm_file || vma->vm_file->private_data != session_data)
+			{
+				ret = -EINVAL;
+				break;
+			}
+
+			/* Frees the allocation through the vma close handler */
+			do_munmap(current->mm, vma->vm_start, vma->vm_end - vma->vm_start);
+		}
+		up_write(&current->mm->mmap_sem);
+	}
+
+	mali_memory_free_batch_end(session_data);
+
+	return ret;
+}
+
+int mem_suballoc_wrapper(struct mali_session_data *session_data, _mali_uk_mem_suballoc_s __user * uargs)
+{
+	_mali_uk_mem_suballoc_s kargs;
+	_mali_osk_errcode_t err;
+
+	MALI_CHECK_NON_NULL(uargs, -EINVAL);
+	MALI_CHECK_NON_NULL(session_data, -EINVAL);
+
+	if (0 != copy_from_user(&kargs, uargs, sizeof(_mali_uk_mem_suballoc_s)))
+	{
+		return -EFAULT;
+	}
+
+	kargs.ctx = session_data;
+
+	err = _mali_ukk_mem_suballoc(&kargs);
+	if (_MALI_OSK_ERR_OK != err)
+	{
+		return map_errcode(err);
+	}
+
+	if (0 != put_user(kargs.mali_address, &uargs->mali_address))
+	{
+		/* User space never learns about the object, free it again */
+		_mali_uk_mem_subfree_s fargs;
+
+		fargs.ctx = session_data;
+		fargs.heap_address = kargs.heap_address;
+		fargs.mali_address = kargs.mali_address;
+
+		down_write(&current->mm->mmap_sem);
+		_mali_ukk_mem_subfree(&fargs);
+		up_write(&current->mm->mmap_sem);
+
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
+int mem_subfree_wrapper(struct mali_session_data *session_data, _mali_uk_mem_subfree_s __user * uargs)
+{
+	_mali_uk_mem_subfree_s kargs;
+	_mali_osk_errcode_t err;
+
+	MALI_CHECK_NON_NULL(uargs, -EINVAL);
+	MALI_CHECK_NON_NULL(session_data, -EINVAL);
+
+	if (0 != copy_from_user(&kargs, uargs, sizeof(_mali_uk_mem_subfree_s)))
+	{
+		return -EFAULT;
+	}
+
+	kargs.ctx = session_data;
+
+	/* An empty slab may be decommitted, which zaps its pages from the CPU mapping */
+	down_write(&current->mm->mmap_sem);
+	err = _mali_ukk_mem_subfree(&kargs);
+	up_write(&current->mm->mmap_sem);
+
+	if (_MALI_OSK_ERR_OK != err)
+	{
+		return map_errcode(err);
+	}
+
+	return 0;
+}
+
+int mem_sync_wrapper(struct mali_session_data *session_data, _mali_uk_mem_sync_s __user * uargs)
+{
+	_mali_uk_mem_sync_s kargs;
+	_mali_osk_errcode_t err;
+
+	MALI_CHECK_NON_NULL(uargs, -EINVAL);
+	MALI_CHECK_NON_NULL(session_data, -EINVAL);
+
+	if (0 != copy_from_user(&kargs, uargs, sizeof(_mali_uk_mem_sync_s)))
+	{
+		return -EFAULT;
+	}
+
+	kargs.ctx = session_data;
+
+	err = _mali_ukk_mem_sync(&kargs);
+	if (_MALI_OSK_ERR_OK != err)
+	{
+		return map_errcode(err);
+	}
+
+	return 0;
+}
+
 int mem_map_ext_wrapper(struct mali_session_data *session_data, _mali_uk_map_external_mem_s __user * argument)
 {
 	_mali_uk_map_external_mem_s uk_args;
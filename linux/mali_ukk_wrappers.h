@@ -37,6 +37,14 @@ int post_notification_wrapper(struct mali_session_data *session_data, _mali_uk_p
 int mem_init_wrapper(struct mali_session_data *session_data, _mali_uk_init_mem_s __user *uargs);
 int mem_term_wrapper(struct mali_session_data *session_data, _mali_uk_term_mem_s __user *uargs);
 int mem_write_safe_wrapper(struct mali_session_data *session_data, _mali_uk_mem_write_safe_s __user * uargs);
+int mem_alloc_va_wrapper(struct mali_session_data *session_data, _mali_uk_mem_alloc_va_s __user * uargs);
+int mem_free_va_wrapper(struct mali_session_data *session_data, _mali_uk_mem_free_va_s __user * uargs);
+int mem_commit_wrapper(struct mali_session_data *session_data, _mali_uk_mem_commit_s __user * uargs, mali_bool commit);
+int mem_set_purgeable_wrapper(struct mali_session_data *session_data, _mali_uk_mem_set_purgeable_s __user * uargs);
+int mem_free_batch_wrapper(struct mali_session_data *session_data, _mali_uk_mem_free_batch_s __user * uargs);
+int mem_suballoc_wrapper(struct mali_session_data *session_data, _mali_uk_mem_suballoc_s __user * uargs);
+int mem_subfree_wrapper(struct mali_session_data *session_data, _mali_uk_mem_subfree_s __user * uargs);
+int mem_sync_wrapper(struct mali_session_data *session_data, _mali_uk_mem_sync_s __user * uargs);
 int mem_map_ext_wrapper(struct mali_session_data *session_data, _mali_uk_map_external_mem_s __user * argument);
 int mem_unmap_ext_wrapper(struct mali_session_data *session_data, _mali_uk_unmap_external_mem_s __user * argument);
 int mem_query_mmu_page_table_dump_size_wrapper(struct mali_session_data *session_data, _mali_uk_query_mmu_page_table_dump_size_s __user * uargs);
@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2013 ARM Limited. All rights reserved.
+ * 
+ * This program is free software and is provided to you under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation, and any use by you of this program is subject to the terms of such GNU licence.
+ * 
+ * A copy of the licence is included with the program, and can also be obtained from Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#include <linux/fs.h>	   /* file system operations */
+#include <asm/uaccess.h>	/* user space access */
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/dma-mapping.h>
+
+#include "mali_ukk.h"
+#include "mali_osk.h"
+#include "mali_kernel_common.h"
+#include "mali_session.h"
+#include "mali_scheduler.h"
+
+#include "mali_kernel_memory_engine.h"
+#include "mali_memory.h"
+#include "mali_l2_cache.h"
+#include "mali_userptr.h"
+
+/* Process memory pinned for the GPU */
+struct mali_userptr_mem {
+	struct page **pages;
+	u32 *phys_addrs;
+	u32 num_pages;
+	struct mm_struct *mm;               /* Charged for the pinned pages in locked_vm */
+	_mali_osk_wq_work_t *uncharge_work; /* Uncharges mm when its mmap_sem is contended */
+};
+
+static void mali_userptr_unpin(struct page **pages, u32 num_pages)
+{
+	u32 i;
+
+	for (i = 0; i < num_pages; i++)
+	{
+		/* The GPU may have written to the page */
+		set_page_dirty_lock(pages[i]);
+		put_page(pages[i]);
+	}
+}
+
+static void mali_userptr_uncharge(struct mali_userptr_mem *mem)
+{
+	mem->mm->locked_vm -= mem->num_pages;
+	up_write(&mem->mm->mmap_sem);
+
+	mmdrop(mem->mm);
+	_mali_osk_wq_delete_work_nonflush(mem->uncharge_work);
+	_mali_osk_free(mem);
+}
+
+static void mali_userptr_uncharge_work(void *data)
+{
+	struct mali_userptr_mem *mem = (struct mali_userptr_mem *)data;
+
+	down_write(&mem->mm->mmap_sem);
+	mali_userptr_uncharge(mem);
+}
+
+void mali_userptr_release(void *ctx, void *handle)
+{
+	struct mali_userptr_mem *mem;
+	u32 i;
+
+	mem = (struct mali_userptr_mem *)handle;
+
+	MALI_DEBUG_PRINT(3, ("Mali userptr: release %d pages\n", mem->num_pages));
+
+	MALI_DEBUG_ASSERT_POINTER(mem);
+
+	for (i = 0; i < mem->num_pages; i++)
+	{
+		dma_unmap_page(NULL, mem->phys_addrs[i], PAGE_SIZE, DMA_BIDIRECTIONAL);
+	}
+
+	mali_userptr_unpin(mem->pages, mem->num_pages);
+	mali_l2_cache_untracked_writer_remove();
+
+	_mali_osk_free(mem->phys_addrs);
+	_mali_osk_free(mem->pages);
+
+	/* The session memory lock may be held, which is taken after mmap_sem */
+	if (down_write_trylock(&mem->mm->mmap_sem))
+	{
+		mali_userptr_uncharge(mem);
+	}
+	else
+	{
+		_mali_osk_wq_schedule_work(mem->uncharge_work);
+	}
+}
+
+void mali_userptr_sync(mali_memory_allocation *descriptor, u32 offset, u32 size, mali_bool to_device)
+{
+	struct mali_userptr_mem *mem;
+	u32 i;
+
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+	MALI_DEBUG_ASSERT(mali_userptr_release == descriptor->physical_allocation.release);
+
+	mem = (struct mali_userptr_mem *)descriptor->physical_allocation.handle;
+	MALI_DEBUG_ASSERT_POINTER(mem);
+	MALI_DEBUG_ASSERT((offset + size) >> PAGE_SHIFT <= mem->num_pages);
+
+	for (i = offset >> PAGE_SHIFT; i < (offset + size) >> PAGE_SHIFT; i++)
+	{
+		if (MALI_TRUE == to_device)
+		{
+			dma_sync_single_for_device(NULL, mem->phys_addrs[i], PAGE_SIZE, DMA_BIDIRECTIONAL);
+		}
+		else
+		{
+			dma_sync_single_for_cpu(NULL, mem->phys_addrs[i], PAGE_SIZE, DMA_BIDIRECTIONAL);
+		}
+	}
+}
+
+/* Callback from memory engine which will map into Mali virtual address space */
+static mali_physical_memory_allocation_result mali_userptr_commit(void* ctx, mali_allocation_engine * engine, mali_memory_allocation * descriptor, u32* offset, mali_physical_memory_allocation * alloc_info)
+{
+	struct mali_session_data *session;
+	struct mali_userptr_mem *mem;
+
+	MALI_DEBUG_ASSERT_POINTER(ctx);
+	MALI_DEBUG_ASSERT_POINTER(engine);
+	MALI_DEBUG_ASSERT_POINTER(descriptor);
+	MALI_DEBUG_ASSERT_POINTER(offset);
+	MALI_DEBUG_ASSERT_POINTER(alloc_info);
+
+	/* Mapping user memory with an offset is not supported. */
+	MALI_DEBUG_ASSERT(0 == *offset);
+
+	session = (struct mali_session_data *)descriptor->mali_addr_mapping_info;
+	MALI_DEBUG_ASSERT_POINTER(session);
+
+	mem = (struct mali_userptr_mem *)ctx;
+
+	mali_mmu_pagedir_update_pages(mali_session_get_page_directory(session), descriptor->mali_address,
+	                              mem->phys_addrs, mem->num_pages, MALI_CACHE_STANDARD);
+	*offset = mem->num_pages * PAGE_SIZE;
+
+	if (descriptor->flags & MALI_MEMORY_ALLOCATION_FLAG_MAP_GUARD_PAGE)
+	{
+		MALI_DEBUG_PRINT(7, ("Mapping in extra guard page\n"));
+		mali_mmu_pagedir_update(mali_session_get_page_directory(session), descriptor->mali_address + *offset,
+		                        mem->phys_addrs[0], MALI_MMU_PAGE_SIZE, MALI_CACHE_STANDARD);
+	}
+
+	alloc_info->ctx = NULL;
+	alloc_info->handle = mem;
+	alloc_info->next = NULL;
+	alloc_info->release = mali_userptr_release;
+
+	return MALI_MEM_ALLOC_FINISHED;
+}
+
+/* Pin the process memory at args->user_address, faulting it in as needed */
+static struct mali_userptr_mem *mali_userptr_pin(_mali_uk_attach_userptr_s *args)
+{
+	struct mali_userptr_mem *mem;
+	unsigned long locked;
+	int pinned;
+	u32 i;
+
+	mem = _mali_osk_calloc(1, sizeof(struct mali_userptr_mem));
+	if (NULL == mem)
+	{
+		return NULL;
+	}
+
+	mem->num_pages = args->size >> PAGE_SHIFT;
+	mem->pages = _mali_osk_calloc(mem->num_pages, sizeof(struct page *));
+	mem->phys_addrs = _mali_osk_calloc(mem->num_pages, sizeof(u32));
+	mem->uncharge_work = _mali_osk_wq_create_work(mali_userptr_uncharge_work, mem);
+	if (NULL == mem->pages || NULL == mem->phys_addrs || NULL == mem->uncharge_work)
+	{
+		if (NULL != mem->uncharge_work) _mali_osk_wq_delete_work_nonflush(mem->uncharge_work);
+		_mali_osk_free(mem->phys_addrs);
+		_mali_osk_free(mem->pages);
+		_mali_osk_free(mem);
+		return NULL;
+	}
+
+	down_write(&current->mm->mmap_sem);
+
+	/* Pinned pages can not be swapped out, same as mlock() */
+	locked = current->mm->locked_vm + mem->num_pages;
+	if (locked > (rlimit(RLIMIT_MEMLOCK) >> PAGE_SHIFT) && !capable(CAP_IPC_LOCK))
+	{
+		up_write(&current->mm->mmap_sem);
+		MALI_DEBUG_PRINT_ERROR(("Pinning user memory at 0x%08X exceeds RLIMIT_MEMLOCK\n", args->user_address));
+		_mali_osk_wq_delete_work_nonflush(mem->uncharge_work);
+		_mali_osk_free(mem->phys_addrs);
+		_mali_osk_free(mem->pages);
+		_mali_osk_free(mem);
+		return NULL;
+	}
+
+	/* Always pinned for writing, the GPU must never write to pages shared copy-on-write */
+	pinned = get_user_pages(current, current->mm, args->user_address, mem->num_pages, 1, 0, mem->pages, NULL);
+	if (pinned == (int)mem->num_pages)
+	{
+		current->mm->locked_vm = locked;
+	}
+
+	up_write(&current->mm->mmap_sem);
+
+	if (pinned != (int)mem->num_pages)
+	{
+		MALI_DEBUG_PRINT_ERROR(("Failed to pin user memory at 0x%08X, %d of %d pages\n", args->user_address, pinned, mem->num_pages));
+		if (0 < pinned)
+		{
+			for (i = 0; i < (u32)pinned; i++)
+			{
+				put_page(mem->pages[i]);
+			}
+		}
+		_mali_osk_wq_delete_work_nonflush(mem->uncharge_work);
+		_mali_osk_free(mem->phys_addrs);
+		_mali_osk_free(mem->pages);
+		_mali_osk_free(mem);
+		return NULL;
+	}
+
+	/* Keep the mm around to uncharge it, even after the process exits */
+	mem->mm = current->mm;
+	atomic_inc(&mem->mm->mm_count);
+
+	/* Ensure pages are flushed from CPU caches. */
+	for (i = 0; i < mem->num_pages; i++)
+	{
+		dma_addr_t dma_addr = dma_map_page(NULL, mem->pages[i], 0, PAGE_SIZE, DMA_BIDIRECTIONAL);
+
+		if (dma_mapping_error(NULL, dma_addr))
+		{
+			MALI_DEBUG_PRINT_ERROR(("Failed to map user memory at 0x%08X for the GPU\n", args->user_address + i * PAGE_SIZE));
+			while (0 < i)
+			{
+				i--;
+				dma_unmap_page(NULL, mem->phys_addrs[i], PAGE_SIZE, DMA_BIDIRECTIONAL);
+			}
+			for (i = 0; i < mem->num_pages; i++)
+			{
+				put_page(mem->pages[i]);
+			}
+			_mali_osk_free(mem->phys_addrs);
+			_mali_osk_free(mem->pages);
+
+			down_write(&mem->mm->mmap_sem);
+			mali_userptr_uncharge(mem);
+			return NULL;
+		}
+
+		mem->phys_addrs[i] = (u32)dma_addr;
+	}
+
+	/* The process keeps writing to the pages through its own mappings */
+	mali_l2_cache_untracked_writer_add();
+
+	return mem;
+}
+
+int mali_attach_userptr(struct mali_session_data *session, _mali_uk_attach_userptr_s __user *user_arg)
+{
+	mali_physical_memory_allocator external_memory_allocator;
+	struct mali_userptr_mem *mem;
+	_mali_uk_attach_userptr_s args;
+	mali_memory_allocation *descriptor;
+	int md;
+
+	/* Get call arguments from user space. copy_from_user returns how many bytes which where NOT copied */
+	if (0 != copy_from_user(&args, (void __user *)user_arg, sizeof(_mali_uk_attach_userptr_s)))
+	{
+		return -EFAULT;
+	}
+
+	/* Only whole pages can be mapped into the GPU */
+	if (0 == args.size || 0 != (args.user_address & ~PAGE_MASK) || 0 != (args.size & ~PAGE_MASK)
+	    || 0 != (args.mali_address & ~PAGE_MASK) || args.user_address + args.size < args.user_address)
+	{
+		MALI_DEBUG_PRINT_ERROR(("Invalid user memory 0x%08X+0x%08X\n", args.user_address, args.size));
+		return -EINVAL;
+	}
+
+	mem = mali_userptr_pin(&args);
+	if (NULL == mem)
+	{
+		return -ENOMEM;
+	}
+
+	/* Set up Mali memory descriptor */
+	descriptor = _mali_osk_calloc(1, sizeof(mali_memory_allocation));
+	if (NULL == descriptor)
+	{
+		MALI_DEBUG_PRINT_ERROR(("Failed to allocate descriptor for user memory at 0x%08X\n", args.user_address));
+		mali_userptr_release(NULL, mem);
+		return -ENOMEM;
+	}
+
+	descriptor->size = args.size;
+	descriptor->mapping = NULL;
+	descriptor->mali_address = args.mali_address;
+	descriptor->mali_addr_mapping_info = (void*)session;
+	descriptor->process_addr_mapping_info = NULL; /* already mapped in the process */
+	descriptor->lock = session->memory_lock;
+
+	descriptor->flags = MALI_MEMORY_ALLOCATION_FLAG_USER_MEMORY;
+	if (args.flags & _MALI_MAP_EXTERNAL_MAP_GUARD_PAGE)
+	{
+		descriptor->flags |= MALI_MEMORY_ALLOCATION_FLAG_MAP_GUARD_PAGE;
+	}
+	_mali_osk_list_init( &descriptor->list );
+
+	/* Get descriptor mapping for memory. */
+	if (_MALI_OSK_ERR_OK != mali_descriptor_mapping_allocate_mapping(session->descriptor_mapping, descriptor, &md))
+	{
+		MALI_DEBUG_PRINT_ERROR(("Failed to create descriptor mapping for user memory at 0x%08X\n", args.user_address));
+		_mali_osk_free(descriptor);
+		mali_userptr_release(NULL, mem);
+		return -EFAULT;
+	}
+
+	MALI_DEBUG_ASSERT(0 < md);
+
+	external_memory_allocator.allocate = mali_userptr_commit;
+	external_memory_allocator.allocate_page_table_block = NULL;
+	external_memory_allocator.ctx = mem;
+	external_memory_allocator.name = "User Memory";
+	external_memory_allocator.next = NULL;
+
+	/* Map memory into session's Mali virtual address space. */
+	_mali_osk_lock_wait(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+	if (_MALI_OSK_ERR_OK != mali_allocation_engine_allocate_memory(mali_mem_get_memory_engine(), descriptor, &external_memory_allocator, NULL))
+	{
+		_mali_osk_lock_signal(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+		MALI_DEBUG_PRINT_ERROR(("Failed to map user memory at 0x%08X into Mali address space\n", args.user_address));
+		mali_descriptor_mapping_free(session->descriptor_mapping, md);
+		_mali_osk_free(descriptor);
+		mali_userptr_release(NULL, mem);
+		return -ENOMEM;
+	}
+	_mali_osk_lock_signal(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+
+	/* Return stuff to user space */
+	if (0 != put_user(md, &user_arg->cookie))
+	{
+		/* Roll back, nothing can have used the memory yet */
+		MALI_DEBUG_PRINT_ERROR(("Failed to return descriptor to user space for user memory at 0x%08X\n", args.user_address));
+		_mali_osk_lock_wait(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		mali_descriptor_mapping_free(session->descriptor_mapping, md);
+		mali_allocation_engine_release_memory(mali_mem_get_memory_engine(), descriptor);
+		_mali_osk_lock_signal(session->memory_lock, _MALI_OSK_LOCKMODE_RW);
+		_mali_osk_free(descriptor);
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
+int mali_release_userptr(struct mali_session_data *session, _mali_uk_release_userptr_s __user *user_arg)
+{
+	int ret = 0;
+	_mali_uk_release_userptr_s args;
+	mali_memory_allocation *descriptor;
+
+	/* get call arguments from user space. copy_from_user returns how many bytes which where NOT copied */
+	if ( 0 != copy_from_user(&args, (void __user *)user_arg, sizeof(_mali_uk_release_userptr_s)) )
+	{
+		return -EFAULT;
+	}
+
+	MALI_DEBUG_PRINT(3, ("Mali userptr: release descriptor cookie %d\n", args.cookie));
+
+	_mali_osk_lock_wait( session->memory_lock, _MALI_OSK_LOCKMODE_RW );
+
+	if (_MALI_OSK_ERR_OK == mali_descriptor_mapping_get(session->descriptor_mapping, args.cookie, (void**)&descriptor)
+	    && mali_userptr_release == descriptor->physical_allocation.release)
+	{
+		MALI_DEBUG_PRINT(3, ("Mali userptr: Releasing user memory at mali address %x\n", descriptor->mali_address));
+
+		mali_descriptor_mapping_free(session->descriptor_mapping, args.cookie);
+
+		/* The pages are given back to the process, jobs still running must not reach them anymore */
+		mali_allocation_engine_release_pt1_mali_pagetables_unmap(mali_mem_get_memory_engine(), descriptor);
+		mali_scheduler_zap_all_active(session);
+
+		/* Will call back to mali_userptr_release() which will unpin the pages. */
+		mali_allocation_engine_release_pt2_physical_memory_free(mali_mem_get_memory_engine(), descriptor);
+
+		_mali_osk_free(descriptor);
+	}
+	else
+	{
+		MALI_DEBUG_PRINT_ERROR(("Invalid memory descriptor %d used to release user memory\n", args.cookie));
+		ret = -EINVAL;
+	}
+
+	_mali_osk_lock_signal( session->memory_lock, _MALI_OSK_LOCKMODE_RW );
+
+	return ret;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2013 ARM Limited. All rights reserved.
+ * 
+ * This program is free software and is provided to you under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation, and any use by you of this program is subject to the terms of such GNU licence.
+ * 
+ * A copy of the licence is included with the program, and can also be obtained from Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef __MALI_USERPTR_H__
+#define __MALI_USERPTR_H__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "mali_osk.h"
+#include "mali_kernel_memory_engine.h"
+
+int mali_attach_userptr(struct mali_session_data *session, _mali_uk_attach_userptr_s __user *arg);
+int mali_release_userptr(struct mali_session_data *session, _mali_uk_release_userptr_s __user *arg);
+void mali_userptr_release(void *ctx, void *handle);
+void mali_userptr_sync(mali_memory_allocation *descriptor, u32 offset, u32 size, mali_bool to_device);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MALI_USERPTR_H__ */